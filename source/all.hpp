@@ -39,6 +39,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "asio.hpp"
 #include "resolver.hpp"
 #include "connection.hpp"
+#include "connection-uring.hpp"
 #include "client.hpp"
 #include "server.hpp"
 //===========================================
@@ -35,16 +35,334 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 **************************************************************/
 //============================================
 #include "asio.hpp"
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+//============================================
+#ifdef ENABLE_TESTING
+#include "test.hpp"
+#include <boost/make_shared.hpp>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 //============================================
 namespace ict { namespace boost { namespace asio {
 //============================================
+//! io_service bieżącego wątku.
+static thread_local ::boost::asio::io_service * current_service=nullptr;
+//! Pula bieżącego wątku.
+static thread_local Pool * current_pool=nullptr;
+//! Indeks bieżącego wątku w puli.
+static thread_local std::size_t current_index=0;
+//============================================
 ::boost::asio::io_service & ioService(){
-  return(ioService(std::this_thread::get_id()));
+  if (!current_service) current_service=&ioService(std::this_thread::get_id());
+  return(*current_service);
 }
 ::boost::asio::io_service & ioService(std::thread::id id){
+  static std::mutex m;
   static std::map<std::thread::id,::boost::asio::io_service> io;
+  std::lock_guard<std::mutex> lock(m);
   return(io[id]);
 }
+bool singleThread(::boost::asio::io_service & io){
+  return(current_pool&&(&current_pool->get(current_index)==&io));
+}
+//============================================
+Pool::Pool(std::size_t size,bool pinnedIn):counter(0),pinned(pinnedIn){
+  if (!size) size=std::thread::hardware_concurrency();
+  if (!size) size=1;
+  loads.reset(new load_t[size]);
+  for (std::size_t k=0;k<size;k++) services.emplace_back(new ::boost::asio::io_service(1));
+  LOGGER_INFO<<__LOGGER__<<"ict::boost::asio::Pool has been created (size="<<size<<") ..."<<std::endl;
+}
+Pool::~Pool(){
+  stop();
+  join();
+  LOGGER_INFO<<__LOGGER__<<"ict::boost::asio::Pool has been destroyed ..."<<std::endl;
+}
+std::size_t Pool::size() const{
+  return(services.size());
+}
+::boost::asio::io_service & Pool::get(std::size_t index){
+  return(*services.at(index%services.size()));
+}
+::boost::asio::io_service & Pool::next(){
+  return(get(counter++));
+}
+std::size_t Pool::cpu(std::size_t index){
+  std::size_t count=std::thread::hardware_concurrency();
+  return(count?(index%count):0);
+}
+std::atomic<std::size_t> & Pool::connections(std::size_t index){
+  return(loads[index%services.size()].connections);
+}
+std::atomic<std::size_t> & Pool::pending(std::size_t index){
+  return(loads[index%services.size()].pending);
+}
+std::size_t Pool::load(std::size_t index) const{
+  const load_t & l(loads[index%services.size()]);
+  return(l.connections.load(std::memory_order_relaxed)+l.pending.load(std::memory_order_relaxed));
+}
+std::size_t Pool::leastLoaded(std::size_t first) const{
+  std::size_t out=first%services.size();
+  std::size_t min=load(out);
+  for (std::size_t k=out+1;(k<services.size())&&min;k++){
+    std::size_t l=load(k);
+    if (l<min){
+      min=l;
+      out=k;
+    }
+  }
+  return(out);
+}
+void Pool::runThread(std::size_t index){
+  current_service=services.at(index).get();
+  current_pool=this;
+  current_index=index;
+#ifdef __linux__
+  if (pinned){
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu(index),&set);
+    if (::pthread_setaffinity_np(::pthread_self(),sizeof(set),&set)){
+      LOGGER_WARN<<__LOGGER__<<"Unable to pin thread "<<index<<" to CPU "<<cpu(index)<<" ..."<<std::endl;
+    }
+  }
+#endif
+  for(;;) try {
+    current_service->run();
+    break;
+  } catch (std::exception & e) {
+    LOGGER_ERR<<__LOGGER__<<"Exception in thread "<<index<<": "<<e.what()<<std::endl;
+  }
+  LOGGER_DEBUG<<__LOGGER__<<"Thread "<<index<<" has finished ..."<<std::endl;
+}
+void Pool::start(){
+  std::lock_guard<std::mutex> lock(mutex);
+  if (threads.size()) return;
+  for (std::size_t k=0;k<services.size();k++){
+    services.at(k)->reset();
+    works.emplace_back(new ::boost::asio::io_service::work(*services.at(k)));
+  }
+  for (std::size_t k=0;k<services.size();k++){
+    threads.emplace_back(&Pool::runThread,this,k);
+  }
+}
+void Pool::stop(){
+  std::lock_guard<std::mutex> lock(mutex);
+  works.clear();
+  for (service_ptr_t & service : services) service->stop();
+}
+void Pool::join(){
+  std::lock_guard<std::mutex> lock(mutex);
+  for (std::thread & thread : threads) {
+    if (thread.get_id()==std::this_thread::get_id()){
+      thread.detach();
+    } else if (thread.joinable()) {
+      thread.join();
+    }
+  }
+  threads.clear();
+}
+Pool * Pool::current(){
+  return(current_pool);
+}
+std::size_t Pool::currentIndex(){
+  return(current_index);
+}
+//============================================
+LoadGuard::LoadGuard(){
+  if (current_pool) {
+    counter=&current_pool->connections(current_index);
+    (*counter)++;
+  }
+}
+LoadGuard::~LoadGuard(){
+  if (counter) (*counter)--;
+}
+//============================================
+//! Pula bloków pamięci wątku - lista wolnych bloków dla każdej klasy rozmiaru.
+class BlockPool {
+public:
+  //! Co ile bajtów są klasy rozmiaru.
+  enum {granularity=64};
+  //! Liczba klas rozmiaru (większe bloki nie są przechowywane w puli).
+  enum {classes=128};
+  //! Maksymalna liczba wolnych bloków w jednej klasie.
+  enum {depth=256};
+  //! Wolny blok.
+  struct block_t {
+    block_t * next;
+  };
+  //! Listy wolnych bloków.
+  block_t * lists[classes];
+  //! Liczba wolnych bloków na listach.
+  std::size_t counts[classes];
+  BlockPool(){
+    for (std::size_t k=0;k<classes;k++){
+      lists[k]=nullptr;
+      counts[k]=0;
+    }
+  }
+  ~BlockPool(){
+    for (std::size_t k=0;k<classes;k++) while (lists[k]){
+      block_t * b=lists[k];
+      lists[k]=b->next;
+      ::operator delete(b);
+    }
+  }
+  //! Zwraca klasę rozmiaru (classes - blok poza pulą).
+  static std::size_t index(std::size_t size){
+    if (!size) return(0);
+    size=(size+granularity-1)/granularity;
+    return((size<=classes)?(size-1):classes);
+  }
+};
+//! Pula bloków pamięci bieżącego wątku.
+static thread_local BlockPool block_pool;
+void * poolAllocate(std::size_t size){
+  std::size_t k(BlockPool::index(size));
+  if (k<BlockPool::classes){
+    if (block_pool.lists[k]){
+      BlockPool::block_t * b=block_pool.lists[k];
+      block_pool.lists[k]=b->next;
+      block_pool.counts[k]--;
+      return(b);
+    }
+    return(::operator new((k+1)*BlockPool::granularity));
+  }
+  return(::operator new(size));
+}
+void poolDeallocate(void * pointer,std::size_t size){
+  std::size_t k(BlockPool::index(size));
+  if (!pointer) return;
+  if ((k<BlockPool::classes)&&(block_pool.counts[k]<BlockPool::depth)){
+    BlockPool::block_t * b=static_cast<BlockPool::block_t*>(pointer);
+    b->next=block_pool.lists[k];
+    block_pool.lists[k]=b;
+    block_pool.counts[k]++;
+    return;
+  }
+  ::operator delete(pointer);
+}
+//============================================
+::boost::asio::io_service::id TimerWheel::id;
+TimerWheel::TimerWheel(::boost::asio::io_service & io):
+  ::boost::asio::io_service::service(io),
+  d(new ::boost::asio::deadline_timer(io)){
+}
+TimerWheel::~TimerWheel(){
+}
+TimerWheel & TimerWheel::get(::boost::asio::io_service & io){
+  return(::boost::asio::use_service<TimerWheel>(io));
+}
+#if BOOST_VERSION >= 106600
+void TimerWheel::shutdown(){
+#else
+void TimerWheel::shutdown_service(){
+#endif
+  //Zwolnienie obiektów utrzymywanych przez timery (mogą to być połączenia, które usuwają swoje timery).
+  for (std::size_t k=0;k<slots;k++) while (wheel[k].next!=&wheel[k]){
+    WheelTimer * t=static_cast<WheelTimer*>(wheel[k].next);
+    std::shared_ptr<const void> owner;
+    owner.swap(t->owner);
+    remove(*t);
+  }
+  d.reset();
+  running=false;
+}
+void TimerWheel::add(WheelTimer & timer,std::size_t seconds){
+  if (timer.active()) remove(timer);
+  if (!d) return;
+  if (!seconds) seconds=1;
+  node_t & slot(wheel[(cursor+seconds)%slots]);
+  timer.rounds=(seconds-1)/slots;
+  timer.prev=slot.prev;
+  timer.next=&slot;
+  slot.prev->next=&timer;
+  slot.prev=&timer;
+  count++;
+  if (!running) schedule();
+}
+void TimerWheel::remove(WheelTimer & timer){
+  if (!timer.active()) return;
+  timer.prev->next=timer.next;
+  timer.next->prev=timer.prev;
+  timer.prev=timer.next=&timer;
+  count--;
+}
+void TimerWheel::schedule(){
+  if (!d) return;
+  if (running) {
+    d->expires_at(d->expires_at()+::boost::posix_time::seconds(1));
+  } else {
+    d->expires_from_now(::boost::posix_time::seconds(1));
+    running=true;
+  }
+  d->async_wait([this](const ::boost::system::error_code & ec){
+    LOGGER_LAYER;
+    if (ec) {
+      running=false;
+    } else {
+      tick();
+    }
+  });
+}
+void TimerWheel::tick(){
+  node_t expired;
+  ticks++;
+  cursor=(cursor+1)%slots;
+  for (node_t * n=wheel[cursor].next;n!=&wheel[cursor];){
+    WheelTimer * t=static_cast<WheelTimer*>(n);
+    n=n->next;
+    if (t->rounds) {
+      t->rounds--;
+    } else {
+      t->prev->next=t->next;
+      t->next->prev=t->prev;
+      t->prev=expired.prev;
+      t->next=&expired;
+      expired.prev->next=t;
+      expired.prev=t;
+    }
+  }
+  //Funkcje timerów mogą dodawać i usuwać timery (również wygasłe, które jeszcze czekają na wykonanie).
+  while (expired.next!=&expired){
+    WheelTimer * t=static_cast<WheelTimer*>(expired.next);
+    std::shared_ptr<const void> owner;
+    owner.swap(t->owner);
+    remove(*t);
+    try {
+      if (t->callback) t->callback();
+    } catch (std::exception & e) {
+      LOGGER_ERR<<__LOGGER__<<"Exception: "<<e.what()<<std::endl;
+    }
+  }
+  if (count) {
+    schedule();
+  } else {
+    running=false;
+  }
+}
+//============================================
+WheelTimer::WheelTimer(::boost::asio::io_service & io,const std::function<void()> & callbackIn):
+  wheel(TimerWheel::get(io)),
+  callback(callbackIn){
+}
+WheelTimer::~WheelTimer(){
+  cancel();
+}
+void WheelTimer::start(std::size_t seconds,const std::shared_ptr<const void> & ownerIn){
+  wheel.add(*this,seconds);
+  if (active()) owner=ownerIn;
+}
+void WheelTimer::cancel(){
+  std::shared_ptr<const void> tmp;
+  tmp.swap(owner);
+  if (active()) wheel.remove(*this);
+}
 //============================================
 class StackExample: public Top{
 protected:
@@ -58,4 +376,164 @@ class StreamExample : public Bottom<::boost::asio::local::stream_protocol::socke
 };
 //============================================
 }}}
+//============================================
+#ifdef ENABLE_TESTING
+REGISTER_TEST(asio,tc1){
+  ict::boost::asio::Pool pool(4);
+  std::atomic<std::size_t> ok(0);
+  pool.start();
+  for (std::size_t k=0;k<pool.size();k++){
+    ::boost::asio::io_service & io(pool.get(k));
+    io.post([&,k](){
+      if ((ict::boost::asio::Pool::current()==&pool)&&(ict::boost::asio::Pool::currentIndex()==k)&&(&ict::boost::asio::ioService()==&io)) ok++;
+    });
+  }
+  for (std::size_t k=0;(k<1000)&&(ok<pool.size());k++) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  pool.stop();
+  pool.join();
+  if (ok!=pool.size()) return(-1);
+  if (ict::boost::asio::Pool::current()) return(-1);
+  return(0);
+}
+REGISTER_TEST(asio,tc2){
+  ::boost::asio::io_service io;
+  ::boost::asio::deadline_timer d(io);
+  ict::boost::asio::HandlerMemory memory;
+  std::size_t count=0;
+  std::function<void(const ::boost::system::error_code &)> wait;
+  void * p1=ict::boost::asio::poolAllocate(100);
+  ict::boost::asio::poolDeallocate(p1,100);
+  void * p2=ict::boost::asio::poolAllocate(120);
+  ict::boost::asio::poolDeallocate(p2,120);
+  if (p1!=p2) return(-1);
+  {
+    auto ptr=ict::boost::asio::makeShared<std::string>("test");
+    if (*ptr!="test") return(-1);
+  }
+  wait=[&](const ::boost::system::error_code & ec){
+    if (ec) return;
+    if ((++count)<100){
+      d.expires_from_now(::boost::posix_time::milliseconds(0));
+      d.async_wait(ict::boost::asio::makeHandler(memory,wait));
+    }
+  };
+  d.expires_from_now(::boost::posix_time::milliseconds(0));
+  d.async_wait(ict::boost::asio::makeHandler(memory,wait));
+  io.run();
+  if (count!=100) return(-1);
+  //Pamięć handlera została zwolniona po ostatniej operacji.
+  void * p3=memory.allocate(64);
+  memory.deallocate(p3,64);
+  void * p4=memory.allocate(64);
+  memory.deallocate(p4,64);
+  if (p3!=p4) return(-1);
+  return(0);
+}
+REGISTER_TEST(asio,tc3){
+  ::boost::asio::io_service io;
+  std::vector<int> order;
+  ict::boost::asio::WheelTimer t1(io,[&](){order.push_back(1);});
+  ict::boost::asio::WheelTimer t2(io,[&](){order.push_back(2);});
+  ict::boost::asio::WheelTimer t3(io,[&](){order.push_back(3);});
+  std::size_t count=0;
+  std::unique_ptr<ict::boost::asio::WheelTimer> t4;
+  t4.reset(new ict::boost::asio::WheelTimer(io,[&](){
+    if ((++count)<2) t4->start(1);
+  }));
+  t1.start(2);
+  t2.start(1);
+  t3.start(1);
+  t4->start(1);
+  t3.cancel();
+  if (ict::boost::asio::TimerWheel::get(io).size()!=3) return(-1);
+  io.run();
+  if (order!=std::vector<int>({2,1})) return(-1);
+  if (count!=2) return(-1);
+  if (ict::boost::asio::TimerWheel::get(io).size()) return(-1);
+  if (ict::boost::asio::TimerWheel::get(io).now()!=2) return(-1);
+  return(0);
+}
+//! Stos testowy trybu opróżniania - odczytuje z gniazda fragmenty po chunk bajtów, dopóki nie odczyta total bajtów.
+class TestDrainStack : public ict::boost::asio::Top {
+public:
+  enum {chunk=1024};
+  int fd=-1;
+  std::size_t total=0;
+  std::size_t received=0;
+  std::size_t iterations=0;
+  std::size_t bytes=0;
+  //! Liczba zdarzeń gotowości (drainIterations() jest pobierane raz na zdarzenie).
+  mutable std::size_t callbacks=0;
+  //! Liczba zdarzeń gotowości, po których odczytano wszystkie dane.
+  std::size_t done=0;
+  ::boost::asio::io_service * io=nullptr;
+  void start(){startOperations();}
+protected:
+  int getSocket() const {return(fd);}
+  bool wantRead() const {return(received<total);}
+  std::size_t drainIterations() const {
+    callbacks++;
+    return(iterations);
+  }
+  std::size_t drainBytes() const {return(bytes);}
+  void execRead(::boost::system::error_code & ec){execReadSome(ec);}
+  std::size_t execReadSome(::boost::system::error_code & ec){
+    char buffer[chunk];
+    ssize_t n(::read(fd,buffer,sizeof(buffer)));
+    if (n<0){
+      if ((errno==EAGAIN)||(errno==EWOULDBLOCK)){
+        ec=::boost::asio::error::would_block;
+      } else {
+        ec=::boost::system::error_code(errno,::boost::system::system_category());
+      }
+      return(0);
+    }
+    if (n==0){
+      ec=::boost::asio::error::eof;
+      return(0);
+    }
+    received+=n;
+    if (received>=total){
+      done=callbacks;
+      io->stop();
+    }
+    return(n);
+  }
+};
+REGISTER_TEST(asio,tc4){
+  //Dane do odczytu: 3 fragmenty, iterations/bytes - budżet, callbacks - oczekiwana liczba zdarzeń gotowości.
+  struct {std::size_t iterations;std::size_t bytes;std::size_t callbacks;} cases[]={
+    {16,0,1},//Wszystkie dane po jednym zdarzeniu.
+    {16,TestDrainStack::chunk,3},//Budżet bajtów - jeden fragment na zdarzenie.
+    {2,0,2},//Budżet odczytów - dwa fragmenty na zdarzenie.
+    {0,0,3}//Tryb standardowy - jeden odczyt na zdarzenie.
+  };
+  for (const auto & c : cases){
+    ::boost::asio::io_service io;
+    ::boost::asio::deadline_timer d(io);
+    int fds[2];
+    if (::socketpair(AF_UNIX,SOCK_STREAM,0,fds)) return(-1);
+    std::string data(3*TestDrainStack::chunk,'x');
+    if (::write(fds[1],data.data(),data.size())!=(ssize_t)data.size()) return(-1);
+    {
+      auto ptr(::boost::make_shared<ict::boost::asio::Bottom<::boost::asio::local::stream_protocol::socket,TestDrainStack>>(io));
+      ptr->fd=fds[0];//Gniazdo przejmuje Bottom.
+      ptr->total=data.size();
+      ptr->iterations=c.iterations;
+      ptr->bytes=c.bytes;
+      ptr->io=&io;
+      ptr->start();
+      d.expires_from_now(::boost::posix_time::seconds(5));
+      d.async_wait([&](const ::boost::system::error_code & ec){if (!ec) io.stop();});
+      io.run();
+      if ((ptr->received!=data.size())||(ptr->done!=c.callbacks)) {
+        ::close(fds[1]);
+        return(-1);
+      }
+    }
+    ::close(fds[1]);
+  }
+  return(0);
+}
+#endif
 //============================================
\ No newline at end of file
@@ -37,7 +37,16 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define _ASIO_HEADER
 //============================================
 #include <map>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
 #include <thread>
+#include <type_traits>
+#include <functional>
+#include <cstdint>
+#include <unistd.h>
+#include <boost/version.hpp>
 #include <boost/asio.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include "../libict/source/logger.hpp"
@@ -45,8 +54,278 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //============================================
 namespace ict { namespace boost { namespace asio {
 //===========================================
+//! Zwraca io_service bieżącego wątku (w wątku puli - io_service tego wątku).
 ::boost::asio::io_service & ioService();
+//! Zwraca io_service przypisany do wątku o podanym identyfikatorze.
 ::boost::asio::io_service & ioService(std::thread::id id);
+//! Zwraca io_service, w którym działa obiekt asio (gniazdo, akceptor, timer).
+template<class Object> ::boost::asio::io_service & ioServiceOf(Object & object){
+#if BOOST_VERSION >= 106600
+  return(static_cast<::boost::asio::io_service&>(object.get_executor().context()));
+#else
+  return(object.get_io_service());
+#endif
+}
+//! Sprawdza, czy io_service jest obsługiwany przez jeden wątek (io_service bieżącego wątku puli).
+bool singleThread(::boost::asio::io_service & io);
+//! Przenosi deskryptor z gniazda from do gniazda to (działającego w innym io_service).
+template<class Socket> void moveSocket(Socket & from,Socket & to){
+  if (!from.is_open()) return;
+  typename Socket::protocol_type protocol(from.local_endpoint().protocol());
+#if BOOST_VERSION >= 106600
+  to.assign(protocol,from.release());
+#else
+  int fd=::dup(from.native_handle());
+  from.close();
+  to.assign(protocol,fd);
+#endif
+}
+//===========================================
+//! Pula wątków - każdy wątek obsługuje własny io_service.
+class Pool {
+private:
+  typedef std::unique_ptr<::boost::asio::io_service> service_ptr_t;
+  typedef std::unique_ptr<::boost::asio::io_service::work> work_ptr_t;
+  //! Obiekty io_service (po jednym na wątek).
+  std::vector<service_ptr_t> services;
+  //! Obiekty work podtrzymujące działanie io_service.
+  std::vector<work_ptr_t> works;
+  //! Wątki puli.
+  std::vector<std::thread> threads;
+  //! Licznik do wybierania kolejnego io_service (round robin).
+  std::atomic<std::size_t> counter;
+  //! Blokada dla start(), stop() i join().
+  std::mutex mutex;
+  //! Czy wątki mają być przypisane do CPU.
+  bool pinned;
+  //! Obciążenie wątku puli.
+  struct load_t {
+    //! Liczba aktywnych połączeń.
+    std::atomic<std::size_t> connections;
+    //! Liczba połączeń przekazanych do wątku, ale jeszcze nie utworzonych.
+    std::atomic<std::size_t> pending;
+    load_t():connections(0),pending(0){}
+  };
+  //! Obciążenie wątków puli.
+  std::unique_ptr<load_t[]> loads;
+  //! Funkcja wykonywana w wątku puli.
+  void runThread(std::size_t index);
+public:
+  //! Konstruktor (size=0 - liczba wątków równa liczbie rdzeni; pinned - wątek k jest przypisany do CPU cpu(k)).
+  Pool(std::size_t size=0,bool pinnedIn=false);
+  //! Destruktor (zatrzymuje i czeka na zakończenie wątków).
+  ~Pool();
+  //! Zwraca liczbę wątków (io_service) w puli.
+  std::size_t size() const;
+  //! Zwraca io_service o podanym indeksie.
+  ::boost::asio::io_service & get(std::size_t index);
+  //! Zwraca kolejny io_service (round robin).
+  ::boost::asio::io_service & next();
+  //! Zwraca numer CPU, do którego jest (lub byłby) przypisany wątek o podanym indeksie.
+  static std::size_t cpu(std::size_t index);
+  //! Zwraca licznik aktywnych połączeń wątku o podanym indeksie.
+  std::atomic<std::size_t> & connections(std::size_t index);
+  //! Zwraca licznik połączeń przekazanych do wątku o podanym indeksie (jeszcze nie utworzonych).
+  std::atomic<std::size_t> & pending(std::size_t index);
+  //! Zwraca obciążenie wątku o podanym indeksie (połączenia aktywne i przekazane).
+  std::size_t load(std::size_t index) const;
+  //! Zwraca indeks najmniej obciążonego wątku (spośród wątków od first do końca puli).
+  std::size_t leastLoaded(std::size_t first=0) const;
+  //! Uruchamia wątki puli.
+  void start();
+  //! Zatrzymuje wszystkie io_service w puli.
+  void stop();
+  //! Czeka na zakończenie wątków puli.
+  void join();
+  //! Zwraca pulę bieżącego wątku (nullptr, jeśli wątek nie należy do puli).
+  static Pool * current();
+  //! Zwraca indeks bieżącego wątku w puli.
+  static std::size_t currentIndex();
+};
+//===========================================
+//! Rejestruje aktywne połączenie w bieżącym wątku puli (na potrzeby Pool::leastLoaded()).
+class LoadGuard {
+private:
+  //! Licznik połączeń wątku puli (nullptr, jeśli obiekt utworzono poza pulą).
+  std::atomic<std::size_t> * counter=nullptr;
+public:
+  LoadGuard();
+  LoadGuard(const LoadGuard &)=delete;
+  LoadGuard & operator=(const LoadGuard &)=delete;
+  ~LoadGuard();
+};
+//===========================================
+//! Przydziela blok pamięci z puli bieżącego wątku (bloki są grupowane w klasy rozmiaru).
+void * poolAllocate(std::size_t size);
+//! Zwraca blok pamięci do puli bieżącego wątku (blok może pochodzić z puli innego wątku).
+void poolDeallocate(void * pointer,std::size_t size);
+//! Alokator korzystający z puli bieżącego wątku (np. dla obiektów połączeń).
+template<class T> class PoolAllocator {
+public:
+  typedef T value_type;
+  PoolAllocator(){}
+  template<class U> PoolAllocator(const PoolAllocator<U> &){}
+  T * allocate(std::size_t n){return(static_cast<T*>(poolAllocate(n*sizeof(T))));}
+  void deallocate(T * pointer,std::size_t n){poolDeallocate(pointer,n*sizeof(T));}
+  template<class U> bool operator==(const PoolAllocator<U> &) const {return(true);}
+  template<class U> bool operator!=(const PoolAllocator<U> &) const {return(false);}
+};
+//! Tworzy obiekt (np. połączenie) w pamięci z puli bieżącego wątku.
+template<class T,class... Args> std::shared_ptr<T> makeShared(Args && ... args){
+  return(std::allocate_shared<T>(PoolAllocator<T>(),std::forward<Args>(args)...));
+}
+//===========================================
+//! Stała pamięć handlera jednej operacji asynchronicznej (np. odczytu połączenia) - używana ponownie przez kolejne operacje.
+class HandlerMemory {
+private:
+  //! Rozmiar pamięci.
+  enum {storageSize=512};
+  //! Pamięć.
+  std::aligned_storage<storageSize>::type storage;
+  //! Czy pamięć jest zajęta.
+  bool used=false;
+public:
+  HandlerMemory(){}
+  HandlerMemory(const HandlerMemory &)=delete;
+  HandlerMemory & operator=(const HandlerMemory &)=delete;
+  //! Przydziela pamięć (gdy pamięć jest zajęta lub za mała - z puli bieżącego wątku).
+  void * allocate(std::size_t size){
+    if ((!used)&&(size<=storageSize)){
+      used=true;
+      return(&storage);
+    }
+    return(poolAllocate(size));
+  }
+  //! Zwalnia pamięć.
+  void deallocate(void * pointer,std::size_t size){
+    if (pointer==&storage){
+      used=false;
+    } else {
+      poolDeallocate(pointer,size);
+    }
+  }
+};
+//! Alokator handlera korzystający z HandlerMemory.
+template<class T> class HandlerAllocator {
+private:
+  template<class U> friend class HandlerAllocator;
+  HandlerMemory & memory;
+public:
+  typedef T value_type;
+  explicit HandlerAllocator(HandlerMemory & memoryIn):memory(memoryIn){}
+  template<class U> HandlerAllocator(const HandlerAllocator<U> & other):memory(other.memory){}
+  T * allocate(std::size_t n){return(static_cast<T*>(memory.allocate(n*sizeof(T))));}
+  void deallocate(T * pointer,std::size_t n){memory.deallocate(pointer,n*sizeof(T));}
+  template<class U> bool operator==(const HandlerAllocator<U> & other) const {return(&memory==&other.memory);}
+  template<class U> bool operator!=(const HandlerAllocator<U> & other) const {return(&memory!=&other.memory);}
+};
+//! Handler, którego operacja asynchroniczna jest umieszczana w HandlerMemory.
+template<class Handler> class MemoryHandler {
+private:
+  HandlerMemory & memory;
+  Handler handler;
+public:
+  MemoryHandler(HandlerMemory & memoryIn,const Handler & handlerIn):memory(memoryIn),handler(handlerIn){}
+#if BOOST_VERSION >= 106600
+  typedef HandlerAllocator<Handler> allocator_type;
+  allocator_type get_allocator() const {return(allocator_type(memory));}
+#else
+  friend void * asio_handler_allocate(std::size_t size,MemoryHandler * self){
+    return(self->memory.allocate(size));
+  }
+  friend void asio_handler_deallocate(void * pointer,std::size_t size,MemoryHandler * self){
+    self->memory.deallocate(pointer,size);
+  }
+#endif
+  template<class... Args> void operator()(Args && ... args){
+    handler(std::forward<Args>(args)...);
+  }
+};
+//! Tworzy handler, którego operacja asynchroniczna jest umieszczana w podanej HandlerMemory.
+template<class Handler> MemoryHandler<Handler> makeHandler(HandlerMemory & memory,const Handler & handler){
+  return(MemoryHandler<Handler>(memory,handler));
+}
+//===========================================
+class WheelTimer;
+//!
+//! @brief Koło czasowe (hashed timing wheel) - jedno na io_service, z taktem co jedną sekundę.
+//!  Wstawienie i anulowanie timera ma koszt O(1), a wszystkie timery io_service
+//!  korzystają z jednego deadline_timer (działa on tylko, gdy są aktywne timery).
+//!  Koło (i jego timery) może być używane tylko w wątku obsługującym io_service.
+//!
+class TimerWheel : public ::boost::asio::io_service::service {
+private:
+  friend class WheelTimer;
+  //! Element listy timerów (slot koła lub timer).
+  struct node_t {
+    node_t * prev;
+    node_t * next;
+    node_t():prev(this),next(this){}
+  };
+  //! Liczba slotów koła.
+  enum {slots=512};
+  //! Timer odmierzający takty koła.
+  std::unique_ptr<::boost::asio::deadline_timer> d;
+  //! Sloty koła.
+  node_t wheel[slots];
+  //! Bieżący slot.
+  std::size_t cursor=0;
+  //! Liczba taktów od utworzenia koła.
+  uint64_t ticks=0;
+  //! Liczba aktywnych timerów.
+  std::size_t count=0;
+  //! Czy deadline_timer czeka na kolejny takt.
+  bool running=false;
+  //! Dodaje timer do koła.
+  void add(WheelTimer & timer,std::size_t seconds);
+  //! Usuwa timer z koła.
+  void remove(WheelTimer & timer);
+  //! Ustawia oczekiwanie na kolejny takt.
+  void schedule();
+  //! Wykonuje takt koła (wykonuje wygasłe timery).
+  void tick();
+#if BOOST_VERSION >= 106600
+  void shutdown();
+#else
+  void shutdown_service();
+#endif
+public:
+  static ::boost::asio::io_service::id id;
+  explicit TimerWheel(::boost::asio::io_service & io);
+  ~TimerWheel();
+  //! Zwraca koło czasowe podanego io_service.
+  static TimerWheel & get(::boost::asio::io_service & io);
+  //! Zwraca liczbę taktów (sekund) od utworzenia koła.
+  uint64_t now() const {return(ticks);}
+  //! Zwraca liczbę aktywnych timerów.
+  std::size_t size() const {return(count);}
+};
+//! Timer w kole czasowym io_service (np. kontrola przepływu lub limit bezczynności połączenia).
+class WheelTimer : private TimerWheel::node_t {
+private:
+  friend class TimerWheel;
+  //! Koło czasowe.
+  TimerWheel & wheel;
+  //! Liczba pełnych obrotów koła do wygaśnięcia.
+  std::size_t rounds=0;
+  //! Funkcja wykonywana po wygaśnięciu timera.
+  std::function<void()> callback;
+  //! Obiekt utrzymywany przy życiu, dopóki timer jest aktywny.
+  std::shared_ptr<const void> owner;
+public:
+  WheelTimer(::boost::asio::io_service & io,const std::function<void()> & callbackIn);
+  WheelTimer(const WheelTimer &)=delete;
+  WheelTimer & operator=(const WheelTimer &)=delete;
+  ~WheelTimer();
+  //! Uruchamia (lub przestawia) timer - wygaśnie po podanej liczbie sekund (z dokładnością do jednego taktu).
+  void start(std::size_t seconds,const std::shared_ptr<const void> & ownerIn=nullptr);
+  //! Zatrzymuje timer (funkcja nie zostanie wykonana).
+  void cancel();
+  //! Czy timer jest aktywny.
+  bool active() const {return(next!=this);}
+  //! Zwraca koło czasowe timera.
+  TimerWheel & getWheel() const {return(wheel);}
+};
 //===========================================
 //! Stos do obsługi połączenia - góra.
 class Top: public ::boost::enable_shared_from_this<Top>, public ict::reg::Base{
@@ -92,6 +371,39 @@ protected:
   //!
   virtual void execWrite(::boost::system::error_code & ec){};
   //!
+  //! Zwraca maksymalną liczbę odczytów/zapisów wykonywanych po jednym zdarzeniu gotowości gniazda.
+  //! Funkcja do nadpisania przez stos (opcjonalnie).
+  //!
+  //! @return Wartości:
+  //!  @li 0 - tryb standardowy (jedno wywołanie execRead()/execWrite() na zdarzenie);
+  //!  @li >0 - tryb opróżniania - execReadSome()/execWriteSome() są wywoływane do czasu,
+  //!   aż stos zgłosi błąd would_block, przestanie chcieć odczytywać/zapisywać lub wyczerpie się budżet.
+  //!
+  virtual std::size_t drainIterations() const {return(0);}
+  //!
+  //! Zwraca maksymalną liczbę bajtów odczytywanych/zapisywanych po jednym zdarzeniu gotowości (tryb opróżniania).
+  //! Funkcja do nadpisania przez stos (opcjonalnie).
+  //!
+  //! @return Limit bajtów (0 - bez limitu).
+  //!
+  virtual std::size_t drainBytes() const {return(0);}
+  //!
+  //! Wykonuje jeden odczyt na gnieździe w trybie opróżniania.
+  //! Funkcja do nadpisania przez stos (opcjonalnie).
+  //!
+  //! @param ec Błąd odczytu (jeśli wystąpił), would_block - brak danych.
+  //! @return Liczba odczytanych bajtów.
+  //!
+  virtual std::size_t execReadSome(::boost::system::error_code & ec){execRead(ec);return(0);}
+  //!
+  //! Wykonuje jeden zapis na gnieździe w trybie opróżniania.
+  //! Funkcja do nadpisania przez stos (opcjonalnie).
+  //!
+  //! @param ec Błąd zapisu (jeśli wystąpił), would_block - gniazdo nie przyjmuje danych.
+  //! @return Liczba zapisanych bajtów.
+  //!
+  virtual std::size_t execWriteSome(::boost::system::error_code & ec){execWrite(ec);return(0);}
+  //!
   //! Zwraca deskryptor gniazda używanogo przez stos.
   //! Funkcja do nadpisania przez stos (obowiązkowo).
   //!
@@ -106,7 +418,9 @@ public:
 template<class Socket,class Stack> class Bottom: public Stack {
 private:
   ::boost::asio::io_service & io_service;
-  ::boost::asio::strand n;
+  ::boost::asio::io_service::strand n;
+  //! Czy io_service jest obsługiwany przez jeden wątek (strand nie jest potrzebny).
+  bool single;
   bool error=false;
   //! Informuje, czy odczyt trwa.
   bool readInProgress=false;
@@ -115,17 +429,26 @@ private:
   std::unique_ptr<Socket> socketPtr;
   void startOperations(){
     auto self(Stack::shared_from_this());
-    n.post([this,self](){
+    auto handler([this,self](){
       LOGGER_LAYER;
       startOperationsLocal();
     });
+    if (single) {
+      io_service.post(handler);
+    } else {
+      n.post(handler);
+    }
   }
   void startOperationsLocal();
+  //! Wykonuje odczyt po zdarzeniu gotowości (w trybie opróżniania - do wyczerpania danych lub budżetu).
+  void drainRead(::boost::system::error_code & ec);
+  //! Wykonuje zapis po zdarzeniu gotowości (w trybie opróżniania - do zapełnienia gniazda lub wyczerpania budżetu).
+  void drainWrite(::boost::system::error_code & ec);
   void createSocket(std::unique_ptr<::boost::asio::ip::tcp::socket> & ptr);
   void createSocket(std::unique_ptr<::boost::asio::local::stream_protocol::socket> & ptr);
 public:
-  Bottom():io_service(ioService()),n(io_service){}
-  Bottom(::boost::asio::io_service & io_service_in):io_service(io_service_in),n(io_service){}
+  Bottom():io_service(ioService()),n(io_service),single(singleThread(io_service)){}
+  Bottom(::boost::asio::io_service & io_service_in):io_service(io_service_in),n(io_service),single(singleThread(io_service)){}
 };
 
 template<class Socket,class Stack>void Bottom<Socket,Stack>::startOperationsLocal(){
@@ -140,10 +463,10 @@ template<class Socket,class Stack>void Bottom<Socket,Stack>::startOperationsLoca
     readInProgress=true;
     socketPtr->async_read_some(
       ::boost::asio::null_buffers(),
-      [this,self](::boost::system::error_code & ec,std::size_t length){
+      [this,self](::boost::system::error_code ec,std::size_t length){
         LOGGER_LAYER;
         readInProgress=false;
-        if (!ec) Stack::execRead(ec);
+        if (!ec) drainRead(ec);
         if ((!ec)||ec==::boost::asio::error::would_block) {
           startOperationsLocal();
         } else if (socketPtr) {
@@ -159,10 +482,10 @@ template<class Socket,class Stack>void Bottom<Socket,Stack>::startOperationsLoca
     writeInProgress=true;
     socketPtr->async_write_some(
       ::boost::asio::null_buffers(),
-      [this,self](::boost::system::error_code & ec,std::size_t length){
+      [this,self](::boost::system::error_code ec,std::size_t length){
         LOGGER_LAYER;
         writeInProgress=false;
-        if (!ec) Stack::execWrite(ec);
+        if (!ec) drainWrite(ec);
         if ((!ec)||ec==::boost::asio::error::would_block) {
           startOperationsLocal();
         } else if (socketPtr) {
@@ -174,6 +497,34 @@ template<class Socket,class Stack>void Bottom<Socket,Stack>::startOperationsLoca
     );
   }
 }
+template<class Socket,class Stack>void Bottom<Socket,Stack>::drainRead(::boost::system::error_code & ec){
+  std::size_t iterations(Stack::drainIterations());
+  std::size_t bytes(Stack::drainBytes());
+  std::size_t total(0);
+  if (!iterations) {
+    Stack::execRead(ec);
+    return;
+  }
+  for (std::size_t k=0;(k<iterations)&&Stack::wantRead();k++){
+    total+=Stack::execReadSome(ec);
+    if (ec) break;
+    if (bytes&&(bytes<=total)) break;
+  }
+}
+template<class Socket,class Stack>void Bottom<Socket,Stack>::drainWrite(::boost::system::error_code & ec){
+  std::size_t iterations(Stack::drainIterations());
+  std::size_t bytes(Stack::drainBytes());
+  std::size_t total(0);
+  if (!iterations) {
+    Stack::execWrite(ec);
+    return;
+  }
+  for (std::size_t k=0;(k<iterations)&&Stack::wantWrite();k++){
+    total+=Stack::execWriteSome(ec);
+    if (ec) break;
+    if (bytes&&(bytes<=total)) break;
+  }
+}
 template<class Socket,class Stack>void Bottom<Socket,Stack>::createSocket(std::unique_ptr<::boost::asio::ip::tcp::socket> & ptr){
   int s=Stack::getSocket();
   int s_type=0;
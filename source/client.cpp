@@ -58,6 +58,17 @@ Tcp::Tcp(const std::string & host,const std::string & port,ict::boost::connectio
   LOGGER_INFO<<__LOGGER__<<"smpp::client::Tcp has been created ..."<<std::endl;
   REGISTER_CLIENT_TCP.add(this,"smpp::client::Tcp "+host+":"+port);
 }
+Tcp::Tcp(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,resolver::error_handler_t onError,::boost::asio::io_service & io)
+  :resolver::Tcp(host,port,onError,io),s(io),f(factory),d(io){
+  LOGGER_INFO<<__LOGGER__<<"smpp::client::Tcp has been created ..."<<std::endl;
+  REGISTER_CLIENT_TCP.add(this,"smpp::client::Tcp "+host+":"+port);
+}
+Tcp::Tcp(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,ict::boost::asio::Pool & pool)
+  :Tcp(host,port,factory,resolver::error_handler_t(),pool.next()){
+}
+Tcp::Tcp(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,resolver::error_handler_t onError,ict::boost::asio::Pool & pool)
+  :Tcp(host,port,factory,onError,pool.next()){
+}
 Tcp::~Tcp(){
   LOGGER_INFO<<__LOGGER__<<"smpp::client::Tcp has been destroyed ..."<<std::endl;
   REGISTER_CLIENT_TCP.del(this);
@@ -127,6 +138,14 @@ void factory(const std::string & host,const std::string & port,ict::boost::conne
   auto ptr=std::make_shared<Tcp>(host,port,factory,onError);
   if (ptr) ptr->init();
 }
+void factory(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,ict::boost::asio::Pool & pool){
+  auto ptr=std::make_shared<Tcp>(host,port,factory,pool);
+  if (ptr) ptr->init();
+}
+void factory(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,resolver::error_handler_t onError,ict::boost::asio::Pool & pool){
+  auto ptr=std::make_shared<Tcp>(host,port,factory,onError,pool);
+  if (ptr) ptr->init();
+}
 //============================================
 Stream::Stream(const std::string & path,ict::boost::connection::factory_stream_t factory)
   :resolver::Stream(path),s(ict::boost::asio::ioService()),f(factory){
@@ -38,6 +38,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //============================================
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
+#include "asio.hpp"
 #include "resolver.hpp"
 #include "connection.hpp"
 //============================================
@@ -53,9 +54,14 @@ private:
   ict::boost::connection::factory_tcp_t f;
   //! Timer dla połączenia.
   ::boost::asio::deadline_timer d;
+  Tcp(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,resolver::error_handler_t onError,::boost::asio::io_service & io);
 public:
   Tcp(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory);
   Tcp(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,resolver::error_handler_t onError);
+  //! Konstruktor - klient (i tworzone połączenie) działa w jednym z wątków puli.
+  Tcp(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,ict::boost::asio::Pool & pool);
+  //! Konstruktor - klient (i tworzone połączenie) działa w jednym z wątków puli.
+  Tcp(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,resolver::error_handler_t onError,ict::boost::asio::Pool & pool);
   virtual ~Tcp();
   //! Zamyka połączenie.
   void doStop();
@@ -68,6 +74,8 @@ private:
 };
 void factory(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory);
 void factory(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,resolver::error_handler_t onError);
+void factory(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,ict::boost::asio::Pool & pool);
+void factory(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,resolver::error_handler_t onError,ict::boost::asio::Pool & pool);
 //============================================
 class Stream : public resolver::Stream {
 private:
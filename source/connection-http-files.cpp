@@ -0,0 +1,352 @@
+//! @file
+//! @brief Connection (http files) module - Source file.
+//! @author Mariusz Ornowski (mariusz.ornowski@ict-project.pl)
+//! @version 1.0
+//! @date 2016-2017
+//! @copyright ICT-Project Mariusz Ornowski (ict-project.pl)
+/* **************************************************************
+Copyright (c) 2016-2017, ICT-Project Mariusz Ornowski (ict-project.pl)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+3. Neither the name of the ICT-Project Mariusz Ornowski nor the names
+of its contributors may be used to endorse or promote products
+derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**************************************************************/
+//============================================
+#include "connection-http-files.hpp"
+#include <chrono>
+#include <cstdio>
+#include <sys/stat.h>
+//============================================
+#ifdef ENABLE_TESTING
+#include "test.hpp"
+#include "connection-test.hpp"
+#include <fstream>
+#include <unistd.h>
+#endif
+//============================================
+namespace ict { namespace boost { namespace connection { namespace http {
+//============================================
+//! Zwraca czas zegara monotonicznego w sekundach.
+static std::int64_t seconds(){
+  return(std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+//! Porównuje czasy modyfikacji plików (-1, 0, 1).
+static int compare_mtime(const struct stat & a,const struct stat & b){
+  if (a.st_mtim.tv_sec!=b.st_mtim.tv_sec) return((a.st_mtim.tv_sec<b.st_mtim.tv_sec)?-1:1);
+  if (a.st_mtim.tv_nsec!=b.st_mtim.tv_nsec) return((a.st_mtim.tv_nsec<b.st_mtim.tv_nsec)?-1:1);
+  return(0);
+}
+//! Sprawdza, czy if-none-match zawiera etag (porównanie słabe - "W/" jest pomijane).
+static bool match_etag(::boost::string_ref value,const std::string & etag){
+  std::size_t pos(0);
+  while (pos<value.size()){
+    std::size_t end(value.substr(pos).find(','));
+    end=(end==::boost::string_ref::npos)?value.size():(pos+end);
+    ::boost::string_ref item(trimOws(value.substr(pos,end-pos)));
+    if (item.starts_with("W/")) item.remove_prefix(2);
+    if ((item=="*")||(item==etag)) return(true);
+    pos=end+1;
+  }
+  return(false);
+}
+//! Zwraca wartość cyfry szesnastkowej (-1, jeśli to nie jest cyfra szesnastkowa).
+static int hex_digit(char c){
+  if (('0'<=c)&&(c<='9')) return(c-'0');
+  if (('a'<=c)&&(c<='f')) return(c-'a'+10);
+  if (('A'<=c)&&(c<='F')) return(c-'A'+10);
+  return(-1);
+}
+const std::string & fileContentType(const std::string & path){
+  static const std::string _default_("application/octet-stream");
+  static const std::pair<std::string,std::string> types[]={
+    {"css","text/css; charset=utf-8"},
+    {"csv","text/csv; charset=utf-8"},
+    {"gif","image/gif"},
+    {"htm","text/html; charset=utf-8"},
+    {"html","text/html; charset=utf-8"},
+    {"ico","image/x-icon"},
+    {"jpeg","image/jpeg"},
+    {"jpg","image/jpeg"},
+    {"js","application/javascript; charset=utf-8"},
+    {"json","application/json"},
+    {"mjs","application/javascript; charset=utf-8"},
+    {"mp4","video/mp4"},
+    {"pdf","application/pdf"},
+    {"png","image/png"},
+    {"svg","image/svg+xml"},
+    {"txt","text/plain; charset=utf-8"},
+    {"wasm","application/wasm"},
+    {"webp","image/webp"},
+    {"woff","font/woff"},
+    {"woff2","font/woff2"},
+    {"xml","application/xml"},
+    {"zip","application/zip"}
+  };
+  std::size_t dot(path.rfind('.'));
+  std::size_t slash(path.rfind('/'));
+  if ((dot==std::string::npos)||((slash!=std::string::npos)&&(dot<slash))) return(_default_);
+  ::boost::string_ref extension(path.data()+dot+1,path.size()-dot-1);
+  for (const std::pair<std::string,std::string> & t : types) if (equalNocase(extension,t.first)) return(t.second);
+  return(_default_);
+}
+bool fileUriPath(const std::string & uri,std::string & path){
+  static const std::string _index_("index.html");
+  std::size_t end(uri.find_first_of("?#"));
+  path.clear();
+  if (end==std::string::npos) end=uri.size();
+  if ((!end)||(uri[0]!='/')) return(false);
+  for (std::size_t k=0;k<end;k++){
+    char c(uri[k]);
+    if (c=='%'){
+      int h((k+2)<end?hex_digit(uri[k+1]):-1);
+      int l((k+2)<end?hex_digit(uri[k+2]):-1);
+      if ((h<0)||(l<0)) return(false);
+      c=(char)(h*16+l);
+      k+=2;
+    }
+    if ((c=='\0')||(c=='\\')) return(false);
+    path+=c;
+  }
+  //Segmenty "." i ".." nie są dopuszczalne (ścieżka nie może wyjść poza katalog plików).
+  for (std::size_t begin=1;begin<=path.size();){
+    std::size_t slash(path.find('/',begin));
+    if (slash==std::string::npos) slash=path.size();
+    ::boost::string_ref segment(path.data()+begin,slash-begin);
+    if ((segment==".")||(segment=="..")) return(false);
+    begin=slash+1;
+  }
+  if (path.back()=='/') path+=_index_;
+  return(true);
+}
+//============================================
+FileCache::FileCache(const std::string & rootIn,std::size_t capacityIn,std::size_t revalidateIn):
+  root((rootIn.size()&&(rootIn.back()=='/'))?rootIn.substr(0,rootIn.size()-1):rootIn),
+  capacity(capacityIn<shards?1:((capacityIn+shards-1)/shards)),
+  revalidate(revalidateIn){
+}
+file_entry_ptr_t FileCache::load(const std::string & path){
+  std::shared_ptr<file_entry_t> entry(std::make_shared<file_entry_t>());
+  char etag[64];
+  entry->file=ict::boost::connection::File::open(path);
+  if (!entry->file) return(nullptr);
+  const struct stat & info(entry->file->info());
+  entry->gzip=ict::boost::connection::File::open(path+".gz");
+  if (entry->gzip&&(compare_mtime(entry->gzip->info(),info)<0)) entry->gzip=nullptr;//Nieaktualna wersja .gz.
+  std::snprintf(etag,sizeof(etag),"\"%llx-%llx%08lx\"",(unsigned long long)info.st_size,(unsigned long long)info.st_mtim.tv_sec,(unsigned long)info.st_mtim.tv_nsec);
+  entry->etag=etag;
+  if (entry->gzip){
+    const struct stat & gzip_info(entry->gzip->info());
+    std::snprintf(etag,sizeof(etag),"\"%llx-%llx%08lx-gz\"",(unsigned long long)gzip_info.st_size,(unsigned long long)gzip_info.st_mtim.tv_sec,(unsigned long)gzip_info.st_mtim.tv_nsec);
+    entry->gzip_etag=etag;
+  }
+  entry->last_modified=httpDate(info.st_mtim.tv_sec);
+  entry->content_type=fileContentType(path);
+  return(entry);
+}
+bool FileCache::valid(const std::string & path,const file_entry_ptr_t & entry){
+  struct stat info;
+  if (::stat(path.c_str(),&info)) return(!entry);
+  if (!entry) return(false);
+  const struct stat & cached(entry->file->info());
+  return((info.st_dev==cached.st_dev)&&(info.st_ino==cached.st_ino)&&(info.st_size==cached.st_size)&&(compare_mtime(info,cached)==0));
+}
+file_entry_ptr_t FileCache::get(const std::string & path){
+  const std::string full(root+path);
+  shard_t & shard(table[std::hash<std::string>()(full)%shards]);
+  const std::int64_t now(seconds());
+  file_entry_ptr_t entry;
+  bool found(false);
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    std::unordered_map<std::string,std::list<node_t>::iterator>::iterator it(shard.index.find(full));
+    if (it!=shard.index.end()){
+      shard.lru.splice(shard.lru.begin(),shard.lru,it->second);
+      if ((!revalidate)||((now-it->second->checked)<(std::int64_t)revalidate)) return(it->second->entry);
+      entry=it->second->entry;
+      found=true;
+    }
+  }
+  //Wywołania systemowe są wykonywane poza blokadą.
+  if (!(found&&valid(full,entry))) entry=load(full);
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    std::unordered_map<std::string,std::list<node_t>::iterator>::iterator it(shard.index.find(full));
+    if (it!=shard.index.end()){
+      it->second->entry=entry;
+      it->second->checked=now;
+    } else {
+      shard.lru.push_front(node_t{full,entry,now});
+      shard.index[full]=shard.lru.begin();
+      if (shard.lru.size()>capacity){
+        shard.index.erase(shard.lru.back().path);
+        shard.lru.pop_back();
+      }
+    }
+  }
+  return(entry);
+}
+void FileCache::clear(){
+  for (shard_t & shard : table){
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.index.clear();
+    shard.lru.clear();
+  }
+}
+std::size_t FileCache::size(){
+  std::size_t out(0);
+  for (shard_t & shard : table){
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    out+=shard.lru.size();
+  }
+  return(out);
+}
+//============================================
+void FileServer::serveFile(FileCache & cache,const std::string & uri){
+  static const std::string _allow_("GET, HEAD");
+  static const std::string _vary_("accept-encoding");
+  static const std::string _gzip_("gzip");
+  std::string path;
+  file_entry_ptr_t entry;
+  response_body.clear();
+  if ((request_method!=method_get)&&(request_method!=method_head)){
+    setResponseCode(405);
+    setSingleResponseHeader(header_allow,_allow_);
+    return;
+  }
+  if (fileUriPath(uri,path)) entry=cache.get(path);
+  if (!entry){
+    setResponseCode(404);
+    return;
+  }
+  //Wersja skompresowana ma własny etag - inaczej pośrednicy mogliby pomylić warianty.
+  const bool gzip(entry->gzip&&acceptsEncoding(headValue(header_accept_encoding),_gzip_));
+  const std::string & etag(gzip?entry->gzip_etag:entry->etag);
+  setSingleResponseHeader(header_etag,etag);
+  setSingleResponseHeader(header_last_modified,entry->last_modified);
+  if (entry->gzip) setSingleResponseHeader(header_vary,_vary_);
+  {
+    ::boost::string_ref none_match(headValue(header_if_none_match));
+    //if-modified-since jest porównywany dokładnie z last-modified (klienci odsyłają otrzymaną wartość).
+    if (none_match.size()?match_etag(none_match,etag):(headValue(header_if_modified_since)==entry->last_modified)){
+      setResponseCode(304);
+      return;
+    }
+  }
+  setResponseCode(200);
+  setSingleResponseHeader(header_content_type,entry->content_type);
+  if (gzip){
+    setSingleResponseHeader(header_content_encoding,_gzip_);
+    setResponseFile(entry->gzip);
+  } else {
+    setResponseFile(entry->file);
+  }
+}
+//============================================
+}}}}
+//============================================
+#ifdef ENABLE_TESTING
+class TestFilesStack : public ict::boost::connection::http::FileServer{
+private:
+  int afterRequest(){
+    serveFile(cache);
+    startWrite();
+    return(0);
+  }
+public:
+  ict::boost::connection::http::FileCache & cache;
+  TestFilesStack(ict::boost::connection::http::FileCache & cacheIn):cache(cacheIn){}
+};
+typedef ict::boost::connection::TestBottom<TestFilesStack> TestFiles;
+REGISTER_TEST(connection_http_files,tc1){
+  using namespace ict::boost::connection::http;
+  std::string path;
+  if ((!fileUriPath("/a/b%20c.txt?x=1",path))||(path!="/a/b c.txt")) return(-1);
+  if ((!fileUriPath("/",path))||(path!="/index.html")) return(-1);
+  if (fileUriPath("/a/../b",path)||fileUriPath("/a/%2e%2e/b",path)||fileUriPath("/a%00",path)||fileUriPath("a",path)||fileUriPath("/%4",path)) return(-1);
+  if ((fileContentType("/x/a.HTML")!="text/html; charset=utf-8")||(fileContentType("/x.d/a")!="application/octet-stream")) return(-1);
+  const std::string dir("/tmp/connection_http_files-tc1");
+  ::mkdir(dir.c_str(),0700);
+  {
+    std::ofstream f(dir+"/a.txt",std::ios::binary|std::ios::trunc);
+    f<<"hello";
+  }
+  FileCache cache(dir+"/",64,0);
+  file_entry_ptr_t a(cache.get("/a.txt"));
+  if ((!a)||(a->file->size()!=5)||a->gzip||(a->content_type!="text/plain; charset=utf-8")||(a->etag.size()<5)||(a->last_modified.size()!=29)) return(-1);
+  if ((cache.get("/a.txt")!=a)||cache.get("/missing")||(cache.size()!=2)) return(-1);
+  {
+    std::ofstream f(dir+"/a.txt.gz",std::ios::binary|std::ios::trunc);
+    f<<"zz";
+  }
+  ::unlink((dir+"/a.txt").c_str());
+  if (cache.get("/a.txt")!=a) return(-1);//Trafienie nie sprawdza pliku (revalidate=0).
+  {
+    std::ofstream f(dir+"/a.txt",std::ios::binary|std::ios::trunc);
+    f<<"hello";
+  }
+  {
+    std::ofstream f(dir+"/a.txt.gz",std::ios::binary|std::ios::trunc);
+    f<<"zz";
+  }
+  cache.clear();
+  a=cache.get("/a.txt");
+  if ((!a)||(!a->gzip)) return(-1);
+  {
+    TestFiles t(cache);
+    t.feedAll("GET /a.txt HTTP/1.1\r\n\r\n");
+    if (t.output.find("HTTP/1.1 200 OK\r\n")||(t.output.find("etag: "+a->etag+"\r\n")==std::string::npos)) return(-1);
+    if ((t.output.find("vary: accept-encoding\r\n")==std::string::npos)||(t.output.find("\r\n\r\nhello")==std::string::npos)) return(-1);
+  }
+  {
+    TestFiles t(cache);
+    t.feedAll("GET /a.txt HTTP/1.1\r\nAccept-Encoding: br, gzip;q=0.5\r\n\r\n");
+    if ((t.output.find("content-encoding: gzip\r\n")==std::string::npos)||(t.output.find("content-length: 2\r\n\r\nzz")==std::string::npos)) return(-1);
+    if ((a->gzip_etag==a->etag)||(a->gzip_etag.find("-gz\"")==std::string::npos)||(t.output.find("etag: "+a->gzip_etag+"\r\n")==std::string::npos)) return(-1);
+    t.output.clear();
+    t.feedAll("GET /a.txt HTTP/1.1\r\nAccept-Encoding: gzip\r\nIf-None-Match: "+a->etag+"\r\n\r\n");
+    if (t.output.find("HTTP/1.1 200 OK\r\n")) return(-1);
+    t.output.clear();
+    t.feedAll("GET /a.txt HTTP/1.1\r\nAccept-Encoding: gzip\r\nIf-None-Match: "+a->gzip_etag+"\r\n\r\n");
+    if (t.output.find("HTTP/1.1 304 ")||(t.output.find("etag: "+a->gzip_etag+"\r\n")==std::string::npos)) return(-1);
+    t.output.clear();
+    t.feedAll("GET /a.txt HTTP/1.1\r\nAccept-Encoding: gzip;q=0\r\n\r\n");
+    if (t.output.find("\r\n\r\nhello")==std::string::npos) return(-1);
+  }
+  {
+    TestFiles t(cache);
+    t.feedAll("GET /a.txt HTTP/1.1\r\nIf-None-Match: W/"+a->etag+"\r\n\r\nHEAD /a.txt HTTP/1.1\r\n\r\nGET /b HTTP/1.1\r\n\r\nPOST /a.txt HTTP/1.1\r\n\r\n");
+    std::size_t n(t.output.find("HTTP/1.1 304 "));
+    std::size_t h(t.output.find("content-length: 5\r\n\r\nHTTP/1.1 404 Not Found\r\n"));
+    std::size_t m(t.output.find("HTTP/1.1 405 Method Not Allowed\r\n"));
+    if (n||(h==std::string::npos)||(m==std::string::npos)||(t.output.find("hello")!=std::string::npos)||t.closed) return(-1);
+    if ((t.output.find("allow: GET, HEAD\r\n")==std::string::npos)||(t.output.find("content-length: 0\r\n\r\nHTTP/1.1 405")==std::string::npos)) return(-1);
+  }
+  ::unlink((dir+"/a.txt").c_str());
+  ::unlink((dir+"/a.txt.gz").c_str());
+  ::rmdir(dir.c_str());
+  return(0);
+}
+#endif
+//===========================================
@@ -0,0 +1,166 @@
+//! @file
+//! @brief Connection (http files) module - header file.
+//! @author Mariusz Ornowski (mariusz.ornowski@ict-project.pl)
+//! @version 1.0
+//! @date 2016-2017
+//! @copyright ICT-Project Mariusz Ornowski (ict-project.pl)
+/* **************************************************************
+Copyright (c) 2016-2017, ICT-Project Mariusz Ornowski (ict-project.pl)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+3. Neither the name of the ICT-Project Mariusz Ornowski nor the names
+of its contributors may be used to endorse or promote products
+derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**************************************************************/
+#ifndef _CONNECTION_HTTP_FILES_HEADER
+#define _CONNECTION_HTTP_FILES_HEADER
+//============================================
+#include <string>
+#include <memory>
+#include <mutex>
+#include <list>
+#include <unordered_map>
+#include <cstdint>
+#include <vector>
+#include "connection-http.hpp"
+//============================================
+namespace ict { namespace boost { namespace connection { namespace http {
+//===========================================
+//!
+//! @brief Plik statyczny w pamięci podręcznej - otwarty deskryptor, wynik stat() i gotowe nagłówki.
+//!  Wpis jest niezmienny - zmiana pliku na dysku powoduje utworzenie nowego wpisu (po sprawdzeniu pliku).
+//!
+struct file_entry_t {
+  //! Plik.
+  ict::boost::connection::file_t file;
+  //! Skompresowana wersja pliku (plik z rozszerzeniem .gz, nie starszy niż plik) - nullptr, jeśli jej nie ma.
+  ict::boost::connection::file_t gzip;
+  //! Wartość nagłówka etag.
+  std::string etag;
+  //! Wartość nagłówka etag dla wersji skompresowanej (z przyrostkiem -gz, na podstawie stat() pliku .gz).
+  std::string gzip_etag;
+  //! Wartość nagłówka last-modified.
+  std::string last_modified;
+  //! Wartość nagłówka content-type.
+  std::string content_type;
+};
+typedef std::shared_ptr<const file_entry_t> file_entry_ptr_t;
+//!
+//! Zwraca content-type dla rozszerzenia pliku (application/octet-stream, jeśli rozszerzenie jest nieznane).
+//!
+//! @param path Ścieżka pliku.
+//! @return Wartość nagłówka content-type.
+//!
+const std::string & fileContentType(const std::string & path);
+//!
+//! Zamienia ścieżkę z URI żądania na ścieżkę względną katalogu plików (bez query, po dekodowaniu %XX).
+//!
+//! @param uri URI żądania.
+//! @param path Ścieżka (zaczyna się od '/', dla katalogu dopisywany jest index.html).
+//! @return Wartości:
+//!  @li true - ścieżka jest poprawna;
+//!  @li false - ścieżka jest niepoprawna (np. zawiera segment "..").
+//!
+bool fileUriPath(const std::string & uri,std::string & path);
+//===========================================
+//!
+//! @brief Pamięć podręczna plików statycznych (LRU podzielone na części z osobnymi blokadami).
+//!  Trafienie nie wykonuje żadnych wywołań systemowych na plikach - plik jest sprawdzany (stat()) dopiero,
+//!  gdy od poprzedniego sprawdzenia minęło revalidate sekund. Brak pliku też jest zapamiętywany.
+//!  Otwarte deskryptory są zamykane, gdy wpis zostanie usunięty z pamięci i nie jest już wysyłany.
+//!
+class FileCache {
+private:
+  //! Liczba części pamięci podręcznej.
+  enum {shards=16};
+  //! Element listy LRU.
+  struct node_t {
+    //! Ścieżka pliku.
+    std::string path;
+    //! Wpis (nullptr - brak pliku).
+    file_entry_ptr_t entry;
+    //! Czas ostatniego sprawdzenia pliku (w sekundach zegara monotonicznego).
+    std::int64_t checked;
+  };
+  //! Część pamięci podręcznej.
+  struct shard_t {
+    std::mutex mutex;
+    //! Lista LRU (na początku ostatnio używane).
+    std::list<node_t> lru;
+    //! Indeks listy LRU.
+    std::unordered_map<std::string,std::list<node_t>::iterator> index;
+  };
+  //! Katalog plików.
+  const std::string root;
+  //! Maksymalna liczba wpisów w jednej części.
+  const std::size_t capacity;
+  //! Czas (w sekundach), po którym plik jest sprawdzany ponownie (0 - nigdy).
+  const std::size_t revalidate;
+  shard_t table[shards];
+  //! Tworzy wpis dla pliku (nullptr, jeśli pliku nie ma).
+  static file_entry_ptr_t load(const std::string & path);
+  //! Sprawdza, czy plik na dysku jest nadal tym samym plikiem co we wpisie.
+  static bool valid(const std::string & path,const file_entry_ptr_t & entry);
+public:
+  //!
+  //! Konstruktor.
+  //!
+  //! @param rootIn Katalog plików.
+  //! @param capacityIn Maksymalna liczba wpisów (a więc i otwartych plików) w pamięci podręcznej.
+  //! @param revalidateIn Czas (w sekundach), po którym plik jest sprawdzany ponownie (0 - nigdy).
+  //!
+  FileCache(const std::string & rootIn,std::size_t capacityIn=1024,std::size_t revalidateIn=1);
+  //!
+  //! Zwraca wpis dla pliku.
+  //!
+  //! @param path Ścieżka względem katalogu plików (zob. fileUriPath()).
+  //! @return Wpis lub nullptr, jeśli pliku nie ma.
+  //!
+  file_entry_ptr_t get(const std::string & path);
+  //! Usuwa wszystkie wpisy.
+  void clear();
+  //! Zwraca liczbę wpisów.
+  std::size_t size();
+};
+//===========================================
+//!
+//! @brief Serwer HTTP z obsługą plików statycznych z pamięci podręcznej.
+//!
+class FileServer : public Server{
+protected:
+  //!
+  //! Ustawia odpowiedź z plikiem statycznym (wywoływać w afterRequest() przed startWrite()).
+  //!  Obsługuje GET i HEAD, if-none-match, if-modified-since oraz wersję .gz pliku dla accept-encoding: gzip.
+  //!
+  //! @param cache Pamięć podręczna plików.
+  //! @param uri URI żądania.
+  //!
+  void serveFile(FileCache & cache,const std::string & uri);
+  //! Ustawia odpowiedź z plikiem statycznym dla URI bieżącego żądania.
+  void serveFile(FileCache & cache){serveFile(cache,requestUri());}
+};
+//============================================
+}}}}
+//===========================================
+#endif
@@ -0,0 +1,358 @@
+//! @file
+//! @brief Connection (http client pool) module - Source file.
+//! @author Mariusz Ornowski (mariusz.ornowski@ict-project.pl)
+//! @version 1.0
+//! @date 2016-2017
+//! @copyright ICT-Project Mariusz Ornowski (ict-project.pl)
+/* **************************************************************
+Copyright (c) 2016-2017, ICT-Project Mariusz Ornowski (ict-project.pl)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+3. Neither the name of the ICT-Project Mariusz Ornowski nor the names
+of its contributors may be used to endorse or promote products
+derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**************************************************************/
+//============================================
+#include "connection-http-pool.hpp"
+#include "client.hpp"
+#include "asio.hpp"
+//============================================
+#ifdef ENABLE_TESTING
+#include "test.hpp"
+#include "server.hpp"
+#include <chrono>
+#endif
+//============================================
+namespace ict { namespace boost { namespace connection { namespace http {
+//============================================
+void PoolClient::request(method_t method,const std::string & uri,const headers_t & headers,const std::string & body,response_handler_t handlerIn){
+  request_method=method;
+  request_uri=uri.empty()?std::string("/"):uri;
+  request_headers=headers;
+  if (!request_headers.count(header_host)) request_headers.set(header_host,host);
+  request_body=body;
+  request_producer=nullptr;
+  handler=handlerIn;
+  busy=true;
+  startWrite();
+}
+int PoolClient::afterResponse(){
+  pool_client_t self(std::static_pointer_cast<PoolClient>(shared_from_this()));
+  response_handler_t h;
+  busy=false;
+  h.swap(handler);
+  if (h) h(this);
+  if (busy||(!keep_alive)) return(0);//Kolejne żądanie albo połączenie do zamknięcia.
+  ClientPool * p(getPool());
+  if ((!p)||readString.size()){//Pula usunięta albo dane spoza odpowiedzi - połączenie nie nadaje się do ponownego użycia.
+    doClose();
+    return(0);
+  }
+  p->release(key,p->hosts[key],self);
+  return(0);
+}
+void PoolClient::doStop(){
+  response_handler_t h;
+  h.swap(handler);
+  busy=false;
+  ClientPool * p(getPool());
+  pool.reset();
+  if (p) p->remove(this);
+  if (h) h(nullptr);
+}
+//============================================
+ClientPool::ClientPool(std::size_t maxIdle,std::size_t maxPerHost,std::size_t idleTimeout):self(std::make_shared<ClientPool*>(this)){
+  setLimits(maxIdle,maxPerHost,idleTimeout);
+}
+ClientPool::~ClientPool(){
+  //Zajęte połączenia i nawiązywane połączenia widzą odtąd pulę jako usuniętą.
+  *self=nullptr;
+  for (auto & h : hosts){
+    std::vector<pool_client_t> idle;
+    idle.swap(h.second.idle);
+    for (const pool_client_t & client : idle){
+      client->pool.reset();
+      client->doClose();
+    }
+    h.second.waiting.clear();
+  }
+  idle_count=0;
+}
+ClientPool & ClientPool::local(){
+  static thread_local ClientPool pool;
+  return(pool);
+}
+void ClientPool::setLimits(std::size_t maxIdle,std::size_t maxPerHost,std::size_t idleTimeout){
+  max_idle=maxIdle;
+  max_per_host=maxPerHost?maxPerHost:1;
+  idle_timeout=idleTimeout;
+}
+void ClientPool::connect(const std::string & key,host_t & h){
+  //Klient zgłasza też błąd operation_aborted po anulowaniu swoich timerów - liczy się tylko pierwszy wynik.
+  std::shared_ptr<bool> done(std::make_shared<bool>(false));
+  std::string host(h.host);
+  std::string port(h.port);
+  std::shared_ptr<ClientPool*> token(self);
+  h.count++;
+  ict::boost::client::factory(h.host,h.port,[token,key,host,port,done](::boost::asio::ip::tcp::socket & socket){
+    if (*done) return;
+    *done=true;
+    ClientPool * p(*token);
+    if (!p) return;//Pula usunięta - gniazdo zostanie zamknięte.
+    auto ptr(ict::boost::asio::makeShared<ict::boost::connection::Bottom<::boost::asio::ip::tcp::socket,PoolClient>>(socket));
+    if (!ptr){
+      p->failed(key);
+      return;
+    }
+    ptr->pool=token;
+    ptr->key=key;
+    ptr->host=(port=="80")?host:key;
+    ptr->initThis();
+    LOGGER_DEBUG<<__LOGGER__<<"HTTP client pool - new connection to "<<key<<std::endl;
+    p->release(key,p->hosts[key],ptr);
+  },[token,key,done](const ::boost::system::error_code & ec){
+    if ((ec==::boost::asio::error::operation_aborted)||(*done)) return;
+    *done=true;
+    if (*token) (*token)->failed(key);
+  });
+}
+void ClientPool::release(const std::string & key,host_t & h,const pool_client_t & client){
+  if (h.waiting.size()){
+    pool_handler_t handler(h.waiting.front());
+    h.waiting.pop_front();
+    handler(client);
+    return;
+  }
+  if (idle_count>=max_idle){
+    client->doClose();
+    return;
+  }
+  client->busy_timeout=client->idleTimeout;
+  client->setIdleTimeout(idle_timeout);
+  h.idle.push_back(client);
+  idle_count++;
+}
+void ClientPool::failed(const std::string & key){
+  host_t & h(hosts[key]);
+  LOGGER_WARN<<__LOGGER__<<"HTTP client pool - connection to "<<key<<" has failed..."<<std::endl;
+  if (h.count) h.count--;
+  if (h.waiting.size()){
+    pool_handler_t handler(h.waiting.front());
+    h.waiting.pop_front();
+    handler(nullptr);
+  }
+  //Pozostali oczekujący bez nawiązywanego dla nich połączenia - kolejna próba (każdy dostaje połączenie albo nullptr).
+  while ((h.waiting.size()>h.count)&&(h.count<max_per_host)) connect(key,h);
+}
+void ClientPool::remove(PoolClient * client){
+  host_t & h(hosts[client->key]);
+  for (std::size_t k=0;k<h.idle.size();k++) if (h.idle[k].get()==client){
+    h.idle.erase(h.idle.begin()+k);
+    idle_count--;
+    break;
+  }
+  if (h.count) h.count--;
+  if (h.waiting.size()&&(h.count<max_per_host)) connect(client->key,h);
+}
+void ClientPool::get(const std::string & host,const std::string & port,pool_handler_t handler){
+  std::string key(host+":"+port);
+  host_t & h(hosts[key]);
+  h.host=host;
+  h.port=port;
+  if (h.idle.size()){//Ostatnio używane połączenie ma najpewniej otwarte okno TCP.
+    pool_client_t client(h.idle.back());
+    h.idle.pop_back();
+    idle_count--;
+    client->setIdleTimeout(client->busy_timeout);
+    handler(client);
+    return;
+  }
+  h.waiting.push_back(handler);
+  if (h.count<max_per_host) connect(key,h);
+}
+void ClientPool::warmUp(const std::string & host,const std::string & port,std::size_t count){
+  std::string key(host+":"+port);
+  host_t & h(hosts[key]);
+  h.host=host;
+  h.port=port;
+  if (count>max_per_host) count=max_per_host;
+  while (h.count<count) connect(key,h);
+}
+std::size_t ClientPool::size(const std::string & host,const std::string & port) const {
+  auto it(hosts.find(host+":"+port));
+  return((it==hosts.end())?0:it->second.count);
+}
+std::size_t ClientPool::idleSize(const std::string & host,const std::string & port) const {
+  auto it(hosts.find(host+":"+port));
+  return((it==hosts.end())?0:it->second.idle.size());
+}
+//============================================
+}}}}
+//============================================
+#ifdef ENABLE_TESTING
+//! Serwer testowy - odpowiada URI żądania (dla /close z nagłówkiem connection: close - połączenie zamyka klient).
+class TestPoolServer : public ict::boost::connection::http::Server{
+private:
+  int afterRequest(){
+    setResponseCode(200);
+    response_body=requestUri();
+    if (requestUri()=="/close") setSingleResponseHeader(ict::boost::connection::http::header_connection,"close");
+    startWrite();
+    return(0);
+  }
+public:
+  static std::size_t connections;
+  TestPoolServer(){
+    connections++;
+    ict::reg::get<TestPoolServer>().add(this);
+  }
+  ~TestPoolServer(){
+    ict::reg::get<TestPoolServer>().del(this);
+  }
+};
+std::size_t TestPoolServer::connections=0;
+REGISTER_TEST(connection_http_pool,tc1){
+  typedef ict::boost::connection::http::PoolClient client_t;
+  static const std::string host("127.0.0.1");
+  static const std::string port("4571");
+  ::boost::asio::io_service & io(ict::boost::asio::ioService());
+  ::boost::asio::deadline_timer d(io);
+  int out(-1);
+  std::size_t step(0);
+  std::size_t count(0);
+  client_t * first(nullptr);
+  std::function<void()> next;
+  ict::boost::connection::http::headers_t headers;
+  std::unique_ptr<ict::boost::connection::http::ClientPool> p(new ict::boost::connection::http::ClientPool(4,2,30));
+  ict::boost::connection::http::ClientPool & pool(*p);
+  //Błąd w kroku kończy test.
+  auto fail=[&](){
+    std::cout<<"connection_http_pool - step "<<step<<" has failed"<<std::endl;
+    io.stop();
+  };
+  auto check=[&](client_t * c,const std::string & body)->bool{
+    if ((!c)||(c->responseCode()!="200")||(c->response_body!=body)) {fail();return(false);}
+    return(true);
+  };
+  auto request=[&](const std::string & uri,std::function<void(client_t *)> done){
+    pool.get(host,port,[&,uri,done](const ict::boost::connection::http::pool_client_t & c){
+      if (!c) {fail();return;}
+      if (!first) first=c.get();
+      c->request(ict::boost::connection::http::method_get,uri,headers,"",done);
+    });
+  };
+  next=[&](){
+    switch(++step){
+      case 1://Pierwsze żądanie - nowe połączenie.
+        request("/a",[&](client_t * c){
+          if (check(c,"/a")) io.post(next);
+        });
+        break;
+      case 2://Połączenie wróciło do puli i jest używane ponownie.
+        if ((pool.idleSize(host,port)!=1)||(TestPoolServer::connections!=1)) {fail();break;}
+        request("/b",[&](client_t * c){
+          if (!check(c,"/b")) return;
+          if (c!=first) {fail();return;}
+          io.post(next);
+        });
+        break;
+      case 3://Limit połączeń do hosta - trzecie żądanie czeka na zwolnione połączenie.
+        for (std::size_t k=0;k<3;k++) request("/c",[&](client_t * c){
+          if (!check(c,"/c")) return;
+          if (pool.size(host,port)>2) {fail();return;}
+          if ((++count)==3) io.post(next);
+        });
+        break;
+      case 4://Połączenie z connection: close nie wraca do puli.
+        if (pool.idleSize(host,port)<2){//Drugie połączenie mogło jeszcze nie zostać nawiązane.
+          step--;
+          io.post(next);
+          break;
+        }
+        if (TestPoolServer::connections!=2) {fail();break;}
+        request("/close",[&](client_t * c){
+          if (check(c,"/close")) io.post(next);
+        });
+        break;
+      case 5://Brak serwera - każdy odbiorca (także ponad limit połączeń do hosta) dostaje nullptr.
+        if ((pool.size(host,port)!=1)||(pool.idleSize(host,port)!=1)) {fail();break;}
+        count=0;
+        for (std::size_t k=0;k<3;k++) pool.get(host,"4572",[&](const ict::boost::connection::http::pool_client_t & c){
+          if (c) {fail();return;}
+          if ((++count)<3) return;
+          if (pool.size(host,"4572")) {fail();return;}
+          io.post(next);
+        });
+        break;
+      case 6://Połączenia nawiązane z góry.
+        pool.warmUp(host,port,2);
+        io.post(next);
+        break;
+      case 7:
+        if (pool.idleSize(host,port)<2){//Czeka na połączenia z warmUp().
+          step--;
+          io.post(next);
+          break;
+        }
+        if (TestPoolServer::connections!=3) {fail();break;}
+        //Pula usunięta w trakcie żądania i nawiązywania połączeń - odpowiedź dociera, a połączenie jest zamykane.
+        pool.get(host,port,[&](const ict::boost::connection::http::pool_client_t & c){
+          if (!c) {fail();return;}
+          c->request(ict::boost::connection::http::method_get,"/d",headers,"",[&](client_t * c){
+            if (check(c,"/d")) io.post(next);
+          });
+          pool.warmUp("localhost",port,2);
+          p.reset();
+        });
+        break;
+      default:
+        out=0;
+        io.stop();
+        break;
+    }
+  };
+  ict::boost::server::factory(host,port,[](::boost::asio::ip::tcp::socket & socket){
+    auto ptr=ict::boost::asio::makeShared<ict::boost::connection::Bottom<::boost::asio::ip::tcp::socket,TestPoolServer>>(socket);
+    if (ptr) ptr->initThis();
+  });
+  d.expires_from_now(::boost::posix_time::seconds(10));
+  d.async_wait([&](const ::boost::system::error_code & ec){if (!ec) fail();});
+  io.post(next);
+  io.run();
+  d.cancel();
+  //Połączenia zamyka najpierw klient (serwer nie zostawia gniazd w TIME_WAIT na swoim porcie).
+  p.reset();
+  ict::reg::get<ict::boost::client::Tcp>().destroy();
+  io.reset();
+  d.expires_from_now(::boost::posix_time::milliseconds(200));
+  d.async_wait([&](const ::boost::system::error_code & ec){io.stop();});
+  io.run();
+  ict::reg::get<ict::boost::server::Tcp>().destroy();
+  ict::reg::get<TestPoolServer>().destroy();
+  io.reset();
+  io.poll();
+  return(out);
+}
+#endif
+//===========================================
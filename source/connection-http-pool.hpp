@@ -0,0 +1,171 @@
+//! @file
+//! @brief Connection (http client pool) module - header file.
+//! @author Mariusz Ornowski (mariusz.ornowski@ict-project.pl)
+//! @version 1.0
+//! @date 2016-2017
+//! @copyright ICT-Project Mariusz Ornowski (ict-project.pl)
+/* **************************************************************
+Copyright (c) 2016-2017, ICT-Project Mariusz Ornowski (ict-project.pl)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+3. Neither the name of the ICT-Project Mariusz Ornowski nor the names
+of its contributors may be used to endorse or promote products
+derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**************************************************************/
+#ifndef _CONNECTION_HTTP_POOL_HEADER
+#define _CONNECTION_HTTP_POOL_HEADER
+//============================================
+#include <string>
+#include <memory>
+#include <functional>
+#include <map>
+#include <deque>
+#include <vector>
+#include "connection-http.hpp"
+//============================================
+namespace ict { namespace boost { namespace connection { namespace http {
+//===========================================
+class ClientPool;
+class PoolClient;
+typedef std::shared_ptr<PoolClient> pool_client_t;
+//! Odbiorca połączenia z puli (nullptr - nie udało się nawiązać połączenia).
+typedef std::function<void(const pool_client_t & client)> pool_handler_t;
+//! Obsługa odpowiedzi (nullptr - połączenie zostało zamknięte przed odczytaniem odpowiedzi).
+typedef std::function<void(PoolClient * client)> response_handler_t;
+//===========================================
+//!
+//! @brief Klient HTTP z puli połączeń (ClientPool).
+//!  Żądanie jest wysyłane przez request(). Po afterResponse() połączenie keep-alive wraca do puli,
+//!  chyba że handler odpowiedzi wysłał tym klientem kolejne żądanie.
+//!
+class PoolClient : public Client {
+  friend class ClientPool;
+private:
+  //! Pula, do której należy połączenie (pusty lub nullptr - połączenie jest już poza pulą albo pula została usunięta).
+  std::shared_ptr<ClientPool*> pool;
+  //! Zwraca pulę, do której należy połączenie (nullptr - brak).
+  ClientPool * getPool() const {return(pool?*pool:nullptr);}
+  //! Klucz połączenia w puli (host:port).
+  std::string key;
+  //! Wartość nagłówka host dla żądań.
+  std::string host;
+  //! Czy żądanie jest w trakcie obsługi.
+  bool busy=false;
+  //! Limit bezczynności połączenia poza pulą.
+  std::size_t busy_timeout=0;
+  //! Obsługa odpowiedzi na bieżące żądanie.
+  response_handler_t handler;
+protected:
+  //! Połączenie jest gotowe dopiero po request() - odczyt tylko wykrywa zamknięcie przez serwer.
+  void doStart(){asyncRead();}
+  //! Zamknięcie połączenia - usuwa je z puli.
+  void doStop();
+  int afterResponse();
+public:
+  using Headers::responseCode;
+  using Headers::responseMsg;
+  using Body::getSingleResponseHeader;
+  using Body::response_body;
+  //!
+  //! Wysyła żądanie (wywoływać w wątku puli).
+  //!
+  //! @param method Metoda żądania.
+  //! @param uri URI żądania.
+  //! @param headers Nagłówki żądania (nagłówek host jest dodawany, jeśli go nie ma).
+  //! @param body Body żądania.
+  //! @param handlerIn Obsługa odpowiedzi.
+  //!
+  void request(method_t method,const std::string & uri,const headers_t & headers,const std::string & body,response_handler_t handlerIn);
+  //! Zwraca klucz połączenia w puli (host:port).
+  const std::string & poolKey() const {return(key);}
+};
+//===========================================
+//!
+//! @brief Pula połączeń keep-alive klienta HTTP dla bieżącego wątku (kluczem jest host:port).
+//!  Połączenia działają w io_service wątku, w którym pula jest używana - wszystkie funkcje
+//!  należy wywoływać w tym wątku. Bezczynne połączenie jest zamykane po idle_timeout sekundach
+//!  lub gdy zamknie je serwer.
+//!
+class ClientPool {
+  friend class PoolClient;
+private:
+  //! Połączenia do jednego hosta.
+  struct host_t {
+    std::string host;
+    std::string port;
+    //! Liczba połączeń (nawiązywanych, zajętych i bezczynnych).
+    std::size_t count=0;
+    //! Bezczynne połączenia (ostatnio używane na końcu).
+    std::vector<pool_client_t> idle;
+    //! Oczekujący na połączenie (osiągnięty limit max_per_host).
+    std::deque<pool_handler_t> waiting;
+  };
+  //! Wskaźnik na pulę współdzielony z połączeniami i nawiązywanymi połączeniami - zerowany w destruktorze.
+  std::shared_ptr<ClientPool*> self;
+  //! Połączenia według klucza host:port.
+  std::map<std::string,host_t> hosts;
+  //! Liczba bezczynnych połączeń we wszystkich hostach.
+  std::size_t idle_count=0;
+  //! Maksymalna liczba bezczynnych połączeń (we wszystkich hostach).
+  std::size_t max_idle;
+  //! Maksymalna liczba połączeń do jednego hosta.
+  std::size_t max_per_host;
+  //! Limit bezczynności połączenia w puli (w sekundach) - jeśli 0, to brak ograniczenia.
+  std::size_t idle_timeout;
+  //! Nawiązuje nowe połączenie do hosta.
+  void connect(const std::string & key,host_t & h);
+  //! Przekazuje połączenie oczekującemu albo odkłada je jako bezczynne.
+  void release(const std::string & key,host_t & h,const pool_client_t & client);
+  //! Obsługuje nieudane nawiązanie połączenia.
+  void failed(const std::string & key);
+  //! Usuwa zamknięte połączenie z puli.
+  void remove(PoolClient * client);
+public:
+  //! Konstruktor.
+  ClientPool(std::size_t maxIdle=64,std::size_t maxPerHost=8,std::size_t idleTimeout=30);
+  //! Destruktor (zamyka bezczynne połączenia, zajęte połączenia są zamykane po odpowiedzi, a oczekujący na połączenie nie są wywoływani).
+  ~ClientPool();
+  //! Zwraca pulę bieżącego wątku.
+  static ClientPool & local();
+  //! Ustawia limity puli (max_idle, max_per_host, idle_timeout).
+  void setLimits(std::size_t maxIdle,std::size_t maxPerHost,std::size_t idleTimeout);
+  //!
+  //! Przekazuje połączenie do hosta - bezczynne z puli, nowe (do limitu max_per_host) lub pierwsze zwolnione.
+  //!
+  //! @param host Host.
+  //! @param port Port.
+  //! @param handler Odbiorca połączenia - powinien wysłać nim żądanie (PoolClient::request()).
+  //!
+  void get(const std::string & host,const std::string & port,pool_handler_t handler);
+  //! Nawiązuje z góry połączenia do hosta, tak aby było ich count (do limitu max_per_host).
+  void warmUp(const std::string & host,const std::string & port,std::size_t count);
+  //! Zwraca liczbę połączeń do hosta.
+  std::size_t size(const std::string & host,const std::string & port) const;
+  //! Zwraca liczbę bezczynnych połączeń do hosta.
+  std::size_t idleSize(const std::string & host,const std::string & port) const;
+};
+//============================================
+}}}}
+//===========================================
+#endif
@@ -35,10 +35,16 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 **************************************************************/
 //============================================
 #include "connection-http.hpp"
-#include <regex>
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <limits>
 //============================================
 #ifdef ENABLE_TESTING
 #include "test.hpp"
+#include "connection-test.hpp"
+#include <fstream>
+#include <unistd.h>
 #endif
 //============================================
 namespace ict { namespace boost { namespace connection { namespace http {
@@ -64,11 +70,323 @@ const std::string _cookie_("cookie");
 const std::string _set_cookie_("set-cookie");
 const std::string _connection_("connection");
 const std::string _forwarded_("forwarded");
-header_config_t default_config={.multiple_values=true,.multiple_lines=true};
-config_t config={
-  {_content_length_,      {.multiple_values=false,.multiple_lines=false}},
-  {_content_type_,        {.multiple_values=false,.multiple_lines=false}}
+//============================================
+//! Nazwy metod HTTP (w kolejności method_t).
+static const std::string * const method_names[]={
+  nullptr,&_GET_,&_HEAD_,&_POST_,&_PUT_,&_DELETE_,&_CONNECT_,&_OPTIONS_,&_TRACE_,&_PATCH_
+};
+//! Nazwy wersji HTTP (w kolejności version_t).
+static const std::string * const version_names[]={
+  nullptr,&_HTTP_1_0_,&_HTTP_1_1_
+};
+method_t methodId(const char * name,std::size_t size){
+  for (std::size_t k=method_get;k<=method_patch;k++)
+    if ((method_names[k]->size()==size)&&(!method_names[k]->compare(0,size,name,size))) return((method_t)k);
+  return(method_other);
+}
+const std::string & methodName(method_t method){
+  static const std::string empty;
+  if ((method_get<=method)&&(method<=method_patch)) return(*method_names[method]);
+  return(empty);
+}
+version_t versionId(const char * name,std::size_t size){
+  for (std::size_t k=version_1_0;k<=version_1_1;k++)
+    if ((version_names[k]->size()==size)&&(!version_names[k]->compare(0,size,name,size))) return((version_t)k);
+  return(version_other);
+}
+const std::string & versionName(version_t version){
+  static const std::string empty;
+  if ((version_1_0<=version)&&(version<=version_1_1)) return(*version_names[version]);
+  return(empty);
+}
+//! Nazwy znanych nagłówków (w kolejności header_t).
+static const char * const header_names[]={
+  "",
+  "accept","accept-charset","accept-encoding","accept-language","accept-ranges","age",
+  "allow","authorization","cache-control","connection","content-disposition","content-encoding",
+  "content-language","content-length","content-location","content-range","content-type","cookie",
+  "date","etag","expect","expires","forwarded","host",
+  "if-match","if-modified-since","if-none-match","if-range","if-unmodified-since","keep-alive",
+  "last-modified","location","origin","pragma","proxy-authorization","range",
+  "referer","retry-after","server","set-cookie","te","trailer",
+  "transfer-encoding","upgrade","user-agent","vary","via","www-authenticate",
+  "x-forwarded-for"
+};
+//! Skrót nazwy nagłówka (małe litery ASCII) - dobrany tak, by znane nagłówki nie miały kolizji w tablicy 128 pozycji.
+static inline std::size_t header_hash(const char * name,std::size_t size){
+  return((size*3+(name[0]|0x20)*56+(name[size-1]|0x20)*29+(name[size/2]|0x20))&127);
+}
+//! Tablica skrót -> identyfikator znanego nagłówka.
+struct header_table_t {
+  std::uint8_t slot[128];
+  std::string name[header_count];
+  header_table_t(){
+    for (std::uint8_t & k : slot) k=header_other;
+    for (std::size_t k=header_other+1;k<header_count;k++){
+      name[k]=header_names[k];
+      slot[header_hash(name[k].data(),name[k].size())]=k;
+    }
+  }
+};
+static const header_table_t & header_table(){
+  static const header_table_t t;
+  return(t);
+}
+header_t headerId(const char * name,std::size_t size){
+  const header_table_t & t(header_table());
+  if (!size) return(header_other);
+  std::size_t k(t.slot[header_hash(name,size)]);
+  const std::string & n(t.name[k]);
+  if (n.size()!=size) return(header_other);
+  for (std::size_t i=0;i<size;i++) if ((name[i]|0x20)!=n[i]) return(header_other);
+  return((header_t)k);
+}
+const std::string & headerName(header_t id){
+  if ((header_other<id)&&(id<header_count)) return(header_table().name[id]);
+  return(header_table().name[header_other]);
+}
+//============================================
+//! Kod statusu HTTP i jego komunikat.
+struct status_t {
+  unsigned int code;
+  const char * reason;
+};
+//! Komunikaty statusów HTTP (przy powtórzonym kodzie obowiązuje pierwszy komunikat).
+static constexpr status_t status_reasons[]={
+  //Source: https://en.wikipedia.org/wiki/List_of_HTTP_status_codes
+  {100,"Continue"},//The server has received the request headers and the client should proceed to send the request body (in the case of a request for which a body needs to be sent; for example, a POST request). Sending a large request body to a server after a request has been rejected for inappropriate headers would be inefficient. To have a server check the request's headers, a client must send Expect: 100-continue as a header in its initial request and receive a 100 Continue status code in response before sending the body. The response 417 Expectation Failed indicates the request should not be continued.[2]
+  {101,"Switching Protocols"},//The requester has asked the server to switch protocols and the server has agreed to do so.[5]
+  {102,"Processing (WebDAV; RFC 2518)"},//A WebDAV request may contain many sub-requests involving file operations, requiring a long time to complete the request. This code indicates that the server has received and is processing the request, but no response is available yet.[6] This prevents the client from timing out and assuming the request was lost.
+  {200,"OK"},//Standard response for successful HTTP requests. The actual response will depend on the request method used. In a GET request, the response will contain an entity corresponding to the requested resource. In a POST request, the response will contain an entity describing or containing the result of the action.[7]
+  {201,"Created"},//The request has been fulfilled, resulting in the creation of a new resource.[8]
+  {202,"Accepted"},//The request has been accepted for processing, but the processing has not been completed. The request might or might not be eventually acted upon, and may be disallowed when processing occurs.[9]
+  {203,"Non-Authoritative Information"},//The server is a transforming proxy (e.g. a Web accelerator) that received a 200 OK from its origin, but is returning a modified version of the origin's response.[10][11]
+  {204,"No Content"},//The server successfully processed the request and is not returning any content.[12]
+  {205,"Reset Content"},//The server successfully processed the request, but is not returning any content. Unlike a 204 response, this response requires that the requester reset the document view.[13]
+  {206,"Partial Content (RFC 7233)"},//The server is delivering only part of the resource (byte serving) due to a range header sent by the client. The range header is used by HTTP clients to enable resuming of interrupted downloads, or split a download into multiple simultaneous streams.[14]
+  {207,"Multi-Status (WebDAV; RFC 4918)"},//The message body that follows is an XML message and can contain a number of separate response codes, depending on how many sub-requests were made.[15]
+  {208,"Already Reported (WebDAV; RFC 5842)"},//The members of a DAV binding have already been enumerated in a preceding part of the (multistatus) response, and are not being included again.
+  {226,"IM Used (RFC 3229)"},//The server has fulfilled a request for the resource, and the response is a representation of the result of one or more instance-manipulations applied to the current instance.[16]
+  {300,"Multiple Choices"},//Indicates multiple options for the resource from which the client may choose (via agent-driven content negotiation). For example, this code could be used to present multiple video format options, to list files with different filename extensions, or to suggest word-sense disambiguation.[18]
+  {301,"Moved Permanently"},//This and all future requests should be directed to the given URI.[19]
+  {302,"Found"},//This is an example of industry practice contradicting the standard. The HTTP/1.0 specification (RFC 1945) required the client to perform a temporary redirect (the original describing phrase was "Moved Temporarily"),[20] but popular browsers implemented 302 with the functionality of a 303 See Other. Therefore, HTTP/1.1 added status codes 303 and 307 to distinguish between the two behaviours.[21] However, some Web applications and frameworks use the 302 status code as if it were the 303.[22]
+  {303,"See Other"},//The response to the request can be found under another URI using a GET method. When received in response to a POST (or PUT/DELETE), the client should presume that the server has received the data and should issue a redirect with a separate GET message.[23]
+  {304,"Not Modified (RFC 7232)"},//Indicates that the resource has not been modified since the version specified by the request headers If-Modified-Since or If-None-Match. In such case, there is no need to retransmit the resource since the client still has a previously-downloaded copy.[24]
+  {305,"Use Proxy (since HTTP/1.1)"},//The requested resource is available only through a proxy, the address for which is provided in the response. Many HTTP clients (such as Mozilla[25] and Internet Explorer) do not correctly handle responses with this status code, primarily for security reasons.[26]
+  {306,"Switch Proxy"},//No longer used. Originally meant "Subsequent requests should use the specified proxy."[27]
+  {307,"Temporary Redirect (since HTTP/1.1)"},//In this case, the request should be repeated with another URI; however, future requests should still use the original URI. In contrast to how 302 was historically implemented, the request method is not allowed to be changed when reissuing the original request. For example, a POST request should be repeated using another POST request.[28]
+  {308,"Permanent Redirect (RFC 7538)"},//The request and all future requests should be repeated using another URI. 307 and 308 parallel the behaviors of 302 and 301, but do not allow the HTTP method to change. So, for example, submitting a form to a permanently redirected resource may continue smoothly.[29]
+  {400,"Bad Request"},//The server cannot or will not process the request due to an apparent client error (e.g., malformed request syntax, size too large, invalid request message framing, or deceptive request routing).[31]
+  {401,"Unauthorized (RFC 7235)"},//Similar to 403 Forbidden, but specifically for use when authentication is required and has failed or has not yet been provided. The response must include a WWW-Authenticate header field containing a challenge applicable to the requested resource. See Basic access authentication and Digest access authentication.[32] 401 semantically means "unauthenticated",[33] i.e. the user does not have the necessary credentials.
+  {402,"Payment Required"},//Reserved for future use. The original intention was that this code might be used as part of some form of digital cash or micropayment scheme, as proposed for example by GNU Taler[34], but that has not yet happened, and this code is not usually used. Google Developers API uses this status if a particular developer has exceeded the daily limit on requests.[35]
+  {403,"Forbidden"},//The request was valid, but the server is refusing action. The user might not have the necessary permissions for a resource, or may need an account of some sort.
+  {404,"Not Found"},//The requested resource could not be found but may be available in the future. Subsequent requests by the client are permissible.[36]
+  {405,"Method Not Allowed"},//A request method is not supported for the requested resource; for example, a GET request on a form that requires data to be presented via POST, or a PUT request on a read-only resource.
+  {406,"Not Acceptable"},//The requested resource is capable of generating only content not acceptable according to the Accept headers sent in the request.[37] See Content negotiation.
+  {407,"Proxy Authentication Required (RFC 7235)"},//The client must first authenticate itself with the proxy.[38]
+  {408,"Request Timeout"},//The server timed out waiting for the request. According to HTTP specifications: "The client did not produce a request within the time that the server was prepared to wait. The client MAY repeat the request without modifications at any later time."[39]
+  {409,"Conflict"},//Indicates that the request could not be processed because of conflict in the request, such as an edit conflict between multiple simultaneous updates.
+  {410,"Gone"},//Indicates that the resource requested is no longer available and will not be available again. This should be used when a resource has been intentionally removed and the resource should be purged. Upon receiving a 410 status code, the client should not request the resource in the future. Clients such as search engines should remove the resource from their indices.[40] Most use cases do not require clients and search engines to purge the resource, and a "404 Not Found" may be used instead.
+  {411,"Length Required"},//The request did not specify the length of its content, which is required by the requested resource.[41]
+  {412,"Precondition Failed (RFC 7232)"},//The server does not meet one of the preconditions that the requester put on the request.[42]
+  {413,"Payload Too Large (RFC 7231)"},//The request is larger than the server is willing or able to process. Previously called "Request Entity Too Large".[43]
+  {414,"URI Too Long (RFC 7231)"},//The URI provided was too long for the server to process. Often the result of too much data being encoded as a query-string of a GET request, in which case it should be converted to a POST request.[44] Called "Request-URI Too Long" previously.[45]
+  {415,"Unsupported Media Type"},//The request entity has a media type which the server or resource does not support. For example, the client uploads an image as image/svg+xml, but the server requires that images use a different format.
+  {416,"Range Not Satisfiable (RFC 7233)"},//The client has asked for a portion of the file (byte serving), but the server cannot supply that portion. For example, if the client asked for a part of the file that lies beyond the end of the file.[46] Called "Requested Range Not Satisfiable" previously.[47]
+  {417,"Expectation Failed"},//The server cannot meet the requirements of the Expect request-header field.[48]
+  {418,"I'm a teapot (RFC 2324)"},//This code was defined in 1998 as one of the traditional IETF April Fools' jokes, in RFC 2324, Hyper Text Coffee Pot Control Protocol, and is not expected to be implemented by actual HTTP servers. The RFC specifies this code should be returned by teapots requested to brew coffee.[49] This HTTP status is used as an Easter egg in some websites, including Google.com.[50]
+  {421,"Misdirected Request (RFC 7540)"},//The request was directed at a server that is not able to produce a response (for example because a connection reuse).[51]
+  {422,"Unprocessable Entity (WebDAV; RFC 4918)"},//The request was well-formed but was unable to be followed due to semantic errors.[15]
+  {423,"Locked (WebDAV; RFC 4918)"},//The resource that is being accessed is locked.[15]
+  {424,"Failed Dependency (WebDAV; RFC 4918)"},//The request failed due to failure of a previous request (e.g., a PROPPATCH).[15]
+  {426,"Upgrade Required"},//The client should switch to a different protocol such as TLS/1.0, given in the Upgrade header field.[52]
+  {428,"Precondition Required (RFC 6585)"},//The origin server requires the request to be conditional. Intended to prevent the 'lost update' problem, where a client GETs a resource's state, modifies it, and PUTs it back to the server, when meanwhile a third party has modified the state on the server, leading to a conflict."[53]
+  {429,"Too Many Requests (RFC 6585)"},//The user has sent too many requests in a given amount of time. Intended for use with rate-limiting schemes.[53]
+  {431,"Request Header Fields Too Large (RFC 6585)"},//The server is unwilling to process the request because either an individual header field, or all the header fields collectively, are too large.[53]
+  {451,"Unavailable For Legal Reasons (RFC 7725)"},//A server operator has received a legal demand to deny access to a resource or to a set of resources that includes the requested resource.[54] The code 451 was chosen as a reference to the novel Fahrenheit 451.
+  {500,"Internal Server Error"},//A generic error message, given when an unexpected condition was encountered and no more specific message is suitable.[57]
+  {501,"Not Implemented"},//The server either does not recognize the request method, or it lacks the ability to fulfil the request. Usually this implies future availability (e.g., a new feature of a web-service API).[58]
+  {502,"Bad Gateway"},//The server was acting as a gateway or proxy and received an invalid response from the upstream server.[59]
+  {503,"Service Unavailable"},//The server is currently unavailable (because it is overloaded or down for maintenance). Generally, this is a temporary state.[60]
+  {504,"Gateway Timeout"},//The server was acting as a gateway or proxy and did not receive a timely response from the upstream server.[61]
+  {505,"HTTP Version Not Supported"},//The server does not support the HTTP protocol version used in the request.[62]
+  {506,"Variant Also Negotiates (RFC 2295)"},//Transparent content negotiation for the request results in a circular reference.[63]
+  {507,"Insufficient Storage (WebDAV; RFC 4918)"},//The server is unable to store the representation needed to complete the request.[15]
+  {508,"Loop Detected (WebDAV; RFC 5842)"},//The server detected an infinite loop while processing the request (sent in lieu of 208 Already Reported).
+  {510,"Not Extended (RFC 2774)"},//Further extensions to the request are required for the server to fulfil it.[64]
+  {511,"Network Authentication Required (RFC 6585)"},//The client needs to authenticate to gain network access. Intended for use by intercepting proxies used to control access to the network (e.g., "captive portals" used to require agreement to Terms of Service before granting full Internet access via a Wi-Fi hotspot).[53]
+  {103,"Checkpoint"},//Used in the resumable requests proposal to resume aborted PUT or POST requests.[65]
+  {103,"Early Hints"},//Used to return some response headers before entire HTTP response.[66][67]
+  {420,"Method Failure (Spring Framework)"},//A deprecated response used by the Spring Framework when a method has failed.[68]
+  {420,"Enhance Your Calm (Twitter)"},//Returned by version 1 of the Twitter Search and Trends API when the client is being rate limited; versions 1.1 and later use the 429 Too Many Requests response code instead.[69]
+  {450,"Blocked by Windows Parental Controls (Microsoft)"},//The Microsoft extension code indicated when Windows Parental Controls are turned on and are blocking access to the requested webpage.[70]
+  {498,"Invalid Token (Esri)"},//Returned by ArcGIS for Server. Code 498 indicates an expired or otherwise invalid token.[71]
+  {499,"Token Required (Esri)"},//Returned by ArcGIS for Server. Code 499 indicates that a token is required but was not submitted.[71]
+  {509,"Bandwidth Limit Exceeded (Apache Web Server/cPanel)"},//The server has exceeded the bandwidth specified by the server administrator; this is often used by shared hosting providers to limit the bandwidth of customers.[72]
+  {530,"Site is frozen"},//Used by the Pantheon web platform to indicate a site that has been frozen due to inactivity.[73]
+  {598,"(Informal convention) Network read timeout error"},//Used by some HTTP proxies to signal a network read timeout behind the proxy to a client in front of the proxy.[74][75]
+  {599,"(Informal convention) Network connect timeout error"},//Used to indicate when the connection to the network times out.[76][citation needed]
+  {440,"Login Time-out"},//The client's session has expired and must log in again.[77]
+  {449,"Retry With"},//The server cannot honour the request because the user has not provided the required information.[78]
+  {451,"Redirect"},//Used in Exchange ActiveSync when either a more efficient server is available or the server cannot access the users' mailbox.[79] The client is expected to re-run the HTTP AutoDiscover operation to find a more appropriate server.[80]
+  {444,"No Response"},//Used to indicate that the server has returned no information to the client and closed the connection.
+  {495,"SSL Certificate Error"},//An expansion of the 400 Bad Request response code, used when the client has provided an invalid client certificate.
+  {496,"SSL Certificate Required"},//An expansion of the 400 Bad Request response code, used when a client certificate is required but not provided.
+  {497,"HTTP Request Sent to HTTPS Port"},//An expansion of the 400 Bad Request response code, used when the client has made a HTTP request to a port listening for HTTPS requests.
+  {499,"Client Closed Request"},//Used when the client has closed the request before the server could send a response.
+  {520,"Unknown Error"},//The 520 error is used as a "catch-all response for when the origin server returns something unexpected", listing connection resets, large headers, and empty or invalid responses as common triggers.
+  {521,"Web Server Is Down"},//The origin server has refused the connection from Cloudflare.
+  {522,"Connection Timed Out"},//Cloudflare could not negotiate a TCP handshake with the origin server.
+  {523,"Origin Is Unreachable"},//Cloudflare could not reach the origin server; for example, if the DNS records for the origin server are incorrect.
+  {524,"A Timeout Occurred"},//Cloudflare was able to complete a TCP connection to the origin server, but did not receive a timely HTTP response.
+  {525,"SSL Handshake Failed"},//Cloudflare could not negotiate a SSL/TLS handshake with the origin server.
+  {526,"Invalid SSL Certificate"},//Cloudflare could not validate the SSL/TLS certificate that the origin server presented.
+  {527,"Railgun Error"},//Error 527 indicates that the request timed out or failed after the WAN connection had been established.[84]
+};
+//! Tablice statusów indeksowane kodem.
+struct status_table_t {
+  //! Komunikaty.
+  const char * reason[1000];
+  //! Gotowe status line dla HTTP/1.0 i HTTP/1.1 (pusty tekst, jeśli kod nie ma komunikatu).
+  std::string line[2][1000];
+  status_table_t(){
+    for (const char * & r : reason) r=nullptr;
+    for (const status_t & s : status_reasons) if (!reason[s.code]) reason[s.code]=s.reason;
+    for (std::size_t v=0;v<2;v++) for (std::size_t c=0;c<1000;c++) if (reason[c]){
+      line[v][c]=versionName((version_t)(version_1_0+v))+space+std::to_string(c)+space+reason[c]+endl;
+    }
+  }
 };
+static const status_table_t & status_table(){
+  static const status_table_t t;
+  return(t);
+}
+const char * statusReason(unsigned int code){
+  if (code<1000) return(status_table().reason[code]);
+  return(nullptr);
+}
+const std::string * statusLine(version_t version,const std::string & code,const std::string & reason){
+  unsigned int c(0);
+  if ((version!=version_1_0)&&(version!=version_1_1)) return(nullptr);
+  if (code.size()!=3) return(nullptr);
+  for (char d : code){
+    if ((d<'0')||('9'<d)) return(nullptr);
+    c=c*10+(d-'0');
+  }
+  const status_table_t & t(status_table());
+  if ((!t.reason[c])||(reason!=t.reason[c])) return(nullptr);
+  return(&t.line[version-version_1_0][c]);
+}
+std::string httpDate(std::time_t time){
+  static const char * const days[]={"Sun","Mon","Tue","Wed","Thu","Fri","Sat"};
+  static const char * const months[]={"Jan","Feb","Mar","Apr","May","Jun","Jul","Aug","Sep","Oct","Nov","Dec"};
+  std::tm t;
+  char buffer[32];
+  gmtime_r(&time,&t);
+  std::snprintf(buffer,sizeof(buffer),"%s, %02d %s %04d %02d:%02d:%02d GMT",days[t.tm_wday],t.tm_mday,months[t.tm_mon],t.tm_year+1900,t.tm_hour,t.tm_min,t.tm_sec);
+  return(buffer);
+}
+const std::string & httpDate(){
+  thread_local std::time_t last(-1);
+  thread_local std::string date;
+  std::time_t now(std::time(nullptr));
+  if (now!=last){
+    date=httpDate(now);
+    last=now;
+  }
+  return(date);
+}
+//============================================
+view_t Fields::store(const char * data,std::size_t size,bool lower){
+  view_t v={text.size(),size};
+  text.append(data,size);
+  if (lower) for (std::size_t k=v.offset;k<text.size();k++){
+    char c(text[k]);
+    text[k]=::isascii(c)?::tolower(c):'_';
+  }
+  return(v);
+}
+bool Fields::match(const entry_t & entry,header_t id,const std::string & name) const{
+  if (entry.id!=id) return(false);
+  if (id!=header_other) return(true);
+  if (entry.name.size!=name.size()) return(false);
+  for (std::size_t k=0;k<name.size();k++)
+    if (text[entry.name.offset+k]!=(::isascii(name[k])?::tolower(name[k]):'_')) return(false);
+  return(true);
+}
+void Fields::add(header_t id,const std::string & name,const std::string & value){
+  entry_t e;
+  e.id=id;
+  e.name=(id==header_other)?store(name.data(),name.size(),true):view_t({0,0});
+  e.value=store(value.data(),value.size(),false);
+  entries.push_back(e);
+}
+std::size_t Fields::erase(header_t id,const std::string & name){
+  std::size_t n(entries.size());
+  entries.erase(std::remove_if(entries.begin(),entries.end(),[&](const entry_t & e){return(match(e,id,name));}),entries.end());
+  return(n-entries.size());
+}
+std::size_t Fields::count(header_t id,const std::string & name) const{
+  std::size_t n(0);
+  for (const entry_t & e : entries) if (match(e,id,name)) n++;
+  return(n);
+}
+::boost::string_ref Fields::get(header_t id,const std::string & name) const{
+  for (const entry_t & e : entries) if (match(e,id,name)) return(value(e));
+  return(::boost::string_ref());
+}
+::boost::string_ref Fields::name(const entry_t & entry) const{
+  if (entry.id!=header_other) return(::boost::string_ref(headerName(entry.id)));
+  return(::boost::string_ref(text.data()+entry.name.offset,entry.name.size));
+}
+//============================================
+HeadersConfig::HeadersConfig(const config_t & config,const header_config_t & default_config):fallback(default_config){
+  for (header_config_t & c : known) c=fallback;
+  for (const config_t::value_type & c : config){
+    std::string name(c.first);
+    for (char & k : name) k=::isascii(k)?::tolower(k):'_';
+    header_t id(headerId(name));
+    if (id==header_other){
+      other.emplace_back(name,c.second);
+    } else {
+      known[id]=c.second;
+    }
+  }
+  std::sort(other.begin(),other.end(),[](const std::pair<std::string,header_config_t> & a,const std::pair<std::string,header_config_t> & b){
+    return(a.first<b.first);
+  });
+}
+const header_config_t & HeadersConfig::get(header_t id,::boost::string_ref name) const{
+  if (id!=header_other) return(known[id]);
+  if (other.empty()) return(fallback);
+  std::vector<std::pair<std::string,header_config_t>>::const_iterator it(std::lower_bound(other.begin(),other.end(),name,[](const std::pair<std::string,header_config_t> & a,::boost::string_ref b){
+    return(::boost::string_ref(a.first)<b);
+  }));
+  if ((it!=other.end())&&(::boost::string_ref(it->first)==name)) return(it->second);
+  return(fallback);
+}
+const config_t & defaultHeadersConfig(){
+  static const config_t config={
+    {_content_length_,      {.multiple_values=false,.multiple_lines=false}},
+    {_content_type_,        {.multiple_values=false,.multiple_lines=false}}
+  };
+  return(config);
+}
+const header_config_t & defaultHeaderConfig(){
+  static const header_config_t config={.multiple_values=true,.multiple_lines=true};
+  return(config);
+}
+//! Aktualna konfiguracja nagłówków.
+static headers_config_ptr_t & headers_config(){
+  static headers_config_ptr_t config(std::make_shared<const HeadersConfig>(defaultHeadersConfig(),defaultHeaderConfig()));
+  return(config);
+}
+headers_config_ptr_t headersConfig(){
+  return(std::atomic_load(&headers_config()));
+}
+void setHeadersConfig(const config_t & config,const header_config_t & default_config){
+  std::atomic_store(&headers_config(),headers_config_ptr_t(std::make_shared<const HeadersConfig>(config,default_config)));
+}
 //============================================
 void Headers::transform_name(std::string & name){
   std::transform(name.begin(),name.end(),name.begin(),[](char c)->char{
@@ -86,23 +404,92 @@ void Headers::transform_value(std::string & value){
   value.erase(std::find_if(value.rbegin(),value.rend(),std::not1(std::ptr_fun<int,int>(std::isspace))).base(),value.end());
 }
 void Headers::headerKeyValueParser(const std::string & input,std::map<std::string,std::string> & output){
-  std::string s(input);
-  std::smatch m;
-  std::regex e("\\s*([^;=]+)\\s*(=([^;]*))?;?");
+  std::vector<param_t> params;
   output.clear();
-  while (std::regex_search(s,m,e)) {
-    if (m.size()==2){
-      output[m[1]]="";
-    } else if (m.size()>3){
-      std::string tmp(m[3]);
-      if ((tmp.front()=='"')&&(tmp.back()=='"')){
-        output[m[1]]=tmp.substr(1,tmp.size()-2);
-      } else {
-        output[m[1]]=tmp;
-      }
+  parseParams(input,';',params);
+  for (const param_t & p : params) output[p.name.to_string()]=p.value.to_string();
+}
+const std::vector<param_t> & Headers::headParams(header_t id,char separator) const{
+  params_cache_t * cache(nullptr);
+  for (params_cache_t & c : params_cache) if ((c.id==id)&&(c.separator==separator)) cache=&c;
+  if (!cache) for (params_cache_t & c : params_cache) if (!c.parsed) {
+    cache=&c;
+    break;
+  }
+  if (!cache){
+    params_cache.emplace_back();
+    cache=&params_cache.back();
+    cache->parsed=false;
+  }
+  if ((!cache->parsed)||(cache->id!=id)||(cache->separator!=separator)){
+    cache->id=id;
+    cache->separator=separator;
+    cache->parsed=true;
+    cache->list.clear();
+    for (const field_t & f : head_fields) if (f.id==id) parseParams(::boost::string_ref(head.data()+f.value.offset,f.value.size),separator,cache->list);
+  }
+  return(cache->list);
+}
+const std::vector<forwarded_t> & Headers::headForwarded() const{
+  if (!forwarded_parsed){
+    forwarded_parsed=true;
+    forwarded_cache.clear();
+    for (const field_t & f : head_fields) if (f.id==header_forwarded) parseForwarded(::boost::string_ref(head.data()+f.value.offset,f.value.size),forwarded_cache);
+  }
+  return(forwarded_cache);
+}
+bool Headers::headEqual(const view_t & view,const std::string & text) const{
+  if (view.size!=text.size()) return(false);
+  for (std::size_t k=0;k<view.size;k++)
+    if (::tolower((unsigned char)head[view.offset+k])!=::tolower((unsigned char)text[k])) return(false);
+  return(true);
+}
+bool Headers::headSingleHeader(const std::string & name,std::string & value) const{
+  header_t id(headerId(name));
+  if (id!=header_other) return(headSingleHeader(id,value));
+  value.clear();
+  for (const field_t & f : head_fields) if ((f.id==header_other)&&headEqual(f.name,name)){
+    //Pierwsza wartość (do przecinka).
+    std::size_t e(head.find(comma,f.value.offset));
+    if ((e==std::string::npos)||(e>(f.value.offset+f.value.size))) e=f.value.offset+f.value.size;
+    value.assign(head,f.value.offset,e-f.value.offset);
+    transform_value(value);
+    return(true);
+  }
+  return(false);
+}
+bool Headers::headSingleHeader(header_t id,std::string & value) const{
+  value.clear();
+  for (const field_t & f : head_fields) if (f.id==id){
+    //Pierwsza wartość (do przecinka).
+    std::size_t e(head.find(comma,f.value.offset));
+    if ((e==std::string::npos)||(e>(f.value.offset+f.value.size))) e=f.value.offset+f.value.size;
+    value.assign(head,f.value.offset,e-f.value.offset);
+    transform_value(value);
+    return(true);
+  }
+  return(false);
+}
+::boost::string_ref Headers::headValue(header_t id) const{
+  for (const field_t & f : head_fields) if (f.id==id) return(::boost::string_ref(head.data()+f.value.offset,f.value.size));
+  return(::boost::string_ref());
+}
+headers_t Headers::headHeaders() const{
+  headers_t headers;
+  for (const field_t & f : head_fields){
+    std::string header_name(headString(f.name));
+    std::string h(headString(f.value));
+    std::size_t c;
+    while((c=h.find(comma))!=std::string::npos){
+      std::string header_value(h.substr(0,c));
+      h.erase(0,c+comma.size());
+      transform_value(header_value);
+      headers.add(header_name,header_value);
     }
-    s=m.suffix().str();
+    transform_value(h);
+    headers.add(header_name,h);
   }
+  return(headers);
 }
 std::string Headers::headerSetCookieHeader(const std::string & name,const std::string & value,ict::time::unix_t maxAge,const std::string & path,const std::string & domain,bool secure,bool httpOnly){
   std::string out;
@@ -133,63 +520,75 @@ std::string Headers::headerSetCookieHeader(const std::string & name,const std::s
   }
   return(out);
 }
-//! Odczytuje pierwszy lub drugi element start line.
-int Headers::read_start_element(std::string & output,std::size_t min,std::size_t max,const std::string & descr){
+//! Sprawdza i dzieli na elementy start line.
+int Headers::parse_start_line(std::size_t begin,std::size_t end){
   const static std::string _too_big_(" - too big...");
   const static std::string _too_small_(" - too small...");
   const static std::string _missing_(" - missing...");
-  if (!output.size()){
-    std::size_t e=readString.find(endl);
-    std::size_t s=readString.find(space);
-    if (e==std::string::npos){//Końca linii nie znaleziono.
-      if (s==std::string::npos){//Spacji nie znaleziono.
-          if (readString.size()>max){
-            LOGGER_WARN<<__LOGGER__<<descr<<_too_big_<<std::endl;
-            return(-1);
-          } else {
-            return(1);//Nie wszystkie dane.
-          }
-        } else {//Spację znaleziono.
-          if (s>max){
-            LOGGER_WARN<<__LOGGER__<<descr<<_too_big_<<std::endl;
-            return(-1);
-          } else if (s<min) {
-            LOGGER_WARN<<__LOGGER__<<descr<<_too_small_<<std::endl;
-            return(-1);
-          } else {
-            output=readString.substr(0,s);
-            readString.erase(0,s+space.size());
-            transform_value(output);
-          }
-        }
-      } else {//Koniec linii znaleziono.
-        if (s==std::string::npos){//Spacji nie znaleziono.
-          LOGGER_WARN<<__LOGGER__<<descr<<_missing_<<std::endl;
-          return(-1);
-        } else {//Spację znaleziono.
-          if (e>s){//Spacja przed końcem linii.
-            if (s>max){
-              LOGGER_WARN<<__LOGGER__<<descr<<_too_big_<<std::endl;
-              return(-1);
-            } else if (s<min) {
-              LOGGER_WARN<<__LOGGER__<<descr<<_too_small_<<std::endl;
-              return(-1);
-            } else {
-              output=readString.substr(0,s);
-              readString.erase(0,s+space.size());
-              transform_value(output);
-            }
-          } else {//Spacja po końcu linii.
-            LOGGER_WARN<<__LOGGER__<<descr<<_missing_<<std::endl;
-            return(-1);
-          }
-        }
-      }
+  //Limity elementów: request - metoda, URI, wersja; response - wersja, kod, komunikat.
+  const static std::size_t min_request[2]={3,1};
+  const static std::size_t max_request[3]={10,10000,10};
+  const static std::size_t min_response[2]={1,3};
+  const static std::size_t max_response[3]={10,4,1000};
+  const static std::string descr_request[3]={"HTTP request method","HTTP request URI","HTTP request version"};
+  const static std::string descr_response[3]={"HTTP response version","HTTP response code","HTTP response message"};
+  const std::size_t * min(server?min_request:min_response);
+  const std::size_t * max(server?max_request:max_response);
+  const std::string * descr(server?descr_request:descr_response);
+  std::size_t b(begin);
+  for (std::size_t k=0;k<2;k++){
+    std::size_t s(readString.find(space[0],b));
+    if ((s==std::string::npos)||(s>end)){
+      LOGGER_WARN<<__LOGGER__<<descr[k]<<_missing_<<std::endl;
+      return(-1);
+    } else if ((s-b)>max[k]){
+      LOGGER_WARN<<__LOGGER__<<descr[k]<<_too_big_<<std::endl;
+      return(-1);
+    } else if ((s-b)<min[k]){
+      LOGGER_WARN<<__LOGGER__<<descr[k]<<_too_small_<<std::endl;
+      return(-1);
+    }
+    head_start[k]={b,s-b};
+    b=s+space.size();
+  }
+  if ((end-b)>max[2]){
+    LOGGER_WARN<<__LOGGER__<<descr[2]<<_too_big_<<std::endl;
+    return(-1);
+  }
+  head_start[2]={b,end-b};
+  return(0);
+}
+//! Sprawdza i dodaje linię nagłówka.
+int Headers::parse_header_line(const scan::line_t & line){
+  const static std::string _too_small_(" - too small...");
+  const static std::string _too_big_(" - too big...");
+  const static std::string _missing_(" - missing...");
+  const static std::string _invalid_(" - invalid...");
+  const static std::size_t min_header_name_size(3);
+  const static std::size_t max_header_name_size(100);
+  std::size_t c(line.colon);
+  if (c==std::string::npos){
+    LOGGER_WARN<<__LOGGER__<<"HTTP header name"<<_missing_<<std::endl;
+    return(-1);
+  } else if ((c-line.begin)>max_header_name_size){
+    LOGGER_WARN<<__LOGGER__<<"HTTP header name"<<_too_big_<<std::endl;
+    return(-1);
+  } else if ((c-line.begin)<min_header_name_size){
+    LOGGER_WARN<<__LOGGER__<<"HTTP header name"<<_too_small_<<std::endl;
+    return(-1);
+  } else if (!line.token){
+    LOGGER_WARN<<__LOGGER__<<"HTTP header name"<<_invalid_<<std::endl;
+    return(-1);
   }
-  return(0);//Odczytano element.
+  std::size_t b(c+colon.size());
+  std::size_t e(line.end);
+  while ((b<e)&&((readString[b]==' ')||(readString[b]=='\t'))) b++;
+  while ((b<e)&&((readString[e-1]==' ')||(readString[e-1]=='\t'))) e--;
+  head_fields.push_back({headerId(readString.data()+line.begin,c-line.begin),{line.begin,c-line.begin},{b,e-b}});
+  return(0);
 }
-//! Zapisuje pierwszy lub drugi element start line.
-int Headers::write_start_element(std::string & input,std::size_t min,std::size_t max,const std::string & descr){
+//! Zapisuje element start line do linii.
+int Headers::write_start_element(std::string & line,const std::string & input,std::size_t min,std::size_t max,const std::string & descr){
   const static std::string _too_big_(" - too big...");
   const static std::string _too_small_(" - too small...");
   if (input.size()){
@@ -200,58 +599,22 @@ int Headers::write_start_element(std::string & input,std::size_t min,std::size_t
       LOGGER_ERR<<__LOGGER__<<descr<<_too_small_<<std::endl;
       return(-1);
     } else {
-      if ((writeString.size()+input.size()+space.size())<writeString.max_size()){
-        writeString+=input+space;
-        input.clear();
-      } else {
-        return(1);
-      }
+      line+=input;
+      line+=space;
     }
   }
   return(0);
 }
-//! Odczytuje trzeci element start line (opcjonalny).
-int Headers::read_start_last(std::string & output,std::size_t max,const std::string & descr){
-  const static std::string _too_big_(" - too big...");
-  if (!output.size()){
-    std::size_t e=readString.find(endl);
-    if (e==std::string::npos){//Końca linii nie znaleziono.
-      if (readString.size()>max){
-        LOGGER_WARN<<__LOGGER__<<descr<<_too_big_<<std::endl;
-        return(-1);
-      } else {
-        return(1);//Nie wszystkie dane.
-      }
-    } else {//Koniec linii znaleziono.
-      if (e>max){
-        LOGGER_WARN<<__LOGGER__<<descr<<_too_big_<<std::endl;
-        return(-1);
-      } else if (e>0) {
-        output=readString.substr(0,e);
-        readString.erase(0,e+endl.size());
-        transform_value(output);
-      } else {
-        output="_";
-        readString.erase(0,e+endl.size());
-      }
-    }
-  }
-  return(0);//Odczytano element.
-}
-//! Zapisuje trzeci element start line (opcjonalny).
-int Headers::write_start_last(std::string & input,std::size_t max,const std::string & descr){
+//! Zapisuje ostatni element start line do linii.
+int Headers::write_start_last(std::string & line,const std::string & input,std::size_t max,const std::string & descr){
   const static std::string _too_big_(" - too big...");
   if (input.size()){
     if (input.size()>max) {
       LOGGER_ERR<<__LOGGER__<<descr<<_too_big_<<std::endl;
       return(-1);
     } else {
-      if ((writeString.size()+input.size()+endl.size())<writeString.max_size()){
-        writeString+=input+endl;
-        input.clear();
-      } else {
-        return(1);
-      }
+      line+=input;
+      line+=endl;
     }
   }
   return(0);
@@ -262,18 +625,6 @@ int Headers::write_start_last(std::string & input,std::size_t max,const std::str
     case 1:return(1);\
     default:return(-1);\
   }
-//! Odczytuje start line (dla request).
-int Headers::read_request_line(){
-  static const std::size_t min_method_size(3);
-  static const std::size_t max_method_size(10);
-  static const std::size_t min_uri_size(1);
-  static const std::size_t max_uri_size(10000);
-  static const std::size_t max_version_size(10);
-  READ_WRITE_1(read_start_element(request_method,min_method_size,max_method_size,"HTTP request method"))
-  READ_WRITE_1(read_start_element(request_uri,min_uri_size,max_uri_size,"HTTP request URI"))
-  READ_WRITE_1(read_start_last(request_version,max_version_size,"HTTP request version"))
-  return(0);
-}
 //! Zapisuje start line (dla request).
 int Headers::write_request_line(){
   static const std::size_t min_method_size(3);
@@ -281,21 +632,14 @@ int Headers::write_request_line(){
   static const std::size_t min_uri_size(1);
   static const std::size_t max_uri_size(10000);
   static const std::size_t max_version_size(10);
-  READ_WRITE_1(write_start_element(request_method,min_method_size,max_method_size,"HTTP request method"))
-  READ_WRITE_1(write_start_element(request_uri,min_uri_size,max_uri_size,"HTTP request URI"))
-  READ_WRITE_1(write_start_last(request_version,max_version_size,"HTTP request version"))
-  return(0);
-}
-//! Odczytuje start line (dla response).
-int Headers::read_status_line(){
-  static const std::size_t min_version_size(1);
-  static const std::size_t max_version_size(10);
-  static const std::size_t min_code_size(3);
-  static const std::size_t max_code_size(4);
-  static const std::size_t max_msg_size(1000);
-  READ_WRITE_1(read_start_element(response_version,min_version_size,max_version_size,"HTTP response version"))
-  READ_WRITE_1(read_start_element(response_code,min_code_size,max_code_size,"HTTP response code"))
-  READ_WRITE_1(read_start_last(response_msg,max_msg_size,"HTTP response message"))
+  std::string line;
+  if (write_start) return(0);
+  READ_WRITE_1(write_start_element(line,methodName(request_method),min_method_size,max_method_size,"HTTP request method"))
+  READ_WRITE_1(write_start_element(line,request_uri,min_uri_size,max_uri_size,"HTTP request URI"))
+  READ_WRITE_1(write_start_last(line,versionName(request_version),max_version_size,"HTTP request version"))
+  if ((writeString.size()+line.size())>=writeString.max_size()) return(1);
+  writeString+=line;
+  write_start=true;
   return(0);
 }
 //! Zapisuje start line (dla response).
@@ -305,268 +649,504 @@ int Headers::write_status_line(){
   static const std::size_t min_code_size(3);
   static const std::size_t max_code_size(4);
   static const std::size_t max_msg_size(1000);
-  READ_WRITE_1(write_start_element(response_version,min_version_size,max_version_size,"HTTP response version"))
-  READ_WRITE_1(write_start_element(response_code,min_code_size,max_code_size,"HTTP response code"))
-  READ_WRITE_1(write_start_last(response_msg,max_msg_size,"HTTP response message"))
+  std::string line;
+  if (write_start) return(0);
+  const std::string * status(statusLine(response_version,response_code,response_msg));
+  if (status){//Gotowa status line.
+    if ((writeString.size()+status->size())>=writeString.max_size()) return(1);
+    writeString+=*status;
+    write_start=true;
+    return(0);
+  }
+  READ_WRITE_1(write_start_element(line,versionName(response_version),min_version_size,max_version_size,"HTTP response version"))
+  READ_WRITE_1(write_start_element(line,response_code,min_code_size,max_code_size,"HTTP response code"))
+  READ_WRITE_1(write_start_last(line,response_msg,max_msg_size,"HTTP response message"))
+  if ((writeString.size()+line.size())>=writeString.max_size()) return(1);
+  writeString+=line;
+  write_start=true;
   return(0);
 }
-//! Odczytuje nagłówki.
-int Headers::read_headers(headers_t & headers){
+//! Dopisuje wartość nagłówka (bez białych znaków na początku i końcu, znaki spoza ASCII są zamieniane na '_').
+static void append_value(std::string & output,::boost::string_ref value){
+  while (value.size()&&std::isspace((unsigned char)value.front())) value.remove_prefix(1);
+  while (value.size()&&std::isspace((unsigned char)value.back())) value.remove_suffix(1);
+  std::size_t begin(output.size());
+  output.append(value.data(),value.size());
+  for (std::size_t k=begin;k<output.size();k++) if (!::isascii(output[k])) output[k]='_';
+}
+//! Zwraca rozmiar nagłówków po zapisie (z zapasem).
+static std::size_t headers_size(const headers_t & headers){
+  std::size_t size(0);
+  for (const headers_t::entry_t & e : headers) size+=headers.name(e).size()+colon.size()+space.size()+e.value.size+endl.size();
+  return(size);
+}
+//! Dopisuje linie nagłówków (bez pustej linii kończącej nagłówki) - w razie błędu output nie jest zmieniany.
+static int append_headers(std::string & output,const headers_t & headers){
   const static std::string _too_big_(" - too big...");
   const static std::string _too_small_(" - too small...");
-  const static std::string _missing_(" - missing...");
   const static std::size_t max_header_line_size(10000);
-  const static std::size_t min_header_name_size(3);
+  const static std::size_t min_header_name_size(2);
   const static std::size_t max_header_name_size(100);
-  std::size_t e;
-  while((e=readString.find(endl))!=std::string::npos){
-    if (e==0){
-      readString.erase(0,endl.size());
-      return(0);//Koniec nagłówków.
-    } else if (e>max_header_line_size){
-      LOGGER_WARN<<__LOGGER__<<"HTTP header line"<<_too_big_<<std::endl;
+  const headers_config_ptr_t config(headersConfig());
+  const std::size_t begin(output.size());
+  for (headers_t::const_iterator it=headers.begin();it!=headers.end();++it){
+    ::boost::string_ref header_name(headers.name(*it));
+    bool done(false);
+    //Pola o tej samej nazwie są zapisywane razem z pierwszym z nich.
+    for (headers_t::const_iterator p=headers.begin();(p!=it)&&!done;++p)
+      if ((p->id==it->id)&&(headers.name(*p)==header_name)) done=true;
+    if (done||!header_name.size()) continue;
+    const header_config_t & header_config(config->get(it->id,header_name));
+    if (header_name.size()>max_header_name_size){
+      LOGGER_ERR<<__LOGGER__<<"HTTP header name"<<_too_big_<<std::endl;
+      output.resize(begin);
       return(-1);
-    } else {
-      std::string h(readString.substr(0,e));
-      std::size_t c=h.find(colon);
-      readString.erase(0,e+endl.size());
-      if (c==std::string::npos){
-        LOGGER_WARN<<__LOGGER__<<"HTTP header name"<<_missing_<<std::endl;
-        return(-1);
+    } else if (header_name.size()<min_header_name_size){
+      LOGGER_ERR<<__LOGGER__<<"HTTP header name"<<_too_small_<<std::endl;
+      output.resize(begin);
+      return(-1);
+    }
+    std::size_t line(output.size());
+    bool first=true;
+    for (headers_t::const_iterator v=it;v!=headers.end();++v){
+      if ((v->id!=it->id)||(headers.name(*v)!=header_name)) continue;
+      if (header_config.multiple_lines||first){
+        line=output.size();
+        output.append(header_name.data(),header_name.size());
+        output+=colon;
+        output+=space;
       } else {
-        if (c>max_header_name_size){
-          LOGGER_WARN<<__LOGGER__<<"HTTP header name"<<_too_big_<<std::endl;
-          return(-1);
-        } else if (c<min_header_name_size) {
-          LOGGER_WARN<<__LOGGER__<<"HTTP header name"<<_too_small_<<std::endl;
-          return(-1);
-        } else {
-          header_config_t header_config(default_config);
-          std::string header_name(h.substr(0,c));
-          transform_name(header_name);
-          if  (config.count(header_name)) header_config=config.at(header_name);
-          h.erase(0,c+colon.size());
-          while((c=h.find(comma))!=std::string::npos){
-            std::string header_value(h.substr(0,c));
-            h.erase(0,c+comma.size());
-            transform_value(header_value);
-            headers[header_name].push_back(header_value);
-          }
-          transform_value(h);
-          headers[header_name].push_back(h);
-        }
+        output+=comma;
       }
+      append_value(output,headers.value(*v));
+      if (header_config.multiple_lines) output+=endl;
+      if ((output.size()-line)>max_header_line_size){
+        LOGGER_ERR<<__LOGGER__<<"HTTP header line"<<_too_big_<<std::endl;
+        output.resize(begin);
+        return(-1);
+      }
+      first=false;
+      if (!header_config.multiple_values) break;
     }
+    if (!header_config.multiple_lines) output+=endl;
   }
-  return(1);//Nie wszystkie nagłówki - czekaj.
+  return(0);
 }
 //! Zapisuje nagłówki.
-int Headers::write_headers(headers_t & headers){
-  const static std::string _too_big_(" - too big...");
-  const static std::string _too_small_(" - too small...");
-  const static std::string _missing_(" - missing...");
-  const static std::size_t max_header_line_size(10000);
-  const static std::size_t min_header_name_size(5);
-  const static std::size_t max_header_name_size(100);
-  while (headers.size()){
-    headers_t::const_iterator it=headers.cbegin();
-    header_config_t header_config(default_config);
-    std::string header_name(it->first);
-    if (header_name.size()){
-      transform_name(header_name);
-      if  (config.count(header_name)) header_config=config.at(header_name);
-      if (header_name.size()>max_header_name_size){
-        LOGGER_ERR<<__LOGGER__<<"HTTP header name"<<_too_big_<<std::endl;
-        return(-1);
-      } else if (header_name.size()<min_header_name_size){
-        LOGGER_ERR<<__LOGGER__<<"HTTP header name"<<_too_small_<<std::endl;
-        return(-1);
-      } else {
-        std::string output;
-        if (header_config.multiple_lines){
-          for (const std::string & v : it->second){
-            std::string header_value(v);
-            transform_value(header_value);
-            if ((header_name.size()+colon.size()+space.size()+header_value.size()+endl.size())>max_header_line_size){
-              LOGGER_ERR<<__LOGGER__<<"HTTP header line"<<_too_big_<<std::endl;
-              return(-1);
-            }
-            output+=header_name+colon+space+header_value+endl;
-            if (!header_config.multiple_values) break;
-          }
-        } else {
-          bool first=true;
-          output+=header_name+colon+space;
-          for (const std::string & v : it->second){
-            std::string header_value(v);
-            transform_value(header_value);
-            if (first){
-              first=false;
-            } else {
-              output+=comma;
-            }
-            output+=header_value;
-            if (!header_config.multiple_values) break;
-          }
-          output+=endl;
-          if (output.size()>max_header_line_size){
-            LOGGER_ERR<<__LOGGER__<<"HTTP header line"<<_too_big_<<std::endl;
-            return(-1);
-          }
-        }
-        if ((writeString.size()+output.size())<writeString.max_size()){
-          writeString+=output;
-        } else {
-          return(1);//Jeszcze poczekaj.
-        }
-      }
+int Headers::write_headers(headers_t & headers,bool date){
+  const static std::string _date_("date: ");
+  const std::size_t begin(writeString.size());
+  std::size_t size(endl.size()+headers_size(headers));
+  //Bufor wyjściowy jest powiększany tylko raz.
+  if (date) size+=_date_.size()+httpDate().size()+endl.size();
+  if ((begin+size)>=writeString.max_size()) return(1);//Jeszcze poczekaj.
+  writeString.reserve(begin+size);
+  if (date){
+    writeString+=_date_;
+    writeString+=httpDate();
+    writeString+=endl;
+  }
+  if (append_headers(writeString,headers)){
+    writeString.resize(begin);
+    return(-1);
+  }
+  writeString+=endl;//Koniec nagłówków.
+  headers.clear();
+  return(0);//Koniec nagłówków.
+}
+//! Czy znak jest białym znakiem w wartości nagłówka (OWS).
+static bool is_ows(char c){
+  return((c==' ')||(c=='\t'));
+}
+::boost::string_ref trimOws(::boost::string_ref value){
+  while (value.size()&&is_ows(value.front())) value.remove_prefix(1);
+  while (value.size()&&is_ows(value.back())) value.remove_suffix(1);
+  return(value);
+}
+bool equalNocase(::boost::string_ref a,::boost::string_ref b){
+  if (a.size()!=b.size()) return(false);
+  for (std::size_t k=0;k<a.size();k++) if (::tolower((unsigned char)a[k])!=::tolower((unsigned char)b[k])) return(false);
+  return(true);
+}
+//! Zwraca pozycję separatora poza cudzysłowem (lub rozmiar input).
+static std::size_t find_separator(::boost::string_ref input,std::size_t pos,char separator){
+  bool quoted(false);
+  for (;pos<input.size();pos++){
+    if (quoted){
+      if ((input[pos]=='\\')&&((pos+1)<input.size())) pos++;
+      else if (input[pos]=='"') quoted=false;
+    } else if (input[pos]=='"'){
+      quoted=true;
+    } else if (input[pos]==separator){
+      break;
     }
-    headers.erase(it->first);
-    if (!headers.size()) {//Koniec nagłówków.
-      if ((writeString.size()+endl.size())<writeString.max_size()){
-        writeString+=endl;
-      } else {
-        headers[""];//Jeszcze poczekaj.
-        return(1);
+  }
+  return(pos);
+}
+//! Przechodzi po parametrach "nazwa=wartość" lub "nazwa" rozdzielonych separatorem i wywołuje f(nazwa,wartość).
+template<class F> static void parse_pairs(::boost::string_ref input,char separator,F f){
+  std::size_t pos(0);
+  while (pos<input.size()){
+    std::size_t end(find_separator(input,pos,separator));
+    ::boost::string_ref item(input.substr(pos,end-pos));
+    std::size_t eq(item.find('='));
+    ::boost::string_ref name(trimOws(item.substr(0,eq)));
+    ::boost::string_ref value;
+    if (eq!=::boost::string_ref::npos){
+      value=trimOws(item.substr(eq+1));
+      if ((value.size()>=2)&&(value.front()=='"')&&(value.back()=='"')){
+        value.remove_prefix(1);
+        value.remove_suffix(1);
       }
     }
+    if (name.size()) f(name,value);
+    pos=end+1;
   }
-  return(0);//Koniec nagłówków.
 }
-//! Odczytuje start line i nagłówki (dla request).
-int Headers::read_request(){
-  READ_WRITE_1(read_request_line())
-  READ_WRITE_1(read_headers(request_headers))
+void parseParams(::boost::string_ref input,char separator,std::vector<param_t> & output){
+  parse_pairs(input,separator,[&output](::boost::string_ref name,::boost::string_ref value){
+    output.push_back({name,value});
+  });
+}
+::boost::string_ref findParam(const std::vector<param_t> & params,::boost::string_ref name){
+  for (const param_t & p : params) if (equalNocase(p.name,name)) return(p.value);
+  return(::boost::string_ref());
+}
+bool acceptsEncoding(::boost::string_ref accept,::boost::string_ref coding){
+  static const std::string _any_("*");
+  std::vector<param_t> params;
+  int any(-1);
+  std::size_t pos(0);
+  while (pos<accept.size()){
+    std::size_t end(find_separator(accept,pos,','));
+    ::boost::string_ref item(accept.substr(pos,end-pos));
+    std::size_t semicolon(item.find(';'));
+    ::boost::string_ref name(trimOws(item.substr(0,semicolon)));
+    pos=end+1;
+    if ((!equalNocase(name,coding))&&(name!=_any_)) continue;
+    bool accepted(true);
+    if (semicolon!=::boost::string_ref::npos){
+      params.clear();
+      parseParams(item.substr(semicolon+1),';',params);
+      ::boost::string_ref q(findParam(params,"q"));
+      accepted=q.empty();
+      for (char c : q) if ((c!='0')&&(c!='.')) accepted=true;//q=0 - kodowanie niedopuszczalne.
+    }
+    if (name!=_any_) return(accepted);//Kodowanie podane wprost ma pierwszeństwo przed "*".
+    any=accepted?1:0;
+  }
+  return(any==1);
+}
+void parseForwarded(::boost::string_ref input,std::vector<forwarded_t> & output){
+  std::size_t pos(0);
+  while (pos<input.size()){
+    std::size_t end(find_separator(input,pos,','));
+    forwarded_t element;
+    bool empty(true);
+    parse_pairs(input.substr(pos,end-pos),';',[&element,&empty](::boost::string_ref name,::boost::string_ref value){
+      empty=false;
+      if (equalNocase(name,"by")) element.by=value;
+      else if (equalNocase(name,"for")) element.for_=value;
+      else if (equalNocase(name,"host")) element.host=value;
+      else if (equalNocase(name,"proto")) element.proto=value;
+    });
+    if (!empty) output.push_back(element);
+    pos=end+1;
+  }
+}
+prepared_t prepare(unsigned int code,const headers_t & headers,const std::string & body,const std::string & msg){
+  std::shared_ptr<Prepared> prepared(new Prepared);
+  headers_t fields(headers);
+  if ((code<100)||(999<code)) code=500;
+  const std::string code_string(std::to_string(code));
+  std::string reason(msg);
+  if (reason.empty()&&statusReason(code)) reason=statusReason(code);
+  fields.erase(header_transfer_encoding);
+  if ((code<200)||(code==204)||(code==304)){
+    fields.erase(header_content_length);
+  } else {
+    fields.set(header_content_length,std::to_string(body.size()));
+  }
+  prepared->with_date=!fields.count(header_date);
+  for (std::size_t v=0;v<2;v++){
+    const version_t version((version_t)(version_1_0+v));
+    const std::string * status(statusLine(version,code_string,reason));
+    std::string & head(prepared->heads[v]);
+    if (status){
+      head=*status;
+    } else {
+      head=versionName(version)+space+code_string+space+reason+endl;
+    }
+    head.reserve(head.size()+headers_size(fields));
+    if (append_headers(head,fields)) return(nullptr);
+  }
+  prepared->content=body;
+  return(prepared);
+}
+//! Zapisuje start line i nagłówki gotowej odpowiedzi (response_headers są dopisywane jako poprawki).
+int Headers::write_prepared(){
+  if (!write_start){
+    const std::string & head(response_prepared->head(response_version));
+    //Wcześniejsze odpowiedzi (pipelining) muszą trafić do kolejki zapisu przed gotową odpowiedzią.
+    if (writeString.size()){
+      writeEnqueue(std::move(writeString));
+      writeString.clear();
+    }
+    writeEnqueue(head.data(),head.size(),response_prepared);
+    write_start=true;
+  }
+  READ_WRITE_1(write_headers(response_headers,response_prepared->date()&&!response_headers.count(header_date)))
   return(0);
 }
 //! Zapisuje start line i nagłówki (dla request).
 int Headers::write_request(){
   READ_WRITE_1(write_request_line())
-  READ_WRITE_1(write_headers(request_headers))
-  return(0);
-}
-//! Odczytuje start line i nagłówki (dla response).
-int Headers::read_response(){
-  READ_WRITE_1(read_status_line())
-  READ_WRITE_1(read_headers(response_headers))
+  READ_WRITE_1(write_headers(request_headers,false))
   return(0);
 }
 //! Zapisuje start line i nagłówki (dla response).
 int Headers::write_response(){
+  if (response_prepared) return(write_prepared());
   READ_WRITE_1(write_status_line())
-  READ_WRITE_1(write_headers(response_headers))
+  READ_WRITE_1(write_headers(response_headers,!response_headers.count(header_date)))
   return(0);
 }
 //! Odczytuje start line i nagłówki.
 int Headers::read_all_headers(){
-  return(server?read_request():read_response());
+  const static std::string _too_big_(" - too big...");
+  const static std::size_t max_start_line_size(10030);
+  const static std::size_t max_header_line_size(10000);
+  for (;;){
+    //Skanowanie wznawia się tam, gdzie się poprzednio zakończyło - cały dostępny blok nagłówków jest dzielony na linie w jednym przebiegu.
+    bool empty(scan::lines(readString.data(),readString.size(),parse_scan,parse_lines));
+    for (;parse_done<parse_lines.size();parse_done++){
+      const scan::line_t & line(parse_lines[parse_done]);
+      if (!parse_start){
+        if (line.begin==line.end) continue;//Puste linie przed start line są pomijane.
+        if ((line.end-line.begin)>max_start_line_size){
+          LOGGER_WARN<<__LOGGER__<<"HTTP start line"<<_too_big_<<std::endl;
+          return(-1);
+        }
+        READ_WRITE_1(parse_start_line(line.begin,line.end))
+        parse_start=true;
+      } else if (line.begin==line.end){//Koniec nagłówków.
+        head.assign(readString.data(),line.next);
+        readString.consume(line.next);
+        for (params_cache_t & c : params_cache) c.parsed=false;
+        forwarded_parsed=false;
+        parse_scan=scan::state_t();
+        parse_lines.clear();
+        parse_done=0;
+        if (server){
+          request_method=methodId(head.data()+head_start[0].offset,head_start[0].size);
+          request_version=versionId(head.data()+head_start[2].offset,head_start[2].size);
+        } else {
+          response_version=versionId(head.data()+head_start[0].offset,head_start[0].size);
+        }
+        return(0);
+      } else if ((line.end-line.begin)>max_header_line_size){
+        LOGGER_WARN<<__LOGGER__<<"HTTP header line"<<_too_big_<<std::endl;
+        return(-1);
+      } else {
+        READ_WRITE_1(parse_header_line(line))
+      }
+    }
+    if (!empty) break;
+    //Pusta linia przed start line - jest usuwana, a skanowanie zaczyna się od nowa.
+    readString.consume(parse_scan.pos);
+    parse_scan=scan::state_t();
+    parse_lines.clear();
+    parse_done=0;
+  }
+  if ((readString.size()-parse_scan.line)>(parse_start?max_header_line_size:max_start_line_size)){
+    LOGGER_WARN<<__LOGGER__<<(parse_start?"HTTP header line":"HTTP start line")<<_too_big_<<std::endl;
+    return(-1);
+  }
+  return(1);//Nie wszystkie dane.
 }
 //! Zapisuje start line i nagłówki.
 int Headers::write_all_headers(){
   return(server?write_response():write_request());
 }
-#define READ_WRITE_2(operation)\
-  switch (operation){ \
-    case 0:break; \
-    case 1:return; \
-    default:doClose();return; \
-  }
-void Headers::stringRead(){
+int Headers::read_phases(){
   switch(reading_phase){
     case phase_before:{
       LOGGER_DEBUG<<__LOGGER__<<"read - phase_start"<<std::endl;
-      READ_WRITE_2(beforeRead());
+      READ_WRITE_1(beforeRead())
       reading_phase=phase_headers;
     }
     case phase_headers:{
       LOGGER_DEBUG<<__LOGGER__<<"read - phase_headers"<<std::endl;
-      READ_WRITE_2(read_all_headers());
+      READ_WRITE_1(read_all_headers())
       reading_phase=phase_between;
     }
     case phase_between:{
       LOGGER_DEBUG<<__LOGGER__<<"read - phase_between"<<std::endl;
-      READ_WRITE_2(betweenRead());
+      READ_WRITE_1(betweenRead())
       reading_phase=phase_body;
     }
     case phase_body:{
       LOGGER_DEBUG<<__LOGGER__<<"read - phase_body"<<std::endl;
-      READ_WRITE_2(bodyRead());
+      READ_WRITE_1(bodyRead())
       reading_phase=phase_after;
     }
     case phase_after:{
       LOGGER_DEBUG<<__LOGGER__<<"read - phase_after"<<std::endl;
-      READ_WRITE_2(afterRead());
-      reading_phase=phase_end;
+      READ_WRITE_1(afterRead())
+      if (reading_phase==phase_after) reading_phase=phase_end;//afterRead() mógł już rozpocząć kolejny odczyt.
     }
     default:break;
   }
-  asyncRead();
+  return(0);
 }
-void Headers::stringWrite(){
+int Headers::write_phases(){
   switch(writing_phase){
     case phase_before:{
       LOGGER_DEBUG<<__LOGGER__<<"write - phase_start"<<std::endl;
-      READ_WRITE_2(beforeWrite());
+      READ_WRITE_1(beforeWrite())
       writing_phase=phase_headers;
     }
     case phase_headers:{
       LOGGER_DEBUG<<__LOGGER__<<"write - phase_headers"<<std::endl;
-      READ_WRITE_2(write_all_headers());
+      READ_WRITE_1(write_all_headers())
       writing_phase=phase_between;
     }
     case phase_between:{
       LOGGER_DEBUG<<__LOGGER__<<"write - phase_between"<<std::endl;
-      READ_WRITE_2(betweenWrite());
+      READ_WRITE_1(betweenWrite())
       writing_phase=phase_body;
     }
     case phase_body:{
       LOGGER_DEBUG<<__LOGGER__<<"write - phase_body"<<std::endl;
-      READ_WRITE_2(bodyWrite());
+      READ_WRITE_1(bodyWrite())
       writing_phase=phase_after;
     }
     case phase_after:{
       LOGGER_DEBUG<<__LOGGER__<<"write - phase_after"<<std::endl;
-      READ_WRITE_2(afterWrite());
-      writing_phase=phase_end;
+      READ_WRITE_1(afterWrite())
+      if (writing_phase==phase_after) writing_phase=phase_end;//afterWrite() mógł już rozpocząć kolejny zapis.
     }
     default:break;
   }
-  if (0<writeString.size()) asyncWrite();
+  return(0);
 }
-//============================================
-void Body::get_single_header(headers_t & headers,const std::string & name,std::string & value){
-  value.clear();
-  if (headers.count(name))
-    if (headers.at(name).size())
-      value=headers.at(name).at(0);
+void Headers::stringRead(){
+  int r(0);
+  if (read_active){
+    read_again=true;
+    return;
+  }
+  read_active=true;
+  do {
+    read_again=false;
+    r=read_phases();
+    if (r<0){
+      read_active=false;
+      doClose();
+      return;
+    }
+    //Pipelining - odpowiedź rozpoczęta w afterRequest() jest od razu zapisywana do writeString (bez czekania na zakończenie
+    //poprzedniego zapisu), a po niej od razu odczytywane jest kolejne żądanie z readString. Odpowiedzi są wysyłane w kolejności żądań
+    //i trafiają razem do jednego zapisu.
+    if ((r==0)&&server&&(writing_phase!=phase_end)) stringWrite();
+  } while (read_again);
+  read_active=false;
+  if (r==0) asyncRead();
 }
-void Body::set_single_header(headers_t & headers,const std::string & name,const std::string & value){
-  if (headers.count(name)) headers.erase(name);
-  if (value.size()) headers[name].push_back(value);
+void Headers::stringWrite(){
+  int r(0);
+  if (write_active){
+    write_again=true;
+    return;
+  }
+  write_active=true;
+  do {
+    write_again=false;
+    r=write_phases();
+    if (r<0){
+      write_active=false;
+      doClose();
+      return;
+    }
+  } while (write_again&&(r==0));
+  write_active=false;
+  if ((r==0)&&writeQueueSize&&(0<writeString.size())){//Odpowiedzi za gotową odpowiedzią trafiają do tego samego zapisu.
+    writeEnqueue(std::move(writeString));
+    writeString.clear();
+  }
+  if ((r==0)&&((0<writeString.size())||writeQueueSize)) asyncWrite();
 }
-void Body::get_content_length(headers_t & headers,std::size_t & size){
-  std::string value;
+//============================================
+int Body::get_content_length(std::size_t & size){
+  bool found(false);
   size=0;
-  get_single_header(headers,_content_length_,value);
-  if (value.size()) try {
-    size=std::stoull(value);
-  } catch(...) {}
+  for (const field_t & f : headFields()) if (f.id==header_content_length){
+    std::string field(headString(f.value));
+    ::boost::string_ref list(field);
+    //Lista wartości (np. połączone powtórzone nagłówki) jest dopuszczalna tylko wtedy, gdy wszystkie wartości są takie same.
+    do {
+      std::size_t c(list.find(','));
+      ::boost::string_ref item(trimOws(list.substr(0,c)));
+      std::size_t value(0);
+      list.remove_prefix((c==::boost::string_ref::npos)?list.size():(c+1));
+      if (item.empty()) return(-1);
+      for (char d : item){
+        if ((d<'0')||('9'<d)) return(-1);
+        if (value>((std::numeric_limits<std::size_t>::max()-(d-'0'))/10)) return(-1);
+        value=value*10+(d-'0');
+      }
+      if (found&&(value!=size)) return(-1);
+      found=true;
+      size=value;
+    } while (list.size());
+  }
+  return(0);
 }
 void Body::set_content_length(headers_t & headers,const std::size_t & size){
   std::string value;
   if (size) {
     value=std::to_string(size);
-  } else if (getServer()) if (request_method=="OPTIONS") value="0";
-  set_single_header(headers,_content_length_,value);
+  } else if (getServer()){//Pusta odpowiedź (poza 1xx, 204 i 304) musi mieć content-length, żeby połączenie keep-alive mogło być dalej używane.
+    if ((response_code!="204")&&(response_code!="304")&&(response_code.compare(0,1,"1"))) value="0";
+  }
+  headers.set(header_content_length,value);
 }
-int Body::read_body(std::string & body,std::size_t & content_length){
-  std::size_t s=(content_length>body.size())?(content_length-body.size()):0;
-  if (s){
-    body.append(readString,0,s);
-    readString.erase(0,s);
+int Body::deliver(std::string & body,consumer_t & consumer,const char * data,std::size_t size){
+  body_read+=size;
+  if (decoder.active()){
+    decoded.clear();
+    if (decoder.write(data,size,decoded)){
+      if (decoder.exceeded()){
+        LOGGER_WARN<<__LOGGER__<<"HTTP body - decompressed data too large..."<<std::endl;
+      } else {
+        LOGGER_WARN<<__LOGGER__<<"HTTP body - invalid compressed data..."<<std::endl;
+      }
+      return(-1);
+    }
+    data=decoded.data();
+    size=decoded.size();
+    if (!size) return(0);
+  }
+  if (!consumer){
+    body.append(data,size);
+    return(0);
+  }
+  switch (consumer(data,size)){
+    case 0:return(0);
+    case 1:readPaused=true;return(0);
+    default:return(-1);
+  }
+}
+int Body::read_body(std::string & body,std::size_t & content_length,consumer_t & consumer){
+  for (;;){
+    if (readPaused) return(1);
+    if (body_read>=content_length) return(0);
+    if (readString.empty()) return(1);
+    std::size_t s(content_length-body_read);
+    if (s>readString.size()) s=readString.size();
+    READ_WRITE_1(deliver(body,consumer,readString.data(),s))
+    readString.consume(s);
   }
-  if (body.size()==content_length) return(0);
-  return(1);
 }
 int Body::write_body(std::string & body,std::size_t & content_length){
   if ((body.size()+writeString.size())<writeString.max_size()){
@@ -576,101 +1156,272 @@ int Body::write_body(std::string & body,std::size_t & content_length){
   if (body.size()==0) return(0);
   return(1);
 }
-void Body::setResponseCode(unsigned int code){
-  static const std::map<unsigned int,std::string> code_map={
-    //Source: https://en.wikipedia.org/wiki/List_of_HTTP_status_codes
-    {100,"Continue"},//The server has received the request headers and the client should proceed to send the request body (in the case of a request for which a body needs to be sent; for example, a POST request). Sending a large request body to a server after a request has been rejected for inappropriate headers would be inefficient. To have a server check the request's headers, a client must send Expect: 100-continue as a header in its initial request and receive a 100 Continue status code in response before sending the body. The response 417 Expectation Failed indicates the request should not be continued.[2]
-    {101,"Switching Protocols"},//The requester has asked the server to switch protocols and the server has agreed to do so.[5]
-    {102,"Processing (WebDAV; RFC 2518)"},//A WebDAV request may contain many sub-requests involving file operations, requiring a long time to complete the request. This code indicates that the server has received and is processing the request, but no response is available yet.[6] This prevents the client from timing out and assuming the request was lost.
-    {200,"OK"},//Standard response for successful HTTP requests. The actual response will depend on the request method used. In a GET request, the response will contain an entity corresponding to the requested resource. In a POST request, the response will contain an entity describing or containing the result of the action.[7]
-    {201,"Created"},//The request has been fulfilled, resulting in the creation of a new resource.[8]
-    {202,"Accepted"},//The request has been accepted for processing, but the processing has not been completed. The request might or might not be eventually acted upon, and may be disallowed when processing occurs.[9]
-    {203,"Non-Authoritative Information"},//The server is a transforming proxy (e.g. a Web accelerator) that received a 200 OK from its origin, but is returning a modified version of the origin's response.[10][11]
-    {204,"No Content"},//The server successfully processed the request and is not returning any content.[12]
-    {205,"Reset Content"},//The server successfully processed the request, but is not returning any content. Unlike a 204 response, this response requires that the requester reset the document view.[13]
-    {206,"Partial Content (RFC 7233)"},//The server is delivering only part of the resource (byte serving) due to a range header sent by the client. The range header is used by HTTP clients to enable resuming of interrupted downloads, or split a download into multiple simultaneous streams.[14]
-    {207,"Multi-Status (WebDAV; RFC 4918)"},//The message body that follows is an XML message and can contain a number of separate response codes, depending on how many sub-requests were made.[15]
-    {208,"Already Reported (WebDAV; RFC 5842)"},//The members of a DAV binding have already been enumerated in a preceding part of the (multistatus) response, and are not being included again.
-    {226,"IM Used (RFC 3229)"},//The server has fulfilled a request for the resource, and the response is a representation of the result of one or more instance-manipulations applied to the current instance.[16]
-    {300,"Multiple Choices"},//Indicates multiple options for the resource from which the client may choose (via agent-driven content negotiation). For example, this code could be used to present multiple video format options, to list files with different filename extensions, or to suggest word-sense disambiguation.[18]
-    {301,"Moved Permanently"},//This and all future requests should be directed to the given URI.[19]
-    {302,"Found"},//This is an example of industry practice contradicting the standard. The HTTP/1.0 specification (RFC 1945) required the client to perform a temporary redirect (the original describing phrase was "Moved Temporarily"),[20] but popular browsers implemented 302 with the functionality of a 303 See Other. Therefore, HTTP/1.1 added status codes 303 and 307 to distinguish between the two behaviours.[21] However, some Web applications and frameworks use the 302 status code as if it were the 303.[22]
-    {303,"See Other"},//The response to the request can be found under another URI using a GET method. When received in response to a POST (or PUT/DELETE), the client should presume that the server has received the data and should issue a redirect with a separate GET message.[23]
-    {304,"Not Modified (RFC 7232)"},//Indicates that the resource has not been modified since the version specified by the request headers If-Modified-Since or If-None-Match. In such case, there is no need to retransmit the resource since the client still has a previously-downloaded copy.[24]
-    {305,"Use Proxy (since HTTP/1.1)"},//The requested resource is available only through a proxy, the address for which is provided in the response. Many HTTP clients (such as Mozilla[25] and Internet Explorer) do not correctly handle responses with this status code, primarily for security reasons.[26]
-    {306,"Switch Proxy"},//No longer used. Originally meant "Subsequent requests should use the specified proxy."[27]
-    {307,"Temporary Redirect (since HTTP/1.1)"},//In this case, the request should be repeated with another URI; however, future requests should still use the original URI. In contrast to how 302 was historically implemented, the request method is not allowed to be changed when reissuing the original request. For example, a POST request should be repeated using another POST request.[28]
-    {308,"Permanent Redirect (RFC 7538)"},//The request and all future requests should be repeated using another URI. 307 and 308 parallel the behaviors of 302 and 301, but do not allow the HTTP method to change. So, for example, submitting a form to a permanently redirected resource may continue smoothly.[29]
-    {400,"Bad Request"},//The server cannot or will not process the request due to an apparent client error (e.g., malformed request syntax, size too large, invalid request message framing, or deceptive request routing).[31]
-    {401,"Unauthorized (RFC 7235)"},//Similar to 403 Forbidden, but specifically for use when authentication is required and has failed or has not yet been provided. The response must include a WWW-Authenticate header field containing a challenge applicable to the requested resource. See Basic access authentication and Digest access authentication.[32] 401 semantically means "unauthenticated",[33] i.e. the user does not have the necessary credentials.
-    {402,"Payment Required"},//Reserved for future use. The original intention was that this code might be used as part of some form of digital cash or micropayment scheme, as proposed for example by GNU Taler[34], but that has not yet happened, and this code is not usually used. Google Developers API uses this status if a particular developer has exceeded the daily limit on requests.[35]
-    {403,"Forbidden"},//The request was valid, but the server is refusing action. The user might not have the necessary permissions for a resource, or may need an account of some sort.
-    {404,"Not Found"},//The requested resource could not be found but may be available in the future. Subsequent requests by the client are permissible.[36]
-    {405,"Method Not Allowed"},//A request method is not supported for the requested resource; for example, a GET request on a form that requires data to be presented via POST, or a PUT request on a read-only resource.
-    {406,"Not Acceptable"},//The requested resource is capable of generating only content not acceptable according to the Accept headers sent in the request.[37] See Content negotiation.
-    {407,"Proxy Authentication Required (RFC 7235)"},//The client must first authenticate itself with the proxy.[38]
-    {408,"Request Timeout"},//The server timed out waiting for the request. According to HTTP specifications: "The client did not produce a request within the time that the server was prepared to wait. The client MAY repeat the request without modifications at any later time."[39]
-    {409,"Conflict"},//Indicates that the request could not be processed because of conflict in the request, such as an edit conflict between multiple simultaneous updates.
-    {410,"Gone"},//Indicates that the resource requested is no longer available and will not be available again. This should be used when a resource has been intentionally removed and the resource should be purged. Upon receiving a 410 status code, the client should not request the resource in the future. Clients such as search engines should remove the resource from their indices.[40] Most use cases do not require clients and search engines to purge the resource, and a "404 Not Found" may be used instead.
-    {411,"Length Required"},//The request did not specify the length of its content, which is required by the requested resource.[41]
-    {412,"Precondition Failed (RFC 7232)"},//The server does not meet one of the preconditions that the requester put on the request.[42]
-    {413,"Payload Too Large (RFC 7231)"},//The request is larger than the server is willing or able to process. Previously called "Request Entity Too Large".[43]
-    {414,"URI Too Long (RFC 7231)"},//The URI provided was too long for the server to process. Often the result of too much data being encoded as a query-string of a GET request, in which case it should be converted to a POST request.[44] Called "Request-URI Too Long" previously.[45]
-    {415,"Unsupported Media Type"},//The request entity has a media type which the server or resource does not support. For example, the client uploads an image as image/svg+xml, but the server requires that images use a different format.
-    {416,"Range Not Satisfiable (RFC 7233)"},//The client has asked for a portion of the file (byte serving), but the server cannot supply that portion. For example, if the client asked for a part of the file that lies beyond the end of the file.[46] Called "Requested Range Not Satisfiable" previously.[47]
-    {417,"Expectation Failed"},//The server cannot meet the requirements of the Expect request-header field.[48]
-    {418,"I'm a teapot (RFC 2324)"},//This code was defined in 1998 as one of the traditional IETF April Fools' jokes, in RFC 2324, Hyper Text Coffee Pot Control Protocol, and is not expected to be implemented by actual HTTP servers. The RFC specifies this code should be returned by teapots requested to brew coffee.[49] This HTTP status is used as an Easter egg in some websites, including Google.com.[50]
-    {421,"Misdirected Request (RFC 7540)"},//The request was directed at a server that is not able to produce a response (for example because a connection reuse).[51]
-    {422,"Unprocessable Entity (WebDAV; RFC 4918)"},//The request was well-formed but was unable to be followed due to semantic errors.[15]
-    {423,"Locked (WebDAV; RFC 4918)"},//The resource that is being accessed is locked.[15]
-    {424,"Failed Dependency (WebDAV; RFC 4918)"},//The request failed due to failure of a previous request (e.g., a PROPPATCH).[15]
-    {426,"Upgrade Required"},//The client should switch to a different protocol such as TLS/1.0, given in the Upgrade header field.[52]
-    {428,"Precondition Required (RFC 6585)"},//The origin server requires the request to be conditional. Intended to prevent the 'lost update' problem, where a client GETs a resource's state, modifies it, and PUTs it back to the server, when meanwhile a third party has modified the state on the server, leading to a conflict."[53]
-    {429,"Too Many Requests (RFC 6585)"},//The user has sent too many requests in a given amount of time. Intended for use with rate-limiting schemes.[53]
-    {431,"Request Header Fields Too Large (RFC 6585)"},//The server is unwilling to process the request because either an individual header field, or all the header fields collectively, are too large.[53]
-    {451,"Unavailable For Legal Reasons (RFC 7725)"},//A server operator has received a legal demand to deny access to a resource or to a set of resources that includes the requested resource.[54] The code 451 was chosen as a reference to the novel Fahrenheit 451.
-    {500,"Internal Server Error"},//A generic error message, given when an unexpected condition was encountered and no more specific message is suitable.[57]
-    {501,"Not Implemented"},//The server either does not recognize the request method, or it lacks the ability to fulfil the request. Usually this implies future availability (e.g., a new feature of a web-service API).[58]
-    {502,"Bad Gateway"},//The server was acting as a gateway or proxy and received an invalid response from the upstream server.[59]
-    {503,"Service Unavailable"},//The server is currently unavailable (because it is overloaded or down for maintenance). Generally, this is a temporary state.[60]
-    {504,"Gateway Timeout"},//The server was acting as a gateway or proxy and did not receive a timely response from the upstream server.[61]
-    {505,"HTTP Version Not Supported"},//The server does not support the HTTP protocol version used in the request.[62]
-    {506,"Variant Also Negotiates (RFC 2295)"},//Transparent content negotiation for the request results in a circular reference.[63]
-    {507,"Insufficient Storage (WebDAV; RFC 4918)"},//The server is unable to store the representation needed to complete the request.[15]
-    {508,"Loop Detected (WebDAV; RFC 5842)"},//The server detected an infinite loop while processing the request (sent in lieu of 208 Already Reported).
-    {510,"Not Extended (RFC 2774)"},//Further extensions to the request are required for the server to fulfil it.[64]
-    {511,"Network Authentication Required (RFC 6585)"},//The client needs to authenticate to gain network access. Intended for use by intercepting proxies used to control access to the network (e.g., "captive portals" used to require agreement to Terms of Service before granting full Internet access via a Wi-Fi hotspot).[53]
-    {103,"Checkpoint"},//Used in the resumable requests proposal to resume aborted PUT or POST requests.[65]
-    {103,"Early Hints"},//Used to return some response headers before entire HTTP response.[66][67]
-    {420,"Method Failure (Spring Framework)"},//A deprecated response used by the Spring Framework when a method has failed.[68]
-    {420,"Enhance Your Calm (Twitter)"},//Returned by version 1 of the Twitter Search and Trends API when the client is being rate limited; versions 1.1 and later use the 429 Too Many Requests response code instead.[69]
-    {450,"Blocked by Windows Parental Controls (Microsoft)"},//The Microsoft extension code indicated when Windows Parental Controls are turned on and are blocking access to the requested webpage.[70]
-    {498,"Invalid Token (Esri)"},//Returned by ArcGIS for Server. Code 498 indicates an expired or otherwise invalid token.[71]
-    {499,"Token Required (Esri)"},//Returned by ArcGIS for Server. Code 499 indicates that a token is required but was not submitted.[71]
-    {509,"Bandwidth Limit Exceeded (Apache Web Server/cPanel)"},//The server has exceeded the bandwidth specified by the server administrator; this is often used by shared hosting providers to limit the bandwidth of customers.[72]
-    {530,"Site is frozen"},//Used by the Pantheon web platform to indicate a site that has been frozen due to inactivity.[73]
-    {598,"(Informal convention) Network read timeout error"},//Used by some HTTP proxies to signal a network read timeout behind the proxy to a client in front of the proxy.[74][75]
-    {599,"(Informal convention) Network connect timeout error"},//Used to indicate when the connection to the network times out.[76][citation needed]
-    {440,"Login Time-out"},//The client's session has expired and must log in again.[77]
-    {449,"Retry With"},//The server cannot honour the request because the user has not provided the required information.[78]
-    {451,"Redirect"},//Used in Exchange ActiveSync when either a more efficient server is available or the server cannot access the users' mailbox.[79] The client is expected to re-run the HTTP AutoDiscover operation to find a more appropriate server.[80]
-    {444,"No Response"},//Used to indicate that the server has returned no information to the client and closed the connection.
-    {495,"SSL Certificate Error"},//An expansion of the 400 Bad Request response code, used when the client has provided an invalid client certificate.
-    {496,"SSL Certificate Required"},//An expansion of the 400 Bad Request response code, used when a client certificate is required but not provided.
-    {497,"HTTP Request Sent to HTTPS Port"},//An expansion of the 400 Bad Request response code, used when the client has made a HTTP request to a port listening for HTTPS requests.
-    {499,"Client Closed Request"},//Used when the client has closed the request before the server could send a response.
-    {520,"Unknown Error"},//The 520 error is used as a "catch-all response for when the origin server returns something unexpected", listing connection resets, large headers, and empty or invalid responses as common triggers.
-    {521,"Web Server Is Down"},//The origin server has refused the connection from Cloudflare.
-    {522,"Connection Timed Out"},//Cloudflare could not negotiate a TCP handshake with the origin server.
-    {523,"Origin Is Unreachable"},//Cloudflare could not reach the origin server; for example, if the DNS records for the origin server are incorrect.
-    {524,"A Timeout Occurred"},//Cloudflare was able to complete a TCP connection to the origin server, but did not receive a timely HTTP response.
-    {525,"SSL Handshake Failed"},//Cloudflare could not negotiate a SSL/TLS handshake with the origin server.
-    {526,"Invalid SSL Certificate"},//Cloudflare could not validate the SSL/TLS certificate that the origin server presented.
-    {527,"Railgun Error"},//Error 527 indicates that the request timed out or failed after the WAN connection had been established.[84]
+//! Sprawdza, czy ostatnim kodowaniem w transfer-encoding jest chunked.
+//! Sprawdza, czy lista kodowań transferu zawiera tylko chunked (inne kodowania nie są obsługiwane) i zlicza jego wystąpienia.
+static bool only_chunked(::boost::string_ref value,std::size_t & count){
+  static const std::string _chunked_("chunked");
+  while (value.size()){
+    std::size_t c(value.find(','));
+    ::boost::string_ref item(trimOws(value.substr(0,c)));
+    value.remove_prefix((c==::boost::string_ref::npos)?value.size():(c+1));
+    if (item.empty()) continue;
+    if (!equalNocase(item,_chunked_)) return(false);
+    count++;
+  }
+  return(true);
+}
+int Body::read_framing(std::size_t & content_length){
+  std::size_t te(0),chunked(0);
+  bool cl(false),valid(true);
+  content_length=0;
+  framing_close=false;
+  for (const field_t & f : headFields()){
+    if (f.id==header_content_length) cl=true;
+    if (f.id!=header_transfer_encoding) continue;
+    te++;
+    std::string value(headString(f.value));
+    if (!only_chunked(value,chunked)) valid=false;
+  }
+  chunked_read=(te!=0);
+  if (!te){
+    if (get_content_length(content_length)){
+      LOGGER_WARN<<__LOGGER__<<"HTTP content-length - invalid..."<<std::endl;
+      content_length=0;
+      return(-1);
+    }
+    return(0);
+  }
+  //Kodowanie chunked musi być jedyne (i jedno) - inaczej nie da się ustalić końca body.
+  if ((!valid)||(chunked!=1)){
+    LOGGER_WARN<<__LOGGER__<<"HTTP transfer-encoding - unsupported..."<<std::endl;
+    return(-1);
+  }
+  //Transfer-encoding razem z content-length - body według chunked, a połączenie jest zamykane po wiadomości.
+  if (cl) framing_close=true;
+  return(0);
+}
+int Body::read_chunks(std::string & body,consumer_t & consumer){
+  const static std::string _too_big_(" - too big...");
+  const static std::string _invalid_(" - invalid...");
+  const static std::size_t max_size_line_size(1024);
+  const static std::size_t max_trailer_line_size(10000);
+  for (;;) if (readPaused) return(1); else switch (chunk_phase){
+    case chunk_size:{
+      std::size_t e(readString.find('\n'));
+      if ((e==std::string::npos)?(readString.size()>max_size_line_size):(e>max_size_line_size)){
+        LOGGER_WARN<<__LOGGER__<<"HTTP chunk size line"<<_too_big_<<std::endl;
+        return(-1);
+      }
+      if (e==std::string::npos) return(1);
+      std::size_t k(0);
+      chunk_left=0;
+      for (;k<e;k++){
+        char c(readString[k]);
+        std::size_t d;
+        if (('0'<=c)&&(c<='9')){
+          d=c-'0';
+        } else if (('a'<=(c|0x20))&&((c|0x20)<='f')){
+          d=(c|0x20)-'a'+10;
+        } else {
+          break;
+        }
+        if (chunk_left>(std::string::npos>>4)){
+          LOGGER_WARN<<__LOGGER__<<"HTTP chunk size"<<_too_big_<<std::endl;
+          return(-1);
+        }
+        chunk_left=(chunk_left<<4)|d;
+      }
+      //Po rozmiarze mogą być rozszerzenia (ignorowane).
+      if ((!k)||((k<e)&&(readString[k]!=';')&&(readString[k]!=' ')&&(readString[k]!='\t')&&(readString[k]!='\r'))){
+        LOGGER_WARN<<__LOGGER__<<"HTTP chunk size"<<_invalid_<<std::endl;
+        return(-1);
+      }
+      readString.consume(e+1);
+      chunk_phase=chunk_left?chunk_data:chunk_trailer;
+    } break;
+    case chunk_data:{
+      std::size_t s((chunk_left<readString.size())?chunk_left:readString.size());
+      if (!s) return(1);
+      READ_WRITE_1(deliver(body,consumer,readString.data(),s))
+      readString.consume(s);
+      chunk_left-=s;
+      if (chunk_left) return(1);
+      if (readPaused) {
+        chunk_phase=chunk_data_end;
+        return(1);
+      }
+      chunk_phase=chunk_data_end;
+    }
+    case chunk_data_end:{
+      if (readString.empty()) return(1);
+      if (readString[0]=='\r'){
+        if (readString.size()<2) return(1);
+        if (readString[1]!='\n'){
+          LOGGER_WARN<<__LOGGER__<<"HTTP chunk end"<<_invalid_<<std::endl;
+          return(-1);
+        }
+        readString.consume(2);
+      } else if (readString[0]=='\n'){
+        readString.consume(1);
+      } else {
+        LOGGER_WARN<<__LOGGER__<<"HTTP chunk end"<<_invalid_<<std::endl;
+        return(-1);
+      }
+      chunk_phase=chunk_size;
+    } break;
+    case chunk_trailer:{//Pola trailer są pomijane.
+      std::size_t e(readString.find('\n'));
+      if ((e==std::string::npos)?(readString.size()>max_trailer_line_size):(e>max_trailer_line_size)){
+        LOGGER_WARN<<__LOGGER__<<"HTTP trailer line"<<_too_big_<<std::endl;
+        return(-1);
+      }
+      if (e==std::string::npos) return(1);
+      bool last((e==0)||((e==1)&&(readString[0]=='\r')));
+      readString.consume(e+1);
+      if (last){
+        chunk_phase=chunk_size;
+        return(0);
+      }
+    } break;
+    default:return(-1);
+  }
+}
+int Body::write_chunks(producer_t & producer,std::string & body){
+  //Ile danych może czekać na zapis, zanim producent zostanie wstrzymany.
+  const static std::size_t max_pending(65536);
+  static const std::string _last_chunk_("0\r\n\r\n");
+  for (;;){
+    std::string chunk;
+    int r(1);
+    if (body.size()){
+      chunk.swap(body);
+    } else {
+      r=producer(chunk);
+    }
+    if (r<0){
+      producer=nullptr;
+      return(-1);
+    }
+    if (chunk.size()){
+      if (chunked_write){
+        char size[2*sizeof(std::size_t)+1];
+        std::snprintf(size,sizeof(size),"%zx",chunk.size());
+        writeString+=size;
+        writeString+=endl;
+        writeString+=chunk;
+        writeString+=endl;
+      } else {
+        writeString+=chunk;
+      }
+    }
+    if (r==0){
+      if (chunked_write) writeString+=_last_chunk_;
+      producer=nullptr;
+      return(0);
+    }
+    if (chunk.empty()||(writeString.size()>=max_pending)){
+      if (writeString.size()) asyncWrite();
+      return(1);
+    }
+  }
+}
+void Body::compress_response(){
+  static const std::string _gzip_("gzip");
+  static const std::string _deflate_("deflate");
+  static const std::string _vary_("accept-encoding");
+  ::boost::string_ref accept(headValue(header_accept_encoding));
+  ict::boost::connection::zlib::format_t format;
+  if (compress_level<=0) return;
+  if ((!response_producer)&&(response_body.size()<compress_min_size)) return;
+  if ((request_method==method_head)||response_headers.count(header_content_encoding)) return;
+  if ((response_code=="204")||(response_code=="304")||(!response_code.compare(0,1,"1"))) return;
+  response_headers.add(header_vary,_vary_);
+  if (acceptsEncoding(accept,_gzip_)){
+    format=ict::boost::connection::zlib::format_gzip;
+  } else if (acceptsEncoding(accept,_deflate_)){
+    format=ict::boost::connection::zlib::format_deflate;
+  } else {
+    return;
+  }
+  if (encoder.begin(format,compress_level)) return;//Odpowiedź bez kompresji.
+  response_headers.set(header_content_encoding,(format==ict::boost::connection::zlib::format_gzip)?_gzip_:_deflate_);
+  if (!response_producer){
+    std::string body;
+    int r(encoder.write(response_body.data(),response_body.size(),body,false,true));
+    encoder.end();
+    if (r){
+      response_headers.erase(header_content_encoding);
+      return;
+    }
+    response_body.swap(body);
+    return;
+  }
+  //Fragmenty producenta są kompresowane w locie - dane są wypychane, gdy producent czeka (żeby odbiorca dostał to, co już jest).
+  producer_t producer;
+  std::string first;
+  bool pending(false);
+  producer.swap(response_producer);
+  first.swap(response_body);
+  response_producer=[this,producer,first,pending](std::string & chunk) mutable -> int {
+    std::string raw;
+    for (;;){
+      int r(1);
+      raw.clear();
+      if (first.size()){
+        raw.swap(first);
+      } else {
+        r=producer(raw);
+      }
+      if ((r==1)&&raw.empty()&&(!pending)) return(1);
+      if ((r<0)||encoder.write(raw.data(),raw.size(),chunk,raw.empty(),r==0)){
+        encoder.end();
+        return(-1);
+      }
+      pending=!raw.empty();//Po wypchnięciu nie ma danych czekających w koderze.
+      if (r==0){
+        encoder.end();
+        return(0);
+      }
+      if (chunk.size()) return(1);
+    }
   };
+}
+int Body::decompress_body(){
+  static const std::string _gzip_("gzip");
+  static const std::string _x_gzip_("x-gzip");
+  static const std::string _deflate_("deflate");
+  ::boost::string_ref coding(trimOws(headValue(header_content_encoding)));
+  decoder.end();
+  if ((!decompress)||coding.empty()) return(0);
+  if (equalNocase(coding,_gzip_)||equalNocase(coding,_x_gzip_)||equalNocase(coding,_deflate_)) return(decoder.begin(decompress_max_size));
+  return(0);
+}
+void Body::set_chunked(headers_t & headers,bool chunked){
+  static const std::string _chunked_("chunked");
+  chunked_write=chunked;
+  headers.erase(header_content_length);
+  if (chunked_write){
+    headers.set(header_transfer_encoding,_chunked_);
+  } else {//Bez długości i kodowania chunked koniec body oznacza zamknięcie połączenia.
+    headers.erase(header_transfer_encoding);
+    keep_alive=false;
+  }
+}
+void Body::setResponseFile(const ict::boost::connection::file_t & file,std::size_t offset,std::size_t size){
+  response_file=file;
+  response_file_offset=0;
+  response_file_size=0;
+  if (!file) return;
+  if (offset>file->size()) offset=file->size();
+  if (size>(file->size()-offset)) size=file->size()-offset;
+  response_file_offset=offset;
+  response_file_size=size;
+}
+void Body::setResponseCode(unsigned int code){
   if ((code<100)||(999<code)) code=500;
   response_code=std::to_string(code);
-  if (code_map.count(code)) response_msg=code_map.at(code);
+  const char * reason(statusReason(code));
+  if (reason) response_msg=reason;
 }
 int Body::beforeRead(){
   if (getServer()) {
@@ -687,66 +1438,163 @@ int Body::beforeWrite(){
     before_response();
     READ_WRITE_1(beforeResponse())
   } else {
-    request_version=_HTTP_1_1_;
+    request_version=version_1_1;
     before_request();
     READ_WRITE_1(beforeRequest())
   }
   if (getServer()) {
-    response_content_length=response_body.size();
-    set_content_length(response_headers,response_content_length);
+    if (response_prepared){//Poprawki gotowej odpowiedzi.
+      static const std::string _keep_alive_("keep-alive");
+      static const std::string _close_("close");
+      response_content_length=0;
+      response_body.clear();
+      response_producer=nullptr;
+      if (!keep_alive){
+        response_headers.set(header_connection,_close_);
+      } else if (response_version==version_1_0){
+        response_headers.set(header_connection,_keep_alive_);
+      }
+    } else if (response_file){
+      response_content_length=response_file_size;
+      response_body.clear();
+      response_producer=nullptr;
+      set_content_length(response_headers,response_content_length);
+    } else {
+      compress_response();
+      if (response_producer){
+        response_content_length=0;
+        set_chunked(response_headers,request_version==version_1_1);
+      } else {
+        response_content_length=response_body.size();
+        set_content_length(response_headers,response_content_length);
+      }
+    }
   } else {
-    request_content_length=request_body.size();
-    set_content_length(request_headers,request_content_length);
+    if (request_producer){
+      request_content_length=0;
+      set_chunked(request_headers,true);
+    } else {
+      request_content_length=request_body.size();
+      set_content_length(request_headers,request_content_length);
+    }
   }
   return(0);
 }
 int Body::betweenRead(){
+  chunk_phase=chunk_size;
+  chunk_left=0;
+  body_read=0;
+  framing_invalid=false;
   if (getServer()) {
-    get_content_length(request_headers,request_content_length);
     request_body.clear();
+    if (read_framing(request_content_length)){//Body nie jest odczytywane - odpowiedź 400 w afterRead().
+      framing_invalid=true;
+      chunked_read=false;
+      request_content_length=0;
+      decoder.end();
+      return(0);
+    }
+    READ_WRITE_1(betweenRequest())
   } else {
-    get_content_length(response_headers,response_content_length);
+    if (read_framing(response_content_length)) return(-1);
     response_body.clear();
+    READ_WRITE_1(betweenResponse())
   }
-  return(0);
+  return(decompress_body());
 }
 int Body::betweenWrite(){
   return(0);
 }
 int Body::bodyRead(){
-  return(getServer()?read_body(request_body,request_content_length):read_body(response_body,response_content_length));
+  int r;
+  if (chunked_read){
+    r=getServer()?read_chunks(request_body,request_consumer):read_chunks(response_body,response_consumer);
+  } else {
+    r=getServer()?read_body(request_body,request_content_length,request_consumer):read_body(response_body,response_content_length,response_consumer);
+  }
+  if ((r==0)&&decoder.active()){
+    bool done(decoder.done());
+    decoder.end();
+    if ((!done)&&body_read){
+      LOGGER_WARN<<__LOGGER__<<"HTTP body - compressed data truncated..."<<std::endl;
+      return(-1);
+    }
+  }
+  return(r);
 }
 int Body::bodyWrite(){
-  return(getServer()?write_body(response_body,response_content_length):write_body(request_body,request_content_length));
+  if (getServer()){
+    if (request_method==method_head){//Odpowiedź na HEAD nie ma body (nagłówki opisują body odpowiedzi na GET).
+      response_body.clear();
+      response_producer=nullptr;
+      response_file=nullptr;
+      return(0);
+    }
+    if (response_prepared){//Body gotowej odpowiedzi trafia do kolejki zapisu bez kopiowania.
+      const std::string & body(response_prepared->body());
+      if (writeString.size()){
+        writeEnqueue(std::move(writeString));
+        writeString.clear();
+      }
+      writeEnqueue(body.data(),body.size(),response_prepared);
+      return(0);
+    }
+    if (response_file){//Body z pliku trafia do kolejki zapisu jako fragment pliku (sendfile()).
+      if (writeString.size()){
+        writeEnqueue(std::move(writeString));
+        writeString.clear();
+      }
+      writeEnqueueFile(response_file,response_file_offset,response_file_size);
+      response_file=nullptr;
+      return(0);
+    }
+    if (response_producer) return(write_chunks(response_producer,response_body));
+    return(write_body(response_body,response_content_length));
+  }
+  if (request_producer) return(write_chunks(request_producer,request_body));
+  return(write_body(request_body,request_content_length));
 }
 int Body::afterRead(){
   static const std::string _keep_alive_("keep-alive");
   static const std::string _close_("close");
   std::string connection;
   if (getServer()) {
-    get_single_header(request_headers,_connection_,connection);
+    headSingleHeader(header_connection,connection);
     transform_name(connection);
-    if (request_version==_HTTP_1_1_){
-      response_version=_HTTP_1_1_;
+    if (request_version==version_1_1){
+      response_version=version_1_1;
       if (connection==_close_){
         keep_alive=false;
       } else {
         keep_alive=true;
       }
     } else {
-      response_version=_HTTP_1_0_;
+      response_version=version_1_0;
       if (connection==_keep_alive_){
         keep_alive=true;
       } else {
         keep_alive=false;
       }
     }
+    if (framing_close||framing_invalid) keep_alive=false;
+    if (framing_invalid){//Niepoprawne ramkowanie - odpowiedź 400 i zamknięcie połączenia (bez afterRequest()).
+      setResponseCode(400);
+      response_headers.clear();
+      response_headers.set(header_connection,_close_);
+      response_body.clear();
+      response_producer=nullptr;
+      response_file=nullptr;
+      response_prepared=nullptr;
+      after_request();
+      startWrite();
+      return(0);
+    }
     READ_WRITE_1(afterRequest())
     after_request();
   } else {
-    get_single_header(response_headers,_connection_,connection);
+    headSingleHeader(header_connection,connection);
     transform_name(connection);
-    if (response_version==_HTTP_1_1_){
+    if (response_version==version_1_1){
       if (connection==_close_){
         keep_alive=false;
       } else {
@@ -759,6 +1607,7 @@ int Body::afterRead(){
         keep_alive=false;
       }
     }
+    if (framing_close) keep_alive=false;
     READ_WRITE_1(afterResponse())
     after_response();
   }
@@ -775,13 +1624,34 @@ int Body::afterWrite(){
   return(0);
 }
 void Body::before_request(){
+  if (keep_alive_waiting){
+    keep_alive_waiting=false;
+    setIdleTimeout(keep_alive_idle);
+  }
 }
 void Body::after_request(){
+  if (getServer()) {
+    request_consumer=nullptr;
+  } else {//Po zapisaniu żądania klient odczytuje odpowiedź.
+    startRead();
+  }
 }
 void Body::before_response(){
 }
 void Body::after_response(){
-  if (keep_alive){
+  if (!getServer()) response_consumer=nullptr;
+  if (getServer()){
+    response_prepared=nullptr;
+    response_file=nullptr;
+  }
+  if (!getServer()){//Połączenie keep-alive czeka na kolejne żądanie (startWrite()).
+    if (!keep_alive) doClose();
+  } else if (keep_alive){
+    if (keep_alive_timeout){
+      keep_alive_idle=idleTimeout;
+      keep_alive_waiting=true;
+      setIdleTimeout(keep_alive_timeout);
+    }
     startRead();
   } else {
     closeStringWrite=true;
@@ -795,12 +1665,12 @@ void Body::after_response(){
 class TestServer : public ict::boost::connection::http::Server{
 private:
   int afterRequest(){
-    LOGGER_DEBUG<<__LOGGER__<<request_method<<" "<<request_uri<<" "<<request_version<<std::endl;
+    LOGGER_DEBUG<<__LOGGER__<<requestMethod()<<" "<<requestUri()<<" "<<ict::boost::connection::http::versionName(request_version)<<std::endl;
     setResponseCode(200);
-    if (request_method==ict::boost::connection::http::_GET_){
+    if (request_method==ict::boost::connection::http::method_get){
       response_body="Czesc!!!";
       setSingleResponseHeader(ict::boost::connection::http::_content_type_,"text/text");
-    } else if (request_method==ict::boost::connection::http::_POST_) {
+    } else if (request_method==ict::boost::connection::http::method_post) {
       response_body=request_body;
       setSingleResponseHeader(ict::boost::connection::http::_content_type_,"text/text");
     } else {
@@ -820,11 +1690,466 @@ public:
 };
 REGISTER_TEST(connection_http,tc1){
   ict::boost::server::factory("localhost","4567",[](::boost::asio::ip::tcp::socket & socket){
-    auto ptr=std::make_shared<ict::boost::connection::Bottom<boost::asio::ip::tcp::socket,TestServer>>(socket);
+    auto ptr=ict::boost::asio::makeShared<ict::boost::connection::Bottom<boost::asio::ip::tcp::socket,TestServer>>(socket);
     if (ptr) ptr->initThis();
   });
   ict::reg::get<TestServer>().destroy();
   return(0);
 }
+//! Stos bez gniazda - dane są podawane bezpośrednio do readString, a zapisane zbierane z writeString.
+class TestParserStack : public ict::boost::connection::http::Server{
+private:
+  int afterRequest(){
+    requests.push_back(requestMethod()+" "+requestUri()+" "+std::to_string(request_version));
+    getSingleRequestHeader("x-test",value);
+    cookie=headCookie("sid").to_string();
+    forwarded_for=headForwarded().size()?headForwarded().back().for_.to_string():std::string();
+    setResponseCode(200);
+    response_body=request_body;
+    if (requestUri()=="/health"){//Gotowa odpowiedź.
+      static const ict::boost::connection::http::prepared_t health([]{
+        ict::boost::connection::http::headers_t headers;
+        headers.set(ict::boost::connection::http::header_content_type,"application/json");
+        return(ict::boost::connection::http::prepare(200,headers,"{\"status\":\"ok\"}"));
+      }());
+      response_prepared=health;
+    }
+    if (requestUri()=="/file") setResponseFile(ict::boost::connection::File::open(file),2,5);
+    if (requestUri()=="/chunked"){//Body w trzech fragmentach, przed drugim producent czeka na resumeWrite().
+      std::size_t n(0);
+      response_producer=[this,n](std::string & chunk) mutable {
+        switch (n++){
+          case 0:chunk="first";return(1);
+          case 1:paused=true;return(1);
+          case 2:chunk="second";return(1);
+          default:chunk="last";return(0);
+        }
+      };
+    }
+    startWrite();
+    return(0);
+  }
+  int betweenRequest(){
+    if (requestUri()=="/stream") request_consumer=[this](const char * data,std::size_t size){//Każdy fragment wstrzymuje odczyt.
+      streamed.append(data,size);
+      return(1);
+    };
+    return(0);
+  }
+public:
+  std::string streamed;
+  void resumeStream(){
+    resumeRead();
+  }
+  bool streamPaused() const {return(readPaused);}
+  bool paused=false;
+  void resume(){
+    paused=false;
+    resumeWrite();
+  }
+  std::vector<std::string> requests;
+  std::string value;
+  std::string cookie;
+  std::string forwarded_for;
+  void compress(int level,std::size_t min){
+    compress_level=level;
+    compress_min_size=min;
+  }
+  void decompressBody(std::size_t max){
+    decompress=true;
+    decompress_max_size=max;
+  }
+  std::string file;
+  static void keyValue(const std::string & input,std::map<std::string,std::string> & output){headerKeyValueParser(input,output);}
+};
+typedef ict::boost::connection::TestBottom<TestParserStack> TestParser;
+REGISTER_TEST(connection_http,tc2){
+  {
+    TestParser p;
+    p.feed("\r\nPOST /a HTTP/1.1\r\nX-Test:  one, two \r\nContent-Length: 3\r\n\r\nabc");
+    if (p.closed) return(-1);
+    p.feed("GET /b?c=d HTTP/1.0\r\nHost: x\r\n\r\n");
+    if (!p.closed) return(-1);//HTTP/1.0 bez keep-alive.
+    if (p.requests.size()!=2) return(-1);
+    if (p.requests.at(0)!="POST /a "+std::to_string(ict::boost::connection::http::version_1_1)) return(-1);
+    if (p.requests.at(1)!="GET /b?c=d "+std::to_string(ict::boost::connection::http::version_1_0)) return(-1);
+    if (p.output.find("HTTP/1.1 200 OK\r\n")!=0) return(-1);
+    if (p.output.find("\r\n\r\nabc")==std::string::npos) return(-1);
+    if (p.output.find("HTTP/1.0 200 OK\r\n")==std::string::npos) return(-1);
+  }
+  {
+    TestParser p;
+    p.feed("PUT /x HTTP/1.1\r\nx-test: v\r\n\r\n");
+    if (p.closed) return(-1);
+    if (p.value!="v") return(-1);
+    p.feed("BROKEN\r\n\r\n");
+    if (!p.closed) return(-1);
+  }
+  {
+    TestParser p;
+    p.feed("GET / HTTP/1.1\r\nBad Name: x\r\n\r\n");//Spacja w nazwie nagłówka.
+    if (!p.closed) return(-1);
+  }
+  return(0);
+}
+REGISTER_TEST(connection_http,tc3){
+  using namespace ict::boost::connection::http;
+  for (int k=header_other+1;k<header_count;k++){
+    std::string name(headerName((header_t)k));
+    if (headerId(name)!=k) return(-1);
+    for (char & c : name) c=::toupper(c);
+    if (headerId(name)!=k) return(-1);
+  }
+  if (headerId("x-unknown")!=header_other) return(-1);
+  if (headerId("content-lengthx")!=header_other) return(-1);
+  if (headerId("")!=header_other) return(-1);
+  Fields f;
+  f.add("X-Custom","a");
+  f.add(header_content_type,"text/plain");
+  f.add("x-custom","b");
+  f.add("Content-Length","10");
+  if (f.size()!=4) return(-1);
+  if (f.get("x-CUSTOM")!="a") return(-1);
+  if (f.count("x-custom")!=2) return(-1);
+  if (f.get(header_content_length)!="10") return(-1);
+  f.set(header_content_length,"20");
+  if (f.get("content-length")!="20") return(-1);
+  if (f.name(*f.begin())!="x-custom") return(-1);
+  if (f.erase("x-custom")!=2) return(-1);
+  if ((f.size()!=2)||(f.begin()->id!=header_content_type)) return(-1);
+  f.set(header_content_type,"");
+  if (f.count(header_content_type)) return(-1);
+  f.clear();
+  if (!f.empty()||f.get(header_content_length).size()) return(-1);
+  return(0);
+}
+REGISTER_TEST(connection_http,tc4){
+  using namespace ict::boost::connection::http;
+  const headers_config_ptr_t initial(headersConfig());
+  if (initial->get(header_content_length,"").multiple_values) return(-1);
+  if (!initial->get(header_other,"x-test").multiple_lines) return(-1);
+  config_t c(defaultHeadersConfig());
+  c["X-Single"]={.multiple_values=true,.multiple_lines=false};
+  c["Cookie"]={.multiple_values=true,.multiple_lines=false};
+  setHeadersConfig(c,defaultHeaderConfig());
+  headers_config_ptr_t current(headersConfig());
+  if (current==initial) return(-1);
+  if (current->get(header_other,"x-single").multiple_lines) return(-1);
+  if (current->get(header_cookie,"").multiple_lines) return(-1);
+  if (!current->get(header_other,"x-other").multiple_lines) return(-1);
+  if (!initial->get(header_cookie,"").multiple_lines) return(-1);//Poprzednia konfiguracja pozostaje ważna.
+  {
+    //Poprzednia konfiguracja jest zwalniana po zwolnieniu ostatniego wskaźnika.
+    std::weak_ptr<const HeadersConfig> previous(current);
+    setHeadersConfig(defaultHeadersConfig(),defaultHeaderConfig());
+    if (previous.expired()) return(-1);
+    current.reset();
+    if (!previous.expired()) return(-1);
+  }
+  return(0);
+}
+REGISTER_TEST(connection_http,tc5){
+  {
+    TestParser p;
+    p.feed("POST /a HTTP/1.1\r\nTransfer-Encoding: Chunked\r\n\r\n5;ext=1\r\nhello\r\nA\r\n, world!!!\r\n0\r\nX-Trailer: t\r\n\r\n");
+    p.feed("POST /b HTTP/1.1\r\ntransfer-encoding: chunked\r\n\r\n3\nabc\n0\n\n");
+    if (p.closed||(p.requests.size()!=2)) return(-1);
+    if (p.output.find("content-length: 15\r\n\r\nhello, world!!!")==std::string::npos) return(-1);
+    if (p.output.find("content-length: 3\r\n\r\nabc")==std::string::npos) return(-1);
+    p.feed("POST /c HTTP/1.1\r\ntransfer-encoding: chunked\r\n\r\nzz\r\n");
+    if (!p.closed) return(-1);
+  }
+  //Nieobsługiwane kodowanie transferu lub chunked nie na końcu - odpowiedź 400 i zamknięcie połączenia.
+  for (const char * te : {"gzip","gzip, chunked","chunked, gzip","chunked, chunked","chunked\r\nTransfer-Encoding: gzip"}){
+    TestParser p;
+    p.feed("POST /d HTTP/1.1\r\nTransfer-Encoding: "+std::string(te)+"\r\nContent-Length: 3\r\n\r\nabc");
+    if ((!p.closed)||(!p.requests.empty())) return(-1);
+    if (p.output.compare(0,25,"HTTP/1.1 400 Bad Request\r")||(p.output.find("connection: close\r\n")==std::string::npos)) return(-1);
+  }
+  //Niepoprawne content-length (nie same cyfry, przepełnienie, różne wartości) - odpowiedź 400 i zamknięcie połączenia.
+  for (const char * cl : {"3abc","+3","-1","","18446744073709551616","99999999999999999999999","3\r\nContent-Length: 4","3, 4"}){
+    TestParser p;
+    p.feed("POST /f HTTP/1.1\r\nContent-Length: "+std::string(cl)+"\r\n\r\nabc");
+    if ((!p.closed)||(!p.requests.empty())||p.output.compare(0,25,"HTTP/1.1 400 Bad Request\r")) return(-1);
+  }
+  //Powtórzona ta sama wartość jest dopuszczalna.
+  for (const char * cl : {" 3 ","3, 3","3\r\nContent-Length: 3"}){
+    TestParser p;
+    p.feed("POST /g HTTP/1.1\r\nContent-Length: "+std::string(cl)+"\r\n\r\nabc");
+    if (p.closed||(p.requests.size()!=1)||(p.output.find("content-length: 3\r\n\r\nabc")==std::string::npos)) return(-1);
+  }
+  {//Transfer-encoding i content-length - body według chunked, a połączenie jest zamykane po odpowiedzi.
+    TestParser p;
+    p.feed("POST /e HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 100\r\n\r\n3\r\nabc\r\n0\r\n\r\n");
+    if ((!p.closed)||(p.requests.size()!=1)||(p.output.find("\r\n\r\nabc")==std::string::npos)) return(-1);
+  }
+  {
+    TestParser p;
+    p.feed("GET /chunked HTTP/1.1\r\n\r\n");
+    if (!p.paused) return(-1);
+    if (p.output.find("transfer-encoding: chunked\r\n")==std::string::npos) return(-1);
+    if (p.output.find("content-length")!=std::string::npos) return(-1);
+    if (p.output.find("\r\n\r\n5\r\nfirst\r\n")==std::string::npos) return(-1);
+    p.resume();
+    p.flush();
+    if (p.output.find("5\r\nfirst\r\n6\r\nsecond\r\n4\r\nlast\r\n0\r\n\r\n")==std::string::npos) return(-1);
+    if (p.closed) return(-1);
+  }
+  {
+    TestParser p;
+    p.feed("GET /chunked HTTP/1.0\r\n\r\n");
+    p.resume();
+    p.flush();
+    if (p.output.find("\r\n\r\nfirstsecondlast")==std::string::npos) return(-1);
+    if (!p.closed) return(-1);//HTTP/1.0 - koniec body to zamknięcie połączenia.
+  }
+  return(0);
+}
+REGISTER_TEST(connection_http,tc6){
+  for (const std::string & request : {
+    std::string("POST /stream HTTP/1.1\r\nContent-Length: 10\r\n\r\n0123456789"),
+    std::string("POST /stream HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n4\r\n0123\r\n6\r\n456789\r\n0\r\n\r\n")
+  }){
+    TestParser p;
+    p.feed(request);
+    for (std::size_t k=0;(k<100)&&p.streamPaused();k++){
+      if (p.requests.size()) return(-1);//Żądanie nie może się zakończyć, gdy odczyt jest wstrzymany.
+      p.resumeStream();
+      p.flush();
+    }
+    if (p.streamPaused()) return(-1);
+    if (p.streamed!="0123456789") return(-1);
+    if (p.requests.size()!=1) return(-1);
+    if (p.output.find("content-length: 0\r\n\r\n")==std::string::npos) return(-1);//Body nie było gromadzone w request_body.
+    p.feed("POST /a HTTP/1.1\r\nContent-Length: 2\r\n\r\nok");
+    if ((p.requests.size()!=2)||(p.output.find("\r\n\r\nok")==std::string::npos)) return(-1);
+  }
+  return(0);
+}
+REGISTER_TEST(connection_http,tc7){
+  TestParser p;
+  p.feedAll(
+    "POST /1 HTTP/1.1\r\nContent-Length: 1\r\n\r\na"
+    "POST /2 HTTP/1.1\r\nContent-Length: 1\r\n\r\nb"
+    "POST /3 HTTP/1.1\r\nContent-Length: 1\r\n\r\nc"
+  );
+  if (p.closed||(p.requests.size()!=3)) return(-1);
+  if (p.writes!=1) return(-1);//Wszystkie odpowiedzi w jednym zapisie.
+  std::size_t a(p.output.find("\r\n\r\na"));
+  std::size_t b(p.output.find("\r\n\r\nb"));
+  std::size_t c(p.output.find("\r\n\r\nc"));
+  if ((a==std::string::npos)||(b==std::string::npos)||(c==std::string::npos)||(a>b)||(b>c)) return(-1);
+  //Niepełne kolejne żądanie czeka na dane.
+  p.feedAll("POST /4 HTTP/1.1\r\nContent-Length: 2\r\n\r\nd");
+  if (p.requests.size()!=3) return(-1);
+  p.feedAll("e");
+  if ((p.requests.size()!=4)||(p.output.find("\r\n\r\nde")==std::string::npos)) return(-1);
+  return(0);
+}
+REGISTER_TEST(connection_http,tc8){
+  using namespace ict::boost::connection::http;
+  if ((!statusReason(404))||(std::string(statusReason(404))!="Not Found")) return(-1);
+  if (statusReason(99)||statusReason(1000)) return(-1);
+  const std::string * line(statusLine(version_1_1,"200","OK"));
+  if ((!line)||(*line!="HTTP/1.1 200 OK\r\n")) return(-1);
+  line=statusLine(version_1_0,"503","Service Unavailable");
+  if ((!line)||(*line!="HTTP/1.0 503 Service Unavailable\r\n")) return(-1);
+  if (statusLine(version_1_1,"200","Fine")) return(-1);//Własny komunikat - status line składana w zwykły sposób.
+  if (statusLine(version_1_1,"2x0","OK")) return(-1);
+  const std::string & date(httpDate());
+  if ((date.size()!=29)||(date.compare(25,4," GMT"))||(date[3]!=',')) return(-1);
+  TestParser p;
+  p.feed("GET /x HTTP/1.1\r\nHost: a\r\n\r\n");
+  if (p.output.compare(0,23,"HTTP/1.1 200 OK\r\ndate: ")) return(-1);
+  if (p.output.compare(52,2,"\r\n")) return(-1);
+  return(0);
+}
+REGISTER_TEST(connection_http,tc9){
+  using namespace ict::boost::connection::http;
+  headers_t headers;
+  headers.add("x-custom"," a ");
+  prepared_t prepared(prepare(404,headers,"missing"));
+  if ((!prepared)||(prepared->head(version_1_1)!="HTTP/1.1 404 Not Found\r\nx-custom: a\r\ncontent-length: 7\r\n")) return(-1);
+  if (prepared->head(version_1_0).compare(0,23,"HTTP/1.0 404 Not Found\r")||(prepared->body()!="missing")||!prepared->date()) return(-1);
+  prepared=prepare(204,headers,"","Empty");
+  if ((!prepared)||(prepared->head(version_1_1)!="HTTP/1.1 204 Empty\r\nx-custom: a\r\n")) return(-1);
+  headers.add("x",std::string(10,'a'));
+  if (prepare(200,headers,"")) return(-1);//Za krótka nazwa nagłówka.
+  headers.clear();
+  headers.add("te","trailers");
+  if (!prepare(200,headers,"")) return(-1);
+  TestParser p;
+  p.feedAll(
+    "POST /1 HTTP/1.1\r\nContent-Length: 1\r\n\r\na"
+    "GET /health HTTP/1.1\r\n\r\n"
+    "POST /2 HTTP/1.1\r\nContent-Length: 1\r\n\r\nb"
+  );
+  if (p.closed||(p.requests.size()!=3)||(p.writes!=1)) return(-1);
+  std::size_t a(p.output.find("\r\n\r\na"));
+  std::size_t h(p.output.find("content-type: application/json\r\ncontent-length: 15\r\ndate: "));
+  std::size_t b(p.output.find("\r\n\r\nb"));
+  if ((a==std::string::npos)||(h==std::string::npos)||(b==std::string::npos)||(a>h)||(h>b)) return(-1);
+  if ((p.output.find("\r\n\r\n{\"status\":\"ok\"}HTTP/1.1 200 OK\r\n")==std::string::npos)||(p.output.find("connection:")!=std::string::npos)) return(-1);
+  //Poprawka dla połączenia zamykanego po odpowiedzi.
+  p.output.clear();
+  p.feedAll("GET /health HTTP/1.1\r\nConnection: close\r\n\r\n");
+  if ((!p.closed)||(p.output.find("\r\nconnection: close\r\n\r\n{\"status\":\"ok\"}")==std::string::npos)) return(-1);
+  return(0);
+}
+REGISTER_TEST(connection_http,tc10){
+  using namespace ict::boost::connection::http;
+  std::vector<param_t> params;
+  parseParams(" a=1; b = \"x; y\" ;flag;;c=", ';',params);
+  if (params.size()!=4) return(-1);
+  if ((params[0].name!="a")||(params[0].value!="1")) return(-1);
+  if ((params[1].name!="b")||(params[1].value!="x; y")) return(-1);
+  if ((params[2].name!="flag")||(params[2].value.size())) return(-1);
+  if ((params[3].name!="c")||(params[3].value.size())) return(-1);
+  if ((findParam(params,"B")!="x; y")||(findParam(params,"d").size())) return(-1);
+  std::vector<forwarded_t> forwarded;
+  parseForwarded("for=192.0.2.60;proto=http;by=203.0.113.43, For=\"[2001:db8:cafe::17]:4711\", host=a.b",forwarded);
+  if (forwarded.size()!=3) return(-1);
+  if ((forwarded[0].for_!="192.0.2.60")||(forwarded[0].proto!="http")||(forwarded[0].by!="203.0.113.43")) return(-1);
+  if ((forwarded[1].for_!="[2001:db8:cafe::17]:4711")||(forwarded[2].host!="a.b")) return(-1);
+  std::map<std::string,std::string> map;
+  TestParser::keyValue("x=1; y=\"2\"",map);
+  if ((map.size()!=2)||(map["x"]!="1")||(map["y"]!="2")) return(-1);
+  TestParser p;
+  p.feedAll("GET / HTTP/1.1\r\nCookie: a=1; sid=abc\r\nForwarded: for=1.1.1.1\r\nForwarded: for=2.2.2.2\r\n\r\n");
+  if ((p.cookie!="abc")||(p.forwarded_for!="2.2.2.2")) return(-1);
+  p.feedAll("GET / HTTP/1.1\r\nCookie: sid=def\r\n\r\n");
+  if ((p.cookie!="def")||(p.forwarded_for.size())) return(-1);//Parametry z poprzedniego żądania nie są używane.
+  return(0);
+}
+REGISTER_TEST(connection_http,tc11){
+  const std::string path("/tmp/connection_http-tc11.txt");
+  {
+    std::ofstream f(path,std::ios::binary|std::ios::trunc);
+    f<<"0123456789";
+  }
+  if (ict::boost::connection::File::open("/tmp")) return(-1);//Nie jest plikiem zwykłym.
+  if (ict::boost::connection::File::open(path+".missing")) return(-1);
+  ict::boost::connection::file_t file(ict::boost::connection::File::open(path));
+  if ((!file)||(file->size()!=10)) return(-1);
+  TestParser p;
+  p.file=path;
+  p.feedAll(
+    "GET /file HTTP/1.1\r\n\r\n"
+    "POST /x HTTP/1.1\r\nContent-Length: 1\r\n\r\na"
+  );
+  ::unlink(path.c_str());
+  if (p.closed||(p.requests.size()!=2)) return(-1);
+  std::size_t a(p.output.find("content-length: 5\r\n\r\n23456HTTP/1.1 200 OK\r\n"));
+  if ((a==std::string::npos)||(p.output.find("\r\n\r\na")<a)) return(-1);
+  return(0);
+}
+//! Zwraca body zapisane w kodowaniu chunked (po usunięciu kodowania).
+static std::string test_dechunk(const std::string & data){
+  std::string out;
+  std::size_t pos(0);
+  for (;;){
+    std::size_t e(data.find("\r\n",pos));
+    if (e==std::string::npos) return(out);
+    std::size_t size(std::stoul(data.substr(pos,e-pos),nullptr,16));
+    if (!size) return(out);
+    out.append(data,e+2,size);
+    pos=e+2+size+2;
+  }
+}
+//! Dekompresuje dane (pusty tekst w razie błędu).
+static std::string test_inflate(const std::string & data){
+  ict::boost::connection::zlib::Decoder d;
+  std::string out;
+  if (d.begin()||d.write(data.data(),data.size(),out)||!d.done()) return(std::string());
+  return(out);
+}
+REGISTER_TEST(connection_http,tc12){
+  std::string body;
+  for (std::size_t k=0;k<300;k++) body+="{\"id\":"+std::to_string(k)+"},";
+  {
+    TestParser p;
+    p.compress(6,100);
+    p.feedAll("POST /x HTTP/1.1\r\nAccept-Encoding: br;q=1, gzip;q=0.8\r\nContent-Length: "+std::to_string(body.size())+"\r\n\r\n"+body);
+    std::size_t h(p.output.find("\r\n\r\n"));
+    std::size_t l(p.output.find("content-length: "));
+    if (p.closed||(h==std::string::npos)||(l==std::string::npos)) return(-1);
+    if ((p.output.find("content-encoding: gzip\r\n")>h)||(p.output.find("vary: accept-encoding\r\n")>h)) return(-1);
+    std::size_t size(std::stoul(p.output.substr(l+16)));
+    if ((size>=body.size())||((h+4+size)!=p.output.size())||(test_inflate(p.output.substr(h+4))!=body)) return(-1);
+    //Bez accept-encoding lub za małe body - bez kompresji.
+    p.output.clear();
+    p.feedAll("POST /x HTTP/1.1\r\nContent-Length: "+std::to_string(body.size())+"\r\n\r\n"+body);
+    if ((p.output.find("content-encoding")!=std::string::npos)||(p.output.find("\r\n\r\n"+body)==std::string::npos)) return(-1);
+    p.output.clear();
+    p.feedAll("POST /x HTTP/1.1\r\nAccept-Encoding: deflate\r\nContent-Length: 3\r\n\r\nabc");
+    if ((p.output.find("content-encoding")!=std::string::npos)||(p.output.find("\r\n\r\nabc")==std::string::npos)) return(-1);
+    p.output.clear();
+    p.feedAll("POST /x HTTP/1.1\r\nAccept-Encoding: deflate, gzip;q=0\r\nContent-Length: "+std::to_string(body.size())+"\r\n\r\n"+body);
+    h=p.output.find("\r\n\r\n");
+    if ((p.output.find("content-encoding: deflate\r\n")>h)||(test_inflate(p.output.substr(h+4))!=body)) return(-1);
+  }
+  {//Producent - fragmenty są kompresowane w locie, a dane są wypychane, gdy producent czeka.
+    TestParser p;
+    p.compress(6,100);
+    p.feed("GET /chunked HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n");
+    p.resume();
+    p.flush();
+    std::size_t h(p.output.find("\r\n\r\n"));
+    if (p.closed||(p.output.find("content-encoding: gzip\r\n")>h)||(p.output.find("transfer-encoding: chunked\r\n")>h)) return(-1);
+    if ((p.output.compare(p.output.size()-5,5,"0\r\n\r\n"))||(test_inflate(test_dechunk(p.output.substr(h+4)))!="firstsecondlast")) return(-1);
+    //Przed wstrzymaniem producenta odbiorca dostał cały pierwszy fragment.
+    ict::boost::connection::zlib::Decoder d;
+    std::string out;
+    bool flushed(false);
+    if (d.begin()) return(-1);
+    for (std::size_t pos(h+4);;){
+      std::size_t e(p.output.find("\r\n",pos));
+      std::size_t size(std::stoul(p.output.substr(pos,e-pos),nullptr,16));
+      if (!size) break;
+      if (d.write(p.output.data()+e+2,size,out)) return(-1);
+      if (out=="first") flushed=true;
+      pos=e+2+size+2;
+    }
+    if (!flushed) return(-1);
+  }
+  {//Dekompresja body żądania.
+    ict::boost::connection::zlib::Encoder e;
+    std::string compressed;
+    if (e.begin(ict::boost::connection::zlib::format_gzip,6)||e.write(body.data(),body.size(),compressed,false,true)) return(-1);
+    e.end();
+    {//Domyślnie body nie jest dekompresowane.
+      TestParser p;
+      p.feedAll("POST /x HTTP/1.1\r\nContent-Encoding: gzip\r\nContent-Length: "+std::to_string(compressed.size())+"\r\n\r\n"+compressed);
+      if (p.output.find("content-length: "+std::to_string(compressed.size())+"\r\n\r\n"+compressed)==std::string::npos) return(-1);
+    }
+    TestParser p;
+    p.decompressBody(1<<20);
+    p.feedAll("POST /x HTTP/1.1\r\nContent-Encoding: gzip\r\nContent-Length: "+std::to_string(compressed.size())+"\r\n\r\n"+compressed);
+    if (p.output.find("content-length: "+std::to_string(body.size())+"\r\n\r\n"+body)==std::string::npos) return(-1);
+    p.output.clear();
+    p.feedAll("POST /x HTTP/1.1\r\nContent-Encoding: gzip\r\nTransfer-Encoding: chunked\r\n\r\n10\r\n"+compressed.substr(0,16)+"\r\n");
+    if (p.requests.size()!=1) return(-1);
+    p.feedAll("0\r\n\r\n");//Niepełne dane skompresowane.
+    if (!p.closed) return(-1);
+  }
+  {
+    TestParser p;
+    p.decompressBody(1<<20);
+    p.feedAll("POST /x HTTP/1.1\r\nContent-Encoding: gzip\r\nContent-Length: 5\r\n\r\nhello");
+    if (!p.closed) return(-1);
+  }
+  {//Dane o dużym stopniu kompresji (8 MB zer) - przekroczony limit rozmiaru po dekompresji.
+    ict::boost::connection::zlib::Encoder e;
+    std::string zeros(1<<20,'\0'),compressed;
+    if (e.begin(ict::boost::connection::zlib::format_gzip,9)) return(-1);
+    for (std::size_t k=0;k<8;k++) if (e.write(zeros.data(),zeros.size(),compressed,false,k==7)) return(-1);
+    e.end();
+    TestParser p;
+    p.decompressBody(1<<20);
+    p.feedAll("POST /x HTTP/1.1\r\nContent-Encoding: gzip\r\nContent-Length: "+std::to_string(compressed.size())+"\r\n\r\n"+compressed);
+    if ((!p.closed)||(!p.requests.empty())||(p.output.find(zeros.substr(0,1024))!=std::string::npos)) return(-1);
+  }
+  return(0);
+}
 #endif
 //===========================================
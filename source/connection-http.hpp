@@ -37,8 +37,14 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define _CONNECTION_HTTP_HEADER
 //============================================
 #include <map>
+#include <ctime>
 #include <vector>
+#include <atomic>
+#include <functional>
+#include <boost/utility/string_ref.hpp>
 #include "connection.hpp"
+#include "connection-scan.hpp"
+#include "connection-zlib.hpp"
 #include "../libict/source/time.hpp"
 //============================================
 namespace ict { namespace boost { namespace connection { namespace http {
@@ -58,7 +64,90 @@ struct header_config_t {
   bool multiple_lines;
 };
 typedef std::map<std::string,header_config_t> config_t;
-typedef std::map<std::string,std::vector<std::string>> headers_t;
+//! Metoda HTTP.
+enum method_t {
+  method_other,
+  method_get,
+  method_head,
+  method_post,
+  method_put,
+  method_delete,
+  method_connect,
+  method_options,
+  method_trace,
+  method_patch
+};
+//! Wersja HTTP.
+enum version_t {
+  version_other,
+  version_1_0,
+  version_1_1
+};
+//! Znany nagłówek HTTP (identyfikator nadawany przez headerId()).
+enum header_t {
+  header_other,
+  header_accept,
+  header_accept_charset,
+  header_accept_encoding,
+  header_accept_language,
+  header_accept_ranges,
+  header_age,
+  header_allow,
+  header_authorization,
+  header_cache_control,
+  header_connection,
+  header_content_disposition,
+  header_content_encoding,
+  header_content_language,
+  header_content_length,
+  header_content_location,
+  header_content_range,
+  header_content_type,
+  header_cookie,
+  header_date,
+  header_etag,
+  header_expect,
+  header_expires,
+  header_forwarded,
+  header_host,
+  header_if_match,
+  header_if_modified_since,
+  header_if_none_match,
+  header_if_range,
+  header_if_unmodified_since,
+  header_keep_alive,
+  header_last_modified,
+  header_location,
+  header_origin,
+  header_pragma,
+  header_proxy_authorization,
+  header_range,
+  header_referer,
+  header_retry_after,
+  header_server,
+  header_set_cookie,
+  header_te,
+  header_trailer,
+  header_transfer_encoding,
+  header_upgrade,
+  header_user_agent,
+  header_vary,
+  header_via,
+  header_www_authenticate,
+  header_x_forwarded_for,
+  header_count
+};
+//! Fragment odczytanych nagłówków (widok - pozycja i rozmiar, bez kopiowania).
+struct view_t {
+  std::size_t offset;
+  std::size_t size;
+};
+//! Pole nagłówka (widoki nazwy i wartości).
+struct field_t {
+  header_t id;
+  view_t name;
+  view_t value;
+};
 //===========================================
 extern const std::string endl;
 extern const std::string space;
@@ -81,56 +170,329 @@ extern const std::string _connection_;
 extern const std::string _cookie_;
 extern const std::string _set_cookie_;
 extern const std::string _forwarded_;
-extern header_config_t default_config;
-extern config_t config;
+//! Zwraca metodę HTTP dla podanej nazwy (method_other, jeśli nazwa jest nieznana).
+method_t methodId(const char * name,std::size_t size);
+//! Zwraca nazwę metody HTTP (pusty tekst dla method_other).
+const std::string & methodName(method_t method);
+//! Zwraca wersję HTTP dla podanej nazwy (version_other, jeśli nazwa jest nieznana).
+version_t versionId(const char * name,std::size_t size);
+//! Zwraca nazwę wersji HTTP (pusty tekst dla version_other).
+const std::string & versionName(version_t version);
+//! Zwraca identyfikator znanego nagłówka (bez rozróżniania wielkości liter ASCII) - header_other, jeśli nagłówek jest nieznany.
+header_t headerId(const char * name,std::size_t size);
+inline header_t headerId(const std::string & name){return(headerId(name.data(),name.size()));}
+//! Zwraca nazwę znanego nagłówka (małe litery; pusty tekst dla header_other).
+const std::string & headerName(header_t id);
+//! Zwraca komunikat statusu HTTP dla podanego kodu (nullptr, jeśli kod jest nieznany).
+const char * statusReason(unsigned int code);
+//! Zwraca gotową status line (nullptr, jeśli wersja, kod i komunikat nie pasują do tablicy statusów).
+const std::string * statusLine(version_t version,const std::string & code,const std::string & reason);
+//! Zwraca aktualną datę w formacie nagłówka date (odświeżaną raz na sekundę, osobno w każdym wątku).
+const std::string & httpDate();
+//! Zwraca podany czas w formacie nagłówka date (IMF-fixdate).
+std::string httpDate(std::time_t time);
+//===========================================
+//!
+//! @brief Płaska tablica nagłówków do zapisu.
+//!  Pola są trzymane w kolejności dodania w jednym wektorze, a nazwy (tylko nieznanych nagłówków) i wartości
+//!  w jednym wspólnym buforze tekstowym. Znane nagłówki są rozpoznawane po identyfikatorze (header_t).
+//!  Po clear() pamięć pozostaje, więc kolejne żądania w tym samym połączeniu nie alokują pamięci.
+//!
+class Fields {
+public:
+  //! Pole nagłówka.
+  struct entry_t {
+    //! Identyfikator nagłówka (header_other - nazwa jest w name).
+    header_t id;
+    //! Nazwa nieznanego nagłówka (małe litery ASCII).
+    view_t name;
+    //! Wartość.
+    view_t value;
+  };
+  typedef std::vector<entry_t>::const_iterator const_iterator;
+private:
+  //! Bufor nazw i wartości.
+  std::string text;
+  //! Pola w kolejności dodania.
+  std::vector<entry_t> entries;
+  //! Dopisuje tekst do bufora.
+  view_t store(const char * data,std::size_t size,bool lower);
+  //! Sprawdza, czy pole ma podany identyfikator lub nazwę.
+  bool match(const entry_t & entry,header_t id,const std::string & name) const;
+  void add(header_t id,const std::string & name,const std::string & value);
+  std::size_t erase(header_t id,const std::string & name);
+  std::size_t count(header_t id,const std::string & name) const;
+  ::boost::string_ref get(header_t id,const std::string & name) const;
+public:
+  const_iterator begin() const {return(entries.cbegin());}
+  const_iterator end() const {return(entries.cend());}
+  std::size_t size() const {return(entries.size());}
+  bool empty() const {return(entries.empty());}
+  //! Usuwa wszystkie pola (pamięć pozostaje).
+  void clear() {text.clear();entries.clear();}
+  //! Dodaje pole na końcu.
+  void add(header_t id,const std::string & value) {add(id,std::string(),value);}
+  void add(const std::string & name,const std::string & value) {add(headerId(name),name,value);}
+  //! Zastępuje wszystkie pola o podanej nazwie jednym polem (pusta wartość - tylko usuwa).
+  void set(header_t id,const std::string & value) {erase(id);if (value.size()) add(id,value);}
+  void set(const std::string & name,const std::string & value) {erase(name);if (value.size()) add(name,value);}
+  //! Usuwa pola o podanej nazwie - zwraca liczbę usuniętych pól.
+  std::size_t erase(header_t id) {return(erase(id,std::string()));}
+  std::size_t erase(const std::string & name) {return(erase(headerId(name),name));}
+  //! Zwraca liczbę pól o podanej nazwie.
+  std::size_t count(header_t id) const {return(count(id,std::string()));}
+  std::size_t count(const std::string & name) const {return(count(headerId(name),name));}
+  //! Zwraca widok wartości pierwszego pola o podanej nazwie (pusty, jeśli pola nie ma).
+  ::boost::string_ref get(header_t id) const {return(get(id,std::string()));}
+  ::boost::string_ref get(const std::string & name) const {return(get(headerId(name),name));}
+  //! Zwraca widok nazwy pola.
+  ::boost::string_ref name(const entry_t & entry) const;
+  //! Zwraca widok wartości pola.
+  ::boost::string_ref value(const entry_t & entry) const {return(::boost::string_ref(text.data()+entry.value.offset,entry.value.size));}
+};
+typedef Fields headers_t;
+//===========================================
+//!
+//! @brief Niezmienna konfiguracja nagłówków.
+//!  Konfiguracja znanych nagłówków jest w tablicy indeksowanej identyfikatorem (header_t),
+//!  a nieznanych w posortowanym wektorze. Aktualna konfiguracja jest publikowana przez atomową
+//!  zamianę std::shared_ptr - odczyt nie wymaga blokady, a zmiana nie wymaga zatrzymania wątków.
+//!
+class HeadersConfig {
+private:
+  //! Konfiguracja domyślna.
+  header_config_t fallback;
+  //! Konfiguracja znanych nagłówków.
+  header_config_t known[header_count];
+  //! Konfiguracja nieznanych nagłówków (posortowana wg nazwy).
+  std::vector<std::pair<std::string,header_config_t>> other;
+public:
+  //!
+  //! @brief Tworzy konfigurację.
+  //!
+  //! @param config Konfiguracja nagłówków (nazwy bez rozróżniania wielkości liter ASCII).
+  //! @param default_config Konfiguracja nagłówków, których nie ma w config.
+  //!
+  HeadersConfig(const config_t & config,const header_config_t & default_config);
+  //! Zwraca konfigurację nagłówka (name jest używane tylko dla header_other i musi być małymi literami).
+  const header_config_t & get(header_t id,::boost::string_ref name) const;
+};
+typedef std::shared_ptr<const HeadersConfig> headers_config_ptr_t;
+//! Zwraca aktualną konfigurację nagłówków (pozostaje ważna, dopóki jest przechowywany zwrócony wskaźnik).
+headers_config_ptr_t headersConfig();
+//!
+//! @brief Publikuje nową konfigurację nagłówków.
+//!  Połączenia w trakcie zapisu nagłówków mogą jeszcze używać poprzedniej konfiguracji - jest ona
+//!  zwalniana, gdy zostanie zwolniony ostatni wskaźnik zwrócony przez headersConfig().
+//!
+//! @param config Konfiguracja nagłówków.
+//! @param default_config Konfiguracja nagłówków, których nie ma w config.
+//!
+void setHeadersConfig(const config_t & config,const header_config_t & default_config);
+//! Zwraca konfigurację nagłówków używaną, dopóki nie zostanie wywołane setHeadersConfig().
+const config_t & defaultHeadersConfig();
+//! Zwraca konfigurację domyślną używaną, dopóki nie zostanie wywołane setHeadersConfig().
+const header_config_t & defaultHeaderConfig();
+//===========================================
+//! Parametr wartości nagłówka (widoki do parsowanego tekstu).
+struct param_t {
+  //! Nazwa (bez białych znaków).
+  ::boost::string_ref name;
+  //! Wartość (bez białych znaków i cudzysłowów - sekwencje '\' w cudzysłowie nie są zmieniane).
+  ::boost::string_ref value;
+};
+//! Element nagłówka forwarded (RFC 7239) - widoki do parsowanego tekstu.
+struct forwarded_t {
+  ::boost::string_ref by;
+  ::boost::string_ref for_;
+  ::boost::string_ref host;
+  ::boost::string_ref proto;
+};
+//!
+//! Parsuje wartość nagłówka w postaci listy parametrów "nazwa=wartość" lub "nazwa" (np. cookie, content-type).
+//!  Nie alokuje pamięci poza powiększeniem output - zwracane są widoki do input.
+//!
+//! @param input Wartość nagłówka.
+//! @param separator Separator parametrów (';' lub ',').
+//! @param output Parametry w kolejności wystąpienia (dopisywane na końcu).
+//!
+void parseParams(::boost::string_ref input,char separator,std::vector<param_t> & output);
+//! Zwraca wartość pierwszego parametru o podanej nazwie (bez rozróżniania wielkości liter ASCII - pusty widok, jeśli nie ma).
+::boost::string_ref findParam(const std::vector<param_t> & params,::boost::string_ref name);
+//! Sprawdza, czy wartość accept-encoding dopuszcza podane kodowanie (wprost lub przez "*", z q większym od 0).
+bool acceptsEncoding(::boost::string_ref accept,::boost::string_ref coding);
+//! Usuwa OWS (spacje i tabulatory) z początku i końca.
+::boost::string_ref trimOws(::boost::string_ref value);
+//! Porównuje teksty bez rozróżniania wielkości liter ASCII.
+bool equalNocase(::boost::string_ref a,::boost::string_ref b);
+//!
+//! Parsuje wartość nagłówka forwarded (elementy rozdzielone ',', pary rozdzielone ';').
+//!
+//! @param input Wartość nagłówka.
+//! @param output Elementy w kolejności wystąpienia (dopisywane na końcu).
+//!
+void parseForwarded(::boost::string_ref input,std::vector<forwarded_t> & output);
+//===========================================
+//!
+//! @brief Gotowa odpowiedź - status line, nagłówki i body są zapisane raz (przy tworzeniu) i później tylko wysyłane.
+//!  Obiekt jest niezmienny i współdzielony (wiele połączeń może go wysyłać jednocześnie - bez kopiowania,
+//!  kolejka zapisu trzyma tylko referencję). Nagłówki date i connection są dopisywane przy każdej odpowiedzi.
+//!
+class Prepared {
+private:
+  //! Status line i linie nagłówków (bez pustej linii kończącej nagłówki) - dla HTTP/1.0 i HTTP/1.1.
+  std::string heads[2];
+  //! Body.
+  std::string content;
+  //! Czy przy wysyłaniu dodać nagłówek date.
+  bool with_date=true;
+  Prepared(){}
+  friend std::shared_ptr<const Prepared> prepare(unsigned int code,const headers_t & headers,const std::string & body,const std::string & msg);
+public:
+  //! Zwraca status line i nagłówki dla podanej wersji.
+  const std::string & head(version_t version) const {return(heads[(version==version_1_0)?0:1]);}
+  //! Zwraca body.
+  const std::string & body() const {return(content);}
+  //! Czy przy wysyłaniu dodać nagłówek date (nie ma go w nagłówkach gotowej odpowiedzi).
+  bool date() const {return(with_date);}
+};
+typedef std::shared_ptr<const Prepared> prepared_t;
+//!
+//! Tworzy gotową odpowiedź (np. dla health check, 404 lub małego stałego JSON).
+//!
+//! @param code Kod odpowiedzi.
+//! @param headers Nagłówki (content-length jest ustawiany na podstawie body).
+//! @param body Body.
+//! @param msg Komunikat odpowiedzi (jeśli pusty, to komunikat dla kodu).
+//! @return Gotowa odpowiedź lub nullptr, jeśli nagłówki są niepoprawne.
+//!
+prepared_t prepare(unsigned int code,const headers_t & headers,const std::string & body,const std::string & msg=std::string());
 //===========================================
 class Headers : public ict::boost::connection::TopString {
 private:
   bool server;
-  //! Odczytuje pierwszy lub drugi element start line.
-  int read_start_element(std::string & output,std::size_t min,std::size_t max,const std::string & descr);
-  //! Zapisuje pierwszy lub drugi element start line.
-  int write_start_element(std::string & input,std::size_t min,std::size_t max,const std::string & descr);
-  //! Odczytuje trzeci element start line (opcjonalny).
-  int read_start_last(std::string & output,std::size_t max,const std::string & descr);
-  //! Zapisuje trzeci element start line (opcjonalny).
-  int write_start_last(std::string & input,std::size_t max,const std::string & descr);
-  //! Odczytuje start line (dla request).
-  int read_request_line();
+  //! Odczytane start line i nagłówki (pola start line i nagłówków są widokami do tego bufora).
+  std::string head;
+  //! Elementy odczytanego start line.
+  view_t head_start[3]={{0,0},{0,0},{0,0}};
+  //! Odczytane pola nagłówków.
+  std::vector<field_t> head_fields;
+  //! Stan skanera linii w readString.
+  scan::state_t parse_scan;
+  //! Linie znalezione przez skaner.
+  std::vector<scan::line_t> parse_lines;
+  //! Liczba linii, które zostały już przetworzone.
+  std::size_t parse_done=0;
+  //! Czy start line został już odczytany.
+  bool parse_start=false;
+  //! Sparsowane parametry odczytanego nagłówka.
+  struct params_cache_t {
+    header_t id;
+    char separator;
+    bool parsed;
+    std::vector<param_t> list;
+  };
+  //! Parametry odczytanych nagłówków - parsowane przy pierwszym odwołaniu i ważne do odczytu kolejnych nagłówków (wektory pozostają).
+  mutable std::vector<params_cache_t> params_cache;
+  //! Czy nagłówek forwarded został już sparsowany.
+  mutable bool forwarded_parsed=false;
+  //! Elementy odczytanego nagłówka forwarded.
+  mutable std::vector<forwarded_t> forwarded_cache;
+  //! Czy start line został już zapisany.
+  bool write_start=false;
+  //! Sprawdza i dzieli na elementy start line.
+  int parse_start_line(std::size_t begin,std::size_t end);
+  //! Sprawdza i dodaje linię nagłówka.
+  int parse_header_line(const scan::line_t & line);
+  //! Zapisuje element start line do linii.
+  int write_start_element(std::string & line,const std::string & input,std::size_t min,std::size_t max,const std::string & descr);
+  //! Zapisuje ostatni element start line do linii.
+  int write_start_last(std::string & line,const std::string & input,std::size_t max,const std::string & descr);
   //! Zapisuje start line (dla request).
   int write_request_line();
-  //! Odczytuje start line (dla response).
-  int read_status_line();
   //! Zapisuje start line (dla response).
   int write_status_line();
-  //! Odczytuje nagłówki.
-  int read_headers(headers_t & headers);
-  //! Zapisuje nagłówki.
-  int write_headers(headers_t & headers);
-  //! Odczytuje start line i nagłówki (dla request).
-  int read_request();
+  //! Zapisuje nagłówki (date - czy dodać nagłówek date).
+  int write_headers(headers_t & headers,bool date);
+  //! Zapisuje start line i nagłówki gotowej odpowiedzi.
+  int write_prepared();
   //! Zapisuje start line i nagłówki (dla request).
   int write_request();
-  //! Odczytuje start line i nagłówki (dla response).
-  int read_response();
   //! Zapisuje start line i nagłówki (dla response).
   int write_response();
-  //! Odczytuje start line i nagłówki.
+  //!
+  //! Odczytuje start line i nagłówki (przyrostowo - kolejne wywołania nie przeszukują ponownie odczytanych już danych).
+  //!
+  //! @return Wartosci:
+  //!  @li 0 - zakończone;
+  //!  @li 1 - jeszcze trwa;
+  //!  @li -1 - wystąpił błąd.
+  //!
   int read_all_headers();
   //! Zapisuje start line i nagłówki.
   int write_all_headers();
   //! Informacja, czy nagłówki są w tej chwili odczytywane.
   phase_t reading_phase;
+  //! Czy stringRead() jest w trakcie wykonania (wywołanie zagnieżdżone tylko ustawia read_again).
+  bool read_active=false;
+  //! Czy stringRead() ma przejść fazy odczytu jeszcze raz.
+  bool read_again=false;
+  //!
+  //! Przechodzi kolejne fazy odczytu.
+  //!
+  //! @return Wartosci:
+  //!  @li 0 - zakończone;
+  //!  @li 1 - jeszcze trwa;
+  //!  @li -1 - wystąpił błąd.
+  //!
+  int read_phases();
   void stringRead();
   //! Informacja, czy nagłówki są w tej chwili zapisywane.
   phase_t writing_phase;
+  //! Czy stringWrite() jest w trakcie wykonania (wywołanie zagnieżdżone tylko ustawia write_again).
+  bool write_active=false;
+  //! Czy stringWrite() ma przejść fazy zapisu jeszcze raz.
+  bool write_again=false;
+  //!
+  //! Przechodzi kolejne fazy zapisu.
+  //!
+  //! @return Wartosci:
+  //!  @li 0 - zakończone;
+  //!  @li 1 - jeszcze trwa;
+  //!  @li -1 - wystąpił błąd.
+  //!
+  int write_phases();
   void stringWrite();
 protected:
   //! Normalizuje nazwę nagłówka (małe litery ASCII).
   static void transform_name(std::string & name);
   //! Normalizuje wartość nagłówka i elementu start line (litery ASCII).
   static void transform_value(std::string & value);
+  //! Parsuje wartość nagłówka w postaci listy parametrów (zob. parseParams() - tu wartości są kopiowane).
   static void headerKeyValueParser(const std::string & input,std::map<std::string,std::string> & output);
+  //! Zwraca fragment odczytanych nagłówków jako tekst.
+  std::string headString(const view_t & view) const {return(head.substr(view.offset,view.size));}
+  //! Porównuje fragment odczytanych nagłówków z tekstem (bez rozróżniania wielkości liter ASCII).
+  bool headEqual(const view_t & view,const std::string & text) const;
+  //! Zwraca pierwszą wartość odczytanego nagłówka o podanej nazwie (false, jeśli nagłówka nie ma).
+  bool headSingleHeader(const std::string & name,std::string & value) const;
+  bool headSingleHeader(header_t id,std::string & value) const;
+  //! Zwraca widok całej wartości pierwszego odczytanego nagłówka o podanym identyfikatorze (pusty, jeśli nagłówka nie ma).
+  ::boost::string_ref headValue(header_t id) const;
+  //! Zwraca parametry wszystkich odczytanych nagłówków o podanym identyfikatorze (parsowane raz - widoki ważne do odczytu kolejnych nagłówków).
+  const std::vector<param_t> & headParams(header_t id,char separator=';') const;
+  //! Zwraca wartość parametru odczytanego nagłówka (pusty widok, jeśli nie ma).
+  ::boost::string_ref headParam(header_t id,::boost::string_ref name,char separator=';') const {return(findParam(headParams(id,separator),name));}
+  //! Zwraca odczytane cookie (serwer).
+  const std::vector<param_t> & headCookies() const {return(headParams(header_cookie));}
+  //! Zwraca wartość odczytanego cookie (serwer - pusty widok, jeśli nie ma).
+  ::boost::string_ref headCookie(::boost::string_ref name) const {return(headParam(header_cookie,name));}
+  //! Zwraca elementy odczytanego nagłówka forwarded (parsowane raz - widoki ważne do odczytu kolejnych nagłówków).
+  const std::vector<forwarded_t> & headForwarded() const;
+  //! Zwraca odczytane pola nagłówków (widoki - do użycia z headString() i headEqual()).
+  const std::vector<field_t> & headFields() const {return(head_fields);}
+  //! Zwraca odczytane nagłówki (mapa jest tworzona przy każdym wywołaniu).
+  headers_t headHeaders() const;
   static std::string headerSetCookieHeader(const std::string & name,const std::string & value,ict::time::unix_t maxAge=-1,const std::string & path="",const std::string & domain="",bool secure=true,bool httpOnly=true);
   bool getServer(){return(server);}
   void doStart(){
@@ -140,32 +502,61 @@ protected:
       asyncWrite();
     }
   }
-  std::string request_method;
+  //! Metoda żądania (serwer - odczytana, klient - do zapisu).
+  method_t    request_method=method_other;
+  //! URI żądania do zapisu (klient) - odczytane URI zwraca requestUri().
   std::string request_uri;
-  std::string request_version;
+  //! Wersja żądania (serwer - odczytana, klient - do zapisu).
+  version_t   request_version=version_other;
+  //! Nagłówki żądania do zapisu (klient) - odczytane nagłówki zwracają getSingleRequestHeader() i headHeaders().
   headers_t   request_headers;
-  std::string response_version;
+  //! Wersja odpowiedzi (klient - odczytana, serwer - do zapisu).
+  version_t   response_version=version_other;
+  //! Kod odpowiedzi do zapisu (serwer) - odczytany kod zwraca responseCode().
   std::string response_code;
+  //! Komunikat odpowiedzi do zapisu (serwer) - odczytany komunikat zwraca responseMsg().
   std::string response_msg;
+  //! Nagłówki odpowiedzi do zapisu (serwer) - odczytane nagłówki zwracają getSingleResponseHeader() i headHeaders().
   headers_t   response_headers;
+  //! Gotowa odpowiedź (serwer) - jeśli ustawiona, to zastępuje response_code, response_msg i body, a response_headers są dopisywane do jej nagłówków.
+  prepared_t  response_prepared;
+  //! Zwraca nazwę metody żądania (także metody spoza method_t).
+  std::string requestMethod() const {return(server?headString(head_start[0]):methodName(request_method));}
+  //! Zwraca URI żądania.
+  std::string requestUri() const {return(server?headString(head_start[1]):request_uri);}
+  //! Zwraca kod odpowiedzi.
+  std::string responseCode() const {return(server?response_code:headString(head_start[1]));}
+  //! Zwraca komunikat odpowiedzi.
+  std::string responseMsg() const {return(server?response_msg:headString(head_start[2]));}
   //! Rozpoczyna odczyt nagłówków.
   void startRead(){
     if (server){
-      request_method.clear();
-      request_uri.clear();
-      request_version.clear();
-      request_headers.clear();
+      request_method=method_other;
+      request_version=version_other;
     } else {
-      response_version.clear();
-      response_code.clear();
-      response_msg.clear();
-      response_headers.clear();
+      response_version=version_other;
     }
+    head.clear();
+    head_fields.clear();
+    for (view_t & v : head_start) v={0,0};
+    parse_scan=scan::state_t();
+    parse_lines.clear();
+    parse_done=0;
+    parse_start=false;
     reading_phase=phase_before;
     asyncRead();
+    if (!readString.empty()) stringRead();//Kolejne żądanie (pipelining) może już czekać w buforze.
+  }
+  //! Wznawia odczyt wstrzymany przez readPaused (wywoływać w wątku połączenia).
+  void resumeRead(){
+    if (!readPaused) return;
+    readPaused=false;
+    stringRead();
+    if (!readPaused) asyncRead();
   }
   //! Rozpoczyna zapis nagłówków.
   void startWrite(){
+    write_start=false;
     writing_phase=phase_before;
     asyncWrite();
   }
@@ -248,26 +639,90 @@ public:
     writing_phase(serverIn?phase_end:phase_before){}
 };
 //============================================
+//!
+//! @brief Producent body zapisywanego we fragmentach (chunked).
+//!
+//! @param chunk Tu należy dopisać kolejny fragment body.
+//! @return Wartosci:
+//!  @li 0 - koniec body (chunk może zawierać ostatni fragment);
+//!  @li 1 - jest jeszcze dalsza część body (jeśli chunk jest pusty, to zapis czeka na resumeWrite());
+//!  @li -1 - wystąpił błąd.
+//!
+typedef std::function<int(std::string & chunk)> producer_t;
+//!
+//! @brief Odbiorca body odczytywanego strumieniowo (kolejne fragmenty, bez gromadzenia w request_body/response_body).
+//!
+//! @param data Fragment body.
+//! @param size Rozmiar fragmentu.
+//! @return Wartosci:
+//!  @li 0 - fragment przyjęty;
+//!  @li 1 - fragment przyjęty, ale odczyt ma być wstrzymany (do wywołania resumeRead());
+//!  @li -1 - wystąpił błąd.
+//!
+typedef std::function<int(const char * data,std::size_t size)> consumer_t;
+//============================================
 class Body : public Headers{
 private:
+  //! Faza odczytu body w kodowaniu chunked.
+  enum chunk_phase_t {
+    chunk_size,
+    chunk_data,
+    chunk_data_end,
+    chunk_trailer
+  };
   std::size_t request_content_length=0;
   std::size_t response_content_length=0;
-  void get_single_header(headers_t & headers,const std::string & name,std::string & value);
-  void set_single_header(headers_t & headers,const std::string & name,const std::string & value);
-  //! Pobiera z nagłówków content_length.
-  void get_content_length(headers_t & headers,std::size_t & size);
+  //! Liczba odczytanych bajtów body (bez kodowania chunked).
+  std::size_t body_read=0;
+  //! Czy odczytywane body jest w kodowaniu chunked.
+  bool chunked_read=false;
+  //! Faza odczytu body w kodowaniu chunked.
+  chunk_phase_t chunk_phase=chunk_size;
+  //! Liczba bajtów, które pozostały do odczytu w bieżącym fragmencie.
+  std::size_t chunk_left=0;
+  //! Czy zapisywane body (z producenta) jest w kodowaniu chunked (jeśli nie, to koniec body oznacza zamknięcie połączenia).
+  bool chunked_write=false;
+  //! Czy połączenie keep-alive czeka na kolejne żądanie (z limitem keep_alive_timeout).
+  bool keep_alive_waiting=false;
+  //! Limit bezczynności połączenia sprzed oczekiwania na kolejne żądanie.
+  std::size_t keep_alive_idle=0;
+  //! Czy odczytane nagłówki mają niepoprawne lub nieobsługiwane ramkowanie body (serwer odpowiada 400 i zamyka połączenie).
+  bool framing_invalid=false;
+  //! Czy połączenie ma zostać zamknięte po bieżącej wiadomości (transfer-encoding razem z content-length).
+  bool framing_close=false;
+  //!
+  //! Ustala ramkowanie odczytywanego body (chunked_read albo content_length).
+  //!
+  //! @param content_length Długość body (gdy body nie jest w kodowaniu chunked).
+  //! @return Wartości:
+  //!  @li 0 - ramkowanie poprawne;
+  //!  @li -1 - transfer-encoding inne niż samo chunked lub niepoprawne content-length.
+  //!
+  int read_framing(std::size_t & content_length);
+  //!
+  //! Pobiera z odczytanych nagłówków content_length (0, jeśli nagłówka nie ma).
+  //!
+  //! @param size Długość body.
+  //! @return Wartości:
+  //!  @li 0 - pobrana;
+  //!  @li -1 - wartość niepoprawna (nie same cyfry lub przepełnienie) albo różne wartości w powtórzonych nagłówkach.
+  //!
+  int get_content_length(std::size_t & size);
   //! Ustawia w nagłówkach content_length.
   void set_content_length(headers_t & headers,const std::size_t & size);
+  //! Przekazuje fragment body do odbiorcy (jeśli ustawiony) lub dopisuje go do body.
+  int deliver(std::string & body,consumer_t & consumer,const char * data,std::size_t size);
   //!
   //! Odczyt body.
   //!
   //! @param content_length Probrane z nagłówka content_length.
+  //! @param consumer Odbiorca body (jeśli ustawiony, to body nie jest gromadzone).
   //! @return Wartosci:
   //!  @li 0 - zakończone;
   //!  @li 1 - jeszcze trwa;
   //!  @li -1 - wystąpił błąd.
   //!
-  int read_body(std::string & body,std::size_t & content_length);
+  int read_body(std::string & body,std::size_t & content_length,consumer_t & consumer);
   //!
   //! Zapis body.
   //!
@@ -278,6 +733,36 @@ private:
   //!  @li -1 - wystąpił błąd.
   //!
   int write_body(std::string & body,std::size_t & content_length);
+  //!
+  //! Odczyt body w kodowaniu chunked.
+  //!
+  //! @return Wartosci:
+  //!  @li 0 - zakończone;
+  //!  @li 1 - jeszcze trwa;
+  //!  @li -1 - wystąpił błąd.
+  //!
+  int read_chunks(std::string & body,consumer_t & consumer);
+  //!
+  //! Zapis body z producenta (body - pierwszy fragment).
+  //!
+  //! @return Wartosci:
+  //!  @li 0 - zakończone;
+  //!  @li 1 - jeszcze trwa;
+  //!  @li -1 - wystąpił błąd.
+  //!
+  int write_chunks(producer_t & producer,std::string & body);
+  //! Przygotowuje nagłówki body zapisywanego z producenta.
+  void set_chunked(headers_t & headers,bool chunked);
+  //! Kompresja body odpowiedzi (serwer).
+  ict::boost::connection::zlib::Encoder encoder;
+  //! Dekompresja odczytywanego body.
+  ict::boost::connection::zlib::Decoder decoder;
+  //! Fragment body po dekompresji.
+  std::string decoded;
+  //! Włącza kompresję body odpowiedzi, jeśli klient ją dopuszcza (serwer).
+  void compress_response();
+  //! Włącza dekompresję odczytywanego body, jeśli ma content-encoding gzip lub deflate.
+  int decompress_body();
   int beforeRead();
   int beforeWrite();
   int betweenRead();
@@ -292,13 +777,45 @@ private:
   void after_response();
 protected:
   bool keep_alive=false;
+  //! Limit czasu oczekiwania na kolejne żądanie w połączeniu keep-alive (w sekundach) - jeśli 0, to brak ograniczenia.
+  std::size_t keep_alive_timeout=0;
+  //! Poziom kompresji body odpowiedzi (serwer, 1-9, gzip lub deflate według accept-encoding) - jeśli 0, to odpowiedzi nie są kompresowane.
+  int compress_level=0;
+  //! Minimalny rozmiar body odpowiedzi, które jest kompresowane (body z producenta jest kompresowane zawsze).
+  std::size_t compress_min_size=1024;
+  //! Czy dekompresować odczytywane body z content-encoding gzip lub deflate (można zmienić w betweenRequest() lub betweenResponse()).
+  bool decompress=false;
+  //! Limit rozmiaru body po dekompresji - po jego przekroczeniu wiadomość jest odrzucana (0 - brak ograniczenia).
+  std::size_t decompress_max_size=16*1024*1024;
   std::string request_body;
   std::string response_body;
+  //! Producent body żądania (klient) - jeśli ustawiony, to body jest zapisywane we fragmentach (chunked).
+  producer_t request_producer;
+  //! Producent body odpowiedzi (serwer) - jeśli ustawiony, to body jest zapisywane we fragmentach (chunked, a dla HTTP/1.0 do zamknięcia połączenia).
+  producer_t response_producer;
+  //! Plik z body odpowiedzi (serwer) - jeśli ustawiony, to body jest wysyłane z jądra przez sendfile() (bez kopiowania do pamięci).
+  ict::boost::connection::file_t response_file;
+  //! Pozycja początku body w response_file.
+  std::size_t response_file_offset=0;
+  //! Rozmiar body w response_file.
+  std::size_t response_file_size=0;
+  //! Ustawia body odpowiedzi z pliku (zakres domyślnie od offset do końca pliku).
+  void setResponseFile(const ict::boost::connection::file_t & file,std::size_t offset=0,std::size_t size=std::string::npos);
+  //! Wznawia zapis body, gdy producent wcześniej nie miał gotowego fragmentu (wywoływać w wątku połączenia).
+  void resumeWrite(){asyncWrite();}
+  //! Odbiorca body żądania (serwer) - ustawiany w betweenRequest(), jeśli body ma być odczytywane strumieniowo.
+  consumer_t request_consumer;
+  //! Odbiorca body odpowiedzi (klient) - ustawiany w betweenResponse(), jeśli body ma być odczytywane strumieniowo.
+  consumer_t response_consumer;
   void setResponseCode(unsigned int code);
-  void getSingleRequestHeader(const std::string & name,std::string & value){get_single_header(request_headers,name,value);}
-  void setSingleRequestHeader(const std::string & name,const std::string & value){set_single_header(request_headers,name,value);}
-  void getSingleResponseHeader(const std::string & name,std::string & value){get_single_header(response_headers,name,value);}
-  void setSingleResponseHeader(const std::string & name,const std::string & value){set_single_header(response_headers,name,value);}
+  void getSingleRequestHeader(const std::string & name,std::string & value){if (getServer()) {headSingleHeader(name,value);} else {value=request_headers.get(name).to_string();}}
+  void setSingleRequestHeader(const std::string & name,const std::string & value){request_headers.set(name,value);}
+  void getSingleResponseHeader(const std::string & name,std::string & value){if (getServer()) {value=response_headers.get(name).to_string();} else {headSingleHeader(name,value);}}
+  void setSingleResponseHeader(const std::string & name,const std::string & value){response_headers.set(name,value);}
+  void getSingleRequestHeader(header_t id,std::string & value){if (getServer()) {headSingleHeader(id,value);} else {value=request_headers.get(id).to_string();}}
+  void setSingleRequestHeader(header_t id,const std::string & value){request_headers.set(id,value);}
+  void getSingleResponseHeader(header_t id,std::string & value){if (getServer()) {value=response_headers.get(id).to_string();} else {headSingleHeader(id,value);}}
+  void setSingleResponseHeader(header_t id,const std::string & value){response_headers.set(id,value);}
   //!
   //! Operacje przed request.
   //!
@@ -309,6 +826,15 @@ protected:
   //!
   virtual int beforeRequest(){return(0);}
   //!
+  //! Operacje pomiędzy nagłówkami i body request (serwer - np. ustawienie request_consumer).
+  //!
+  //! @return Wartosci:
+  //!  @li 0 - zakończone;
+  //!  @li 1 - jeszcze trwa;
+  //!  @li -1 - wystąpił błąd.
+  //!
+  virtual int betweenRequest(){return(0);}
+  //!
   //! Operacje po request.
   //!
   //! @return Wartosci:
@@ -327,6 +853,15 @@ protected:
   //!
   virtual int beforeResponse(){return(0);}
   //!
+  //! Operacje pomiędzy nagłówkami i body response (klient - np. ustawienie response_consumer).
+  //!
+  //! @return Wartosci:
+  //!  @li 0 - zakończone;
+  //!  @li 1 - jeszcze trwa;
+  //!  @li -1 - wystąpił błąd.
+  //!
+  virtual int betweenResponse(){return(0);}
+  //!
   //! Operacje po response.
   //!
   //! @return Wartosci:
@@ -0,0 +1,296 @@
+//! @file
+//! @brief Connection (scan) module - Source file.
+//! @author Mariusz Ornowski (mariusz.ornowski@ict-project.pl)
+//! @version 1.0
+//! @date 2016-2017
+//! @copyright ICT-Project Mariusz Ornowski (ict-project.pl)
+/* **************************************************************
+Copyright (c) 2016-2017, ICT-Project Mariusz Ornowski (ict-project.pl)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+3. Neither the name of the ICT-Project Mariusz Ornowski nor the names
+of its contributors may be used to endorse or promote products
+derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**************************************************************/
+//============================================
+#include "connection-scan.hpp"
+#if (defined(__x86_64__)||defined(__i386__))&&(defined(__GNUC__)||defined(__clang__))
+#define ICT_BOOST_SCAN_X86
+#include <immintrin.h>
+#endif
+//============================================
+#ifdef ENABLE_TESTING
+#include "test.hpp"
+#include <random>
+#endif
+//============================================
+namespace ict { namespace boost { namespace connection { namespace scan {
+//============================================
+//! Tablice klasyfikacji znaków.
+struct tables_t {
+  //! Znaki token (RFC 7230).
+  bool token[256];
+  //! Tablica dla młodszej połówki bajtu - bit (h-2) oznacza, że znak h*16+l jest znakiem token.
+  std::uint8_t low[16];
+  //! Tablica dla starszej połówki bajtu - bit (h-2) dla h od 2 do 7.
+  std::uint8_t high[16];
+  tables_t(){
+    static const std::string other("!#$%&'*+-.^_`|~");
+    for (int c=0;c<256;c++) token[c]=(('0'<=c)&&(c<='9'))||(('a'<=c)&&(c<='z'))||(('A'<=c)&&(c<='Z'))||(other.find((char)c)!=std::string::npos);
+    for (int k=0;k<16;k++) low[k]=high[k]=0;
+    for (int h=2;h<8;h++){
+      high[h]=1<<(h-2);
+      for (int l=0;l<16;l++) if (token[h*16+l]) low[l]|=1<<(h-2);
+    }
+  }
+};
+static const tables_t & tables(){
+  static const tables_t t;
+  return(t);
+}
+static inline unsigned lowest(std::uint32_t v){
+#if defined(__GNUC__)||defined(__clang__)
+  return(__builtin_ctz(v));
+#else
+  unsigned n=0;
+  while (!(v&1)) {v>>=1;n++;}
+  return(n);
+#endif
+}
+//! Maski dla n (do 32) bajtów - wersja skalarna (używana też dla końcówek danych).
+static inline void masks(const tables_t & t,const char * data,std::size_t n,std::uint32_t & lf,std::uint32_t & colon,std::uint32_t & bad){
+  lf=colon=bad=0;
+  for (std::size_t k=0;k<n;k++){
+    unsigned char c(data[k]);
+    if (c=='\n') lf|=1u<<k;
+    if (c==':') colon|=1u<<k;
+    if (!t.token[c]) bad|=1u<<k;
+  }
+}
+//!
+//! @brief Przetwarza maski bloku danych zaczynającego się od base.
+//!
+//! @return true, jeśli znaleziono pustą linię.
+//!
+static inline bool walk(const char * data,std::size_t base,std::uint32_t lf,std::uint32_t colon,std::uint32_t bad,state_t & s,std::vector<line_t> & output){
+  for (;;){
+    unsigned i(lf?lowest(lf):32);
+    if (s.colon==std::string::npos){
+      std::uint32_t below((i<32)?((1u<<i)-1):~0u);
+      std::uint32_t c(colon&below);
+      if (c){
+        unsigned k(lowest(c));
+        s.colon=base+k;
+        if (bad&((1u<<k)-1)) s.token=false;
+      } else if (bad&below) {
+        s.token=false;
+      }
+    }
+    if (!lf) return(false);
+    std::size_t e(base+i);
+    line_t l;
+    l.begin=s.line;
+    l.end=((s.line<e)&&(data[e-1]=='\r'))?(e-1):e;
+    l.next=e+1;
+    l.colon=(s.colon<l.end)?s.colon:std::string::npos;
+    l.token=s.token&&(l.colon!=std::string::npos);
+    output.push_back(l);
+    s.line=e+1;
+    s.colon=std::string::npos;
+    s.token=true;
+    if (l.begin==l.end){
+      s.pos=e+1;
+      return(true);
+    }
+    std::uint32_t above((i<31)?~((2u<<i)-1):0);
+    lf&=above;
+    colon&=above;
+    bad&=above;
+  }
+}
+static bool lines_scalar(const char * data,std::size_t size,state_t & s,std::vector<line_t> & output){
+  const tables_t & t(tables());
+  while (s.pos<size){
+    std::size_t base(s.pos);
+    std::size_t n(((size-base)<32)?(size-base):32);
+    std::uint32_t lf,colon,bad;
+    masks(t,data+base,n,lf,colon,bad);
+    s.pos+=n;
+    if (walk(data,base,lf,colon,bad,s,output)) return(true);
+  }
+  return(false);
+}
+#ifdef ICT_BOOST_SCAN_X86
+__attribute__((target("sse4.2"))) static bool lines_sse42(const char * data,std::size_t size,state_t & s,std::vector<line_t> & output){
+  const tables_t & t(tables());
+  const __m128i low(_mm_loadu_si128((const __m128i*)t.low));
+  const __m128i high(_mm_loadu_si128((const __m128i*)t.high));
+  const __m128i nibble(_mm_set1_epi8(0x0f));
+  const __m128i lf_char(_mm_set1_epi8('\n'));
+  const __m128i colon_char(_mm_set1_epi8(':'));
+  const __m128i zero(_mm_setzero_si128());
+  while ((size-s.pos)>=16){
+    std::size_t base(s.pos);
+    __m128i c(_mm_loadu_si128((const __m128i*)(data+base)));
+    __m128i cls(_mm_and_si128(
+      _mm_shuffle_epi8(low,_mm_and_si128(c,nibble)),
+      _mm_shuffle_epi8(high,_mm_and_si128(_mm_srli_epi16(c,4),nibble))
+    ));
+    std::uint32_t lf(_mm_movemask_epi8(_mm_cmpeq_epi8(c,lf_char)));
+    std::uint32_t colon(_mm_movemask_epi8(_mm_cmpeq_epi8(c,colon_char)));
+    std::uint32_t bad(_mm_movemask_epi8(_mm_cmpeq_epi8(cls,zero)));
+    s.pos+=16;
+    if (walk(data,base,lf,colon,bad,s,output)) return(true);
+  }
+  return(lines_scalar(data,size,s,output));
+}
+__attribute__((target("avx2"))) static bool lines_avx2(const char * data,std::size_t size,state_t & s,std::vector<line_t> & output){
+  const tables_t & t(tables());
+  const __m256i low(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)t.low)));
+  const __m256i high(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)t.high)));
+  const __m256i nibble(_mm256_set1_epi8(0x0f));
+  const __m256i lf_char(_mm256_set1_epi8('\n'));
+  const __m256i colon_char(_mm256_set1_epi8(':'));
+  const __m256i zero(_mm256_setzero_si256());
+  while ((size-s.pos)>=32){
+    std::size_t base(s.pos);
+    __m256i c(_mm256_loadu_si256((const __m256i*)(data+base)));
+    __m256i cls(_mm256_and_si256(
+      _mm256_shuffle_epi8(low,_mm256_and_si256(c,nibble)),
+      _mm256_shuffle_epi8(high,_mm256_and_si256(_mm256_srli_epi16(c,4),nibble))
+    ));
+    std::uint32_t lf(_mm256_movemask_epi8(_mm256_cmpeq_epi8(c,lf_char)));
+    std::uint32_t colon(_mm256_movemask_epi8(_mm256_cmpeq_epi8(c,colon_char)));
+    std::uint32_t bad(_mm256_movemask_epi8(_mm256_cmpeq_epi8(cls,zero)));
+    s.pos+=32;
+    if (walk(data,base,lf,colon,bad,s,output)) return(true);
+  }
+  return(lines_scalar(data,size,s,output));
+}
+#endif
+typedef bool (*lines_t)(const char *,std::size_t,state_t &,std::vector<line_t> &);
+static lines_t select(kernel_t kernel){
+#ifdef ICT_BOOST_SCAN_X86
+  switch (kernel){
+    case kernel_avx2:return(lines_avx2);
+    case kernel_sse42:return(lines_sse42);
+    default:break;
+  }
+#endif
+  return(lines_scalar);
+}
+bool supported(kernel_t kernel){
+#ifdef ICT_BOOST_SCAN_X86
+  __builtin_cpu_init();
+  switch (kernel){
+    case kernel_avx2:return(__builtin_cpu_supports("avx2"));
+    case kernel_sse42:return(__builtin_cpu_supports("sse4.2"));
+    default:break;
+  }
+#endif
+  return(kernel==kernel_scalar);
+}
+kernel_t kernel(){
+  static const kernel_t k(supported(kernel_avx2)?kernel_avx2:(supported(kernel_sse42)?kernel_sse42:kernel_scalar));
+  return(k);
+}
+bool lines(const char * data,std::size_t size,state_t & state,std::vector<line_t> & output){
+  static const lines_t f(select(kernel()));
+  return(f(data,size,state,output));
+}
+bool lines(kernel_t kernel,const char * data,std::size_t size,state_t & state,std::vector<line_t> & output){
+  return(select(kernel)(data,size,state,output));
+}
+bool isToken(char c){
+  return(tables().token[(unsigned char)c]);
+}
+//============================================
+}}}}
+//============================================
+#ifdef ENABLE_TESTING
+REGISTER_TEST(connection_scan,tc1){
+  const std::string block(
+    "\r\nGET /some/path?with=colon:inside HTTP/1.1\r\n"
+    "Host: example.com:8080\r\n"
+    "X-Bad Name: value\r\n"
+    "no-colon-line\r\n"
+    "\xC5\x82:utf8\r\n"
+    "Content-Type:text/html;charset=utf-8\n"
+    "Very-Long-Header-Name-That-Spans-More-Than-One-Vector-Block: 0123456789012345678901234567890123456789\r\n"
+    "\r\n"
+    "body:after\r\n"
+  );
+  std::vector<ict::boost::connection::scan::line_t> expected;
+  {
+    ict::boost::connection::scan::state_t s;
+    //Pierwsza linia jest pusta - skanowanie zatrzymuje się zaraz za nią.
+    if (!ict::boost::connection::scan::lines(ict::boost::connection::scan::kernel_scalar,block.data(),block.size(),s,expected)) return(-1);
+    if ((expected.size()!=1)||(s.pos!=2)) return(-1);
+    expected.clear();
+    s=ict::boost::connection::scan::state_t();
+    s.pos=s.line=2;
+    if (!ict::boost::connection::scan::lines(ict::boost::connection::scan::kernel_scalar,block.data(),block.size(),s,expected)) return(-1);
+    if (expected.size()!=8) return(-1);
+    if (expected[0].token) return(-1);//"GET /some/path?with=colon" zawiera spacje.
+    if (!expected[1].token) return(-1);
+    if (block.substr(expected[1].begin,expected[1].colon-expected[1].begin)!="Host") return(-1);
+    if (expected[2].token) return(-1);
+    if ((expected[3].colon!=std::string::npos)||expected[3].token) return(-1);
+    if (expected[4].token) return(-1);
+    if (!expected[5].token) return(-1);
+    if (block.substr(expected[5].colon+1,expected[5].end-expected[5].colon-1)!="text/html;charset=utf-8") return(-1);
+    if (!expected[6].token) return(-1);
+    if (expected[7].begin!=expected[7].end) return(-1);
+    if (block.compare(s.pos,std::string::npos,"body:after\r\n")) return(-1);
+  }
+  //Wszystkie implementacje, przy dowolnym podziale danych, muszą dać ten sam wynik.
+  std::mt19937 g(7);
+  for (int kernel=ict::boost::connection::scan::kernel_scalar;kernel<=ict::boost::connection::scan::kernel_avx2;kernel++){
+    if (!ict::boost::connection::scan::supported((ict::boost::connection::scan::kernel_t)kernel)) continue;
+    for (int r=0;r<200;r++){
+      std::vector<ict::boost::connection::scan::line_t> output;
+      ict::boost::connection::scan::state_t s;
+      std::size_t size(2);
+      s.pos=s.line=2;
+      bool done(false);
+      while (!done){
+        if (size>=block.size()) return(-1);
+        size+=1+g()%((r%2)?3:40);
+        if (size>block.size()) size=block.size();
+        done=ict::boost::connection::scan::lines((ict::boost::connection::scan::kernel_t)kernel,block.data(),size,s,output);
+      }
+      if (output.size()!=expected.size()) return(-1);
+      for (std::size_t k=0;k<output.size();k++){
+        if (output[k].begin!=expected[k].begin) return(-1);
+        if (output[k].end!=expected[k].end) return(-1);
+        if (output[k].next!=expected[k].next) return(-1);
+        if (output[k].colon!=expected[k].colon) return(-1);
+        if (output[k].token!=expected[k].token) return(-1);
+      }
+    }
+  }
+  return(0);
+}
+#endif
+//===========================================
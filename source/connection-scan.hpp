@@ -0,0 +1,100 @@
+//! @file
+//! @brief Connection (scan) module - header file.
+//! @author Mariusz Ornowski (mariusz.ornowski@ict-project.pl)
+//! @version 1.0
+//! @date 2016-2017
+//! @copyright ICT-Project Mariusz Ornowski (ict-project.pl)
+/* **************************************************************
+Copyright (c) 2016-2017, ICT-Project Mariusz Ornowski (ict-project.pl)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+3. Neither the name of the ICT-Project Mariusz Ornowski nor the names
+of its contributors may be used to endorse or promote products
+derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**************************************************************/
+#ifndef _CONNECTION_SCAN_HEADER
+#define _CONNECTION_SCAN_HEADER
+//============================================
+#include <string>
+#include <vector>
+#include <cstdint>
+//============================================
+namespace ict { namespace boost { namespace connection { namespace scan {
+//===========================================
+//! Implementacja skanera.
+enum kernel_t {
+  kernel_scalar,
+  kernel_sse42,
+  kernel_avx2
+};
+//! Linia znaleziona przez skaner.
+struct line_t {
+  //! Początek linii.
+  std::size_t begin;
+  //! Koniec treści linii (bez CR LF).
+  std::size_t end;
+  //! Początek następnej linii.
+  std::size_t next;
+  //! Pozycja pierwszego dwukropka w linii (npos, jeśli brak).
+  std::size_t colon;
+  //! Czy przed dwukropkiem są wyłącznie znaki token (RFC 7230) - false, jeśli brak dwukropka.
+  bool token;
+};
+//! Stan skanera - pozwala wznowić skanowanie po dopisaniu danych bez ponownego przeglądania bajtów.
+struct state_t {
+  //! Miejsce, do którego dane zostały przeskanowane.
+  std::size_t pos=0;
+  //! Początek bieżącej (niezakończonej) linii.
+  std::size_t line=0;
+  //! Pierwszy dwukropek w bieżącej linii.
+  std::size_t colon=std::string::npos;
+  //! Czy dotychczasowe znaki bieżącej linii (przed dwukropkiem) są znakami token.
+  bool token=true;
+};
+//!
+//! @brief Dzieli blok nagłówków na linie w jednym przebiegu.
+//!  Przy okazji znajduje pierwszy dwukropek w każdej linii i sprawdza, czy znaki przed nim są znakami token.
+//!  Linia kończy się LF (CR przed LF nie należy do treści linii). Skanowanie zatrzymuje się po pierwszej pustej linii.
+//!
+//! @param data Dane.
+//! @param size Rozmiar danych.
+//! @param state Stan skanera (początkowo domyślny, potem przekazywany między wywołaniami).
+//! @param output Znalezione linie są dopisywane na końcu.
+//! @return Wartości:
+//!  @li true - znaleziono pustą linię (state.pos wskazuje miejsce za nią);
+//!  @li false - potrzeba więcej danych.
+//!
+bool lines(const char * data,std::size_t size,state_t & state,std::vector<line_t> & output);
+//! Jak wyżej, ale z użyciem wskazanej implementacji (musi być obsługiwana - patrz supported()).
+bool lines(kernel_t kernel,const char * data,std::size_t size,state_t & state,std::vector<line_t> & output);
+//! Sprawdza, czy implementacja jest obsługiwana przez procesor.
+bool supported(kernel_t kernel);
+//! Zwraca implementację wybraną dla tego procesora.
+kernel_t kernel();
+//! Sprawdza, czy znak jest znakiem token (RFC 7230).
+bool isToken(char c);
+//============================================
+}}}}
+//===========================================
+#endif
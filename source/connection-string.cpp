@@ -42,14 +42,113 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //============================================
 namespace ict { namespace boost { namespace connection { namespace string {
 //============================================
+Buffer::Buffer(const Buffer & other){
+  append(other.data(),other.size());
+}
+Buffer & Buffer::operator=(const Buffer & other){
+  if (this!=&other){
+    clear();
+    append(other.data(),other.size());
+  }
+  return(*this);
+}
+void Buffer::reserveBack(std::size_t n){
+  if (empty()) {
+    head=tail=0;
+    //Pusty bufor nie utrzymuje dużej pamięci (np. po przesłaniu dużego body).
+    if (cap>(4*n)) {
+      p.reset();
+      cap=0;
+    }
+  }
+  if ((cap-tail)>=n) return;
+  if (head&&((cap-tail+head)>=n)&&(size()<=(cap/2))){
+    //Odzyskanie zużytej części - wystarczy przesunąć dane na początek.
+    std::memmove(p.get(),p.get()+head,size());
+    tail-=head;
+    head=0;
+    return;
+  }
+  std::size_t c(cap?cap:n);
+  while (c<(size()+n)) c*=2;
+  std::unique_ptr<char[]> tmp(new char[c]);
+  if (size()) std::memcpy(tmp.get(),p.get()+head,size());
+  tail-=head;
+  head=0;
+  p.swap(tmp);
+  cap=c;
+}
+std::size_t Buffer::find(const std::string & str,std::size_t pos) const{
+  if (str.empty()) return((pos<=size())?pos:npos);
+  if ((pos>=size())||((size()-pos)<str.size())) return(npos);
+  const char * b(data()+pos);
+  const char * e(data()+size()-str.size()+1);
+  while (b<e){
+    b=(const char*)std::memchr(b,str.front(),e-b);
+    if (!b) return(npos);
+    if (!std::memcmp(b,str.data(),str.size())) return(b-data());
+    b++;
+  }
+  return(npos);
+}
+std::size_t Buffer::find(char c,std::size_t pos) const{
+  if (pos>=size()) return(npos);
+  const char * f((const char*)std::memchr(data()+pos,c,size()-pos));
+  return(f?(f-data()):npos);
+}
+std::string Buffer::substr(std::size_t pos,std::size_t n) const{
+  if (pos>size()) pos=size();
+  if (n>(size()-pos)) n=size()-pos;
+  return(std::string(data()+pos,n));
+}
+void Buffer::consume(std::size_t n){
+  head+=(n<size())?n:size();
+}
+void Buffer::shrink(){
+  if (!empty()) return;
+  p.reset();
+  cap=head=tail=0;
+}
+void Buffer::append(const char * data,std::size_t n){
+  if (!n) return;
+  std::memcpy(prepare(n),data,n);
+  commit(n);
+}
+char * Buffer::prepare(std::size_t n){
+  reserveBack(n);
+  return(p.get()+tail);
+}
+//============================================
 Top::~Top(){
 }
 //============================================
 }}}}
 //============================================
 #ifdef ENABLE_TESTING
-//REGISTER_TEST(connection,tc1){
-//  return(0);
-//}
+REGISTER_TEST(connection_string,tc1){
+  ict::boost::connection::string::Buffer b;
+  std::string s;
+  for (int k=0;k<1000;k++){
+    std::string line("line "+std::to_string(k)+"\r\n");
+    char * ptr(b.prepare(line.size()));
+    std::memcpy(ptr,line.data(),line.size());
+    b.commit(line.size());
+    s+=line;
+    if (k%3==0) {
+      std::size_t e(b.find("\r\n"));
+      if (e!=s.find("\r\n")) return(-1);
+      if (b.substr(0,e)!=s.substr(0,e)) return(-1);
+      b.consume(e+2);
+      s.erase(0,e+2);
+    }
+  }
+  if (b.str()!=s) return(-1);
+  if (b.find('7')!=s.find('7')) return(-1);
+  if (b.find("line 999")!=s.find("line 999")) return(-1);
+  b.consume(b.size());
+  if (!b.empty()) return(-1);
+  b.shrink();
+  return(0);
+}
 #endif
 //===========================================
@@ -37,16 +37,77 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define _CONNECTION_STRING_HEADER
 //============================================
 #include <string>
+#include <memory>
+#include <cstring>
 //============================================
 namespace ict { namespace boost { namespace connection { namespace string {
 //===========================================
+//!
+//! @brief Bufor ciągły z kursorem odczytu.
+//!  Dane są zużywane przez przesunięcie kursora (consume()), a nie przez erase(),
+//!  a gniazdo może czytać bezpośrednio do wolnego miejsca na końcu bufora (prepare() i commit()).
+//!  Zużyta część jest odzyskiwana (memmove) dopiero wtedy, gdy brakuje miejsca na końcu.
+//!
+class Buffer {
+private:
+  //! Pamięć bufora.
+  std::unique_ptr<char[]> p;
+  //! Rozmiar pamięci bufora.
+  std::size_t cap=0;
+  //! Początek danych (kursor odczytu).
+  std::size_t head=0;
+  //! Koniec danych.
+  std::size_t tail=0;
+  //! Zapewnia co najmniej n bajtów wolnego miejsca na końcu bufora.
+  void reserveBack(std::size_t n);
+public:
+  typedef std::size_t size_type;
+  static const size_type npos=std::string::npos;
+  Buffer(){}
+  Buffer(const Buffer & other);
+  Buffer & operator=(const Buffer & other);
+  //! Rozmiar danych.
+  std::size_t size() const {return(tail-head);}
+  //! Maksymalny rozmiar danych.
+  std::size_t max_size() const {return(std::string().max_size());}
+  //! Czy bufor jest pusty.
+  bool empty() const {return(tail==head);}
+  //! Zwraca wskaźnik do danych.
+  const char * data() const {return(p.get()+head);}
+  //! Zwraca znak na podanej pozycji.
+  const char & operator[](std::size_t pos) const {return(p[head+pos]);}
+  //! Szuka tekstu od podanej pozycji.
+  std::size_t find(const std::string & str,std::size_t pos=0) const;
+  //! Szuka znaku od podanej pozycji.
+  std::size_t find(char c,std::size_t pos=0) const;
+  //! Zwraca kopię fragmentu danych.
+  std::string substr(std::size_t pos=0,std::size_t n=npos) const;
+  //! Zwraca kopię danych.
+  std::string str() const {return(substr());}
+  //! Przesuwa kursor odczytu o n bajtów (zużywa dane - miejsce zwrócone przez prepare() pozostaje ważne).
+  void consume(std::size_t n);
+  //! Usuwa wszystkie dane (pamięć pozostaje).
+  void clear() {head=tail=0;}
+  //! Zwalnia pamięć, jeśli bufor jest pusty.
+  void shrink();
+  //! Dopisuje dane na końcu.
+  void append(const char * data,std::size_t n);
+  void append(const std::string & str) {append(str.data(),str.size());}
+  Buffer & operator+=(const std::string & str) {append(str);return(*this);}
+  //! Zwraca wolne miejsce (co najmniej n bajtów) na końcu bufora - do bezpośredniego odczytu z gniazda.
+  char * prepare(std::size_t n);
+  //! Dołącza do danych n bajtów zapisanych w miejscu zwróconym przez prepare().
+  void commit(std::size_t n) {tail+=n;}
+};
 //! Stos do obsługi połączenia za pomocą bufora std::string  - góra.
 class Top  {
 protected:
   //! Zamknij połaczenie, gdy skończysz zapis.
   bool closeStringWrite=false;
+  //! Wstrzymaj odczyt - doRead() nie ustawia kolejnego odczytu (odczytane dane czekają w readString).
+  bool readPaused=false;
   //! Bufor odczytu.
-  std::string readString;
+  Buffer readString;
   //! Bufor zapisu.
   std::string writeString;
   //!
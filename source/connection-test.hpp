@@ -0,0 +1,106 @@
+//! @file
+//! @brief Connection (test stack) module - header file (tests only).
+//! @author Mariusz Ornowski (mariusz.ornowski@ict-project.pl)
+//! @version 1.0
+//! @date 2016-2017
+//! @copyright ICT-Project Mariusz Ornowski (ict-project.pl)
+/* **************************************************************
+Copyright (c) 2016-2017, ICT-Project Mariusz Ornowski (ict-project.pl)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+3. Neither the name of the ICT-Project Mariusz Ornowski nor the names
+of its contributors may be used to endorse or promote products
+derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**************************************************************/
+#ifndef _CONNECTION_TEST_HEADER
+#define _CONNECTION_TEST_HEADER
+//============================================
+#include <string>
+#include <vector>
+#include <utility>
+#include <unistd.h>
+#include "connection.hpp"
+//============================================
+namespace ict { namespace boost { namespace connection {
+//===========================================
+//!
+//! @brief Dół stosu do testów - bez gniazda.
+//!  Dane do odczytu są przekazywane przez feed() lub feedAll(), a zapis kończy się natychmiast
+//!  (dane z kolejki zapisu, także fragmenty plików, trafiają do output).
+//!
+template<class Stack>class TestBottom : public Stack{
+protected:
+  void asyncRead(){}
+  void asyncWrite(){writePending=true;}
+  void doClose(){closed=true;}
+  void setIdleTimeout(std::size_t seconds){Stack::idleTimeout=seconds;}
+public:
+  //! Zapisane dane.
+  std::string output;
+  //! Czy połączenie zostało zamknięte.
+  bool closed=false;
+  //! Czy zapis został ustawiony.
+  bool writePending=false;
+  //! Liczba zapisów z kolejki zapisu.
+  std::size_t writes=0;
+  template<class... Args>TestBottom(Args&&... args):Stack(std::forward<Args>(args)...){}
+  //! Dane przychodzą po jednym bajcie.
+  void feed(const std::string & data){
+    for (char c : data){
+      Stack::readPrepare();
+      Stack::readData[0]=c;
+      Stack::readSize=1;
+      Stack::doRead();
+      flush();
+    }
+  }
+  //! Dane przychodzą w jednym odczycie.
+  void feedAll(const std::string & data){
+    Stack::readPrepare();
+    Stack::readString.append(data);
+    Stack::readSize=0;
+    Stack::doRead();
+    flush();
+  }
+  //! Wykonuje ustawione zapisy.
+  void flush(){
+    while (writePending&&!closed){
+      writePending=false;
+      if (Stack::writeQueueSize) writes++;
+      for (const typename Stack::write_buffer_t & b : Stack::writeQueue) if (b.fd>=0){//Fragment pliku.
+        std::string data(b.size,'\0');
+        data.resize(::pread(b.fd,&data[0],b.size,b.offset));
+        output+=data;
+      } else {
+        output.append((const char*)::boost::asio::buffer_cast<const void*>(b.buffer),::boost::asio::buffer_size(b.buffer));
+      }
+      Stack::writeConsume(Stack::writeQueueSize);
+      Stack::doWrite();
+    }
+  }
+};
+//============================================
+}}}
+//===========================================
+#endif
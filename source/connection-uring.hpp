@@ -0,0 +1,314 @@
+//! @file
+//! @brief Connection (io_uring) module - header file.
+//! @author Mariusz Ornowski (mariusz.ornowski@ict-project.pl)
+//! @version 1.0
+//! @date 2017
+//! @copyright ICT-Project Mariusz Ornowski (ict-project.pl)
+/* **************************************************************
+Copyright (c) 2017, ICT-Project Mariusz Ornowski (ict-project.pl)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+3. Neither the name of the ICT-Project Mariusz Ornowski nor the names
+of its contributors may be used to endorse or promote products
+derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**************************************************************/
+#ifndef _CONNECTION_URING_HEADER
+#define _CONNECTION_URING_HEADER
+//============================================
+#include <cstring>
+#include <cerrno>
+#include "connection.hpp"
+#include "uring.hpp"
+//============================================
+namespace ict { namespace boost { namespace connection {
+//===========================================
+//!
+//! @brief Stos do obsługi połączenia - dół (operacje na gnieździe przez io_uring).
+//!  Odczyt jest wielokrotny (multishot) z buforami pierścienia, zapis przez sendmsg,
+//!  a operacje wszystkich połączeń wątku są wysyłane do jądra razem.
+//!  Gdy io_uring nie jest dostępny (lub io_service nie należy do bieżącego wątku),
+//!  działa tak samo jak Bottom.
+//!
+template<class Socket,class Stack>class BottomUring : public Bottom<Socket,Stack>{
+private:
+  typedef Bottom<Socket,Stack> base_t;
+  //! Operacja io_uring połączenia.
+  class Op : public ict::boost::uring::Operation {
+  public:
+    BottomUring * parent;
+    //! Czy to operacja odczytu.
+    bool read;
+    //! Podtrzymuje połączenie do czasu zakończenia operacji.
+    std::shared_ptr<ict::boost::connection::Top> self;
+    Op(BottomUring * parentIn,bool readIn):parent(parentIn),read(readIn){}
+    void complete(int res,unsigned flags){
+      std::shared_ptr<ict::boost::connection::Top> keep;
+      if (!ict::boost::uring::Ring::more(flags)) keep.swap(self);
+      if (read) {
+        parent->readComplete(res,flags);
+      } else {
+        parent->writeComplete(res,flags);
+      }
+    }
+  };
+  //! Maksymalny rozmiar danych odebranych, ale nie przekazanych do stosu (po przekroczeniu odczyt jest wstrzymywany).
+  enum {pendingLimit=65536};
+  //! Pierścień io_uring (nullptr - operacje przez Bottom).
+  ict::boost::uring::Ring * r;
+  //! Operacja odczytu.
+  Op readOp;
+  //! Operacja zapisu.
+  Op writeOp;
+  //! Informuje, czy odczyt został zgłoszony do jądra.
+  bool readArmed=false;
+  //! Dane odebrane, ale jeszcze nie przekazane do stosu.
+  std::string readPending;
+  //! Pozycja w readPending.
+  std::size_t readOffset=0;
+  //! Maksymalna liczba buforów w jednym zapisie (sendmsg).
+  enum {sendBuffers=16};
+  //! Bufory zapisu.
+  std::vector<::boost::asio::const_buffer> writeBuffers;
+  //! Bufory zapisu w postaci dla sendmsg (muszą istnieć do zakończenia zapisu).
+  std::vector<struct iovec> writeIov;
+  //! Opis zapisu dla sendmsg.
+  struct msghdr writeMsg;
+  //! Liczba bajtów w buforach zapisu.
+  std::size_t writeTotal=0;
+  //! Zgłasza odczyt do jądra.
+  void armRead();
+  //! Przekazuje do stosu dane z readPending.
+  void deliver();
+  //! Obsługuje zakończenie odczytu.
+  void readComplete(int res,unsigned flags);
+  //! Obsługuje zakończenie zapisu.
+  void writeComplete(int res,unsigned flags);
+  //! Obsługuje błąd odczytu.
+  void readFailed(::boost::system::error_code ec);
+protected:
+  //! Ustawienie asychronicznego odczytu.
+  void asyncRead();
+  //! Ustawienie asychronicznego zapisu.
+  void asyncWrite();
+public:
+  //! Konstruktor - połączenie działa w io_service gniazda.
+  BottomUring(Socket & socket);
+  //! Konstruktor - połączenie jest przenoszone do podanego io_service (np. z puli wątków).
+  BottomUring(Socket & socket,::boost::asio::io_service & io);
+  //! Czy połączenie korzysta z io_uring.
+  bool uring() const {return(r!=nullptr);}
+  //! Zwraca rozmiar danych odebranych, ale nie przekazanych jeszcze do stosu.
+  std::size_t pending() const {return(readPending.size()-readOffset);}
+  //! Zamyka połącznie.
+  void doClose();
+};
+template<class Socket,class Stack>BottomUring<Socket,Stack>::BottomUring(Socket & socket):
+  base_t(socket),r(ict::boost::uring::Ring::get(ict::boost::asio::ioServiceOf(base_t::s))),readOp(this,true),writeOp(this,false){
+}
+template<class Socket,class Stack>BottomUring<Socket,Stack>::BottomUring(Socket & socket,::boost::asio::io_service & io):
+  base_t(socket,io),r(ict::boost::uring::Ring::get(io)),readOp(this,true),writeOp(this,false){
+}
+template<class Socket,class Stack>void BottomUring<Socket,Stack>::armRead(){
+  readArmed=true;
+  readOp.self=Stack::shared_from_this();
+  if (r->multishot()) {
+    r->recv(readOp,base_t::s.native_handle());
+  } else {
+    Stack::readPrepare();
+    r->recv(readOp,base_t::s.native_handle(),Stack::readData,Stack::readCapacity);
+  }
+}
+template<class Socket,class Stack>void BottomUring<Socket,Stack>::asyncRead(){
+  if (!r) {
+    base_t::asyncRead();
+    return;
+  }
+  auto self(Stack::shared_from_this());
+  if (base_t::stopped) return;
+  if (base_t::readWaiting) return;
+  base_t::readWaiting=true;
+  if (readOffset<readPending.size()) {
+    ict::boost::asio::ioServiceOf(base_t::s).post([this,self](){
+      LOGGER_LAYER;
+      deliver();
+    });
+  } else if (!readArmed) {
+    armRead();
+  }
+}
+template<class Socket,class Stack>void BottomUring<Socket,Stack>::deliver(){
+  if (base_t::stopped||(!base_t::readWaiting)) return;
+  std::size_t length(readPending.size()-readOffset);
+  if (!length) return;
+  Stack::readAdapt(length);
+  Stack::readPrepare();
+  if (length>Stack::readCapacity) length=Stack::readCapacity;
+  std::memcpy(Stack::readData,readPending.data()+readOffset,length);
+  readOffset+=length;
+  if (readOffset==readPending.size()){
+    readPending.clear();
+    readOffset=0;
+  }
+  base_t::readWaiting=false;
+  Stack::readSize=length;
+  base_t::readCompleted(length);
+  try {
+    Stack::doRead();
+    LOGGER_DEBUG<<__LOGGER__<<"Connection "<<Stack::socketDesc()<<" read count: "<<length<<std::endl;
+  } catch (std::exception& e) {
+    LOGGER_ERR<<__LOGGER__<<"Exception: "<<e.what()<<std::endl;
+    doClose();
+  }
+  //Wstrzymany odczyt jest wznawiany, gdy stos odebrał zaległe dane.
+  if (base_t::readWaiting&&(!readArmed)&&(!base_t::stopped)&&readPending.empty()) armRead();
+}
+template<class Socket,class Stack>void BottomUring<Socket,Stack>::readFailed(::boost::system::error_code ec){
+  if (base_t::stopped) return;
+  base_t::readWaiting=false;
+  try {
+    Stack::readError(ec);
+  } catch (std::exception& e) {
+    LOGGER_ERR<<__LOGGER__<<"Exception: "<<e.what()<<std::endl;
+  }
+  doClose();
+}
+template<class Socket,class Stack>void BottomUring<Socket,Stack>::readComplete(int res,unsigned flags){
+  bool buffer(ict::boost::uring::Ring::hasBuffer(flags));
+  if (!ict::boost::uring::Ring::more(flags)) readArmed=false;
+  if (res<0) {
+    if (res==-EINVAL&&r->multishot()&&(!base_t::stopped)){
+      //Jądro nie obsługuje wielokrotnego odczytu.
+      r->disableMultishot();
+      if (base_t::readWaiting) armRead();
+    } else if (res==-ENOBUFS&&(!base_t::stopped)){
+      //Brak wolnych buforów w pierścieniu - ponowienie odczytu.
+      if (base_t::readWaiting&&(!readArmed)) armRead();
+    } else if (res!=-ECANCELED){
+      readFailed(::boost::system::error_code(-res,::boost::system::system_category()));
+    }
+    return;
+  }
+  if (res==0) {
+    readFailed(::boost::asio::error::eof);
+    return;
+  }
+  if (!buffer) {
+    //Odczyt jednorazowy - dane są już w buforze stosu.
+    if (base_t::stopped) return;
+    base_t::readWaiting=false;
+    Stack::readAdapt(res);
+    Stack::readSize=res;
+    base_t::readCompleted(res);
+    try {
+      Stack::doRead();
+      LOGGER_DEBUG<<__LOGGER__<<"Connection "<<Stack::socketDesc()<<" read count: "<<res<<std::endl;
+    } catch (std::exception& e) {
+      LOGGER_ERR<<__LOGGER__<<"Exception: "<<e.what()<<std::endl;
+      doClose();
+    }
+    return;
+  }
+  if (!base_t::stopped) readPending.append((const char*)r->buffer(flags),res);
+  r->release(flags);
+  if (base_t::stopped) return;
+  if ((readPending.size()-readOffset)>=pendingLimit) {
+    if (readArmed) r->cancel(readOp);
+  }
+  deliver();
+  if (base_t::readWaiting&&(!readArmed)&&(!base_t::stopped)&&(readOffset==readPending.size())) armRead();
+}
+template<class Socket,class Stack>void BottomUring<Socket,Stack>::asyncWrite(){
+  if ((!r)||Stack::writeFile()) {//Fragment pliku jest wysyłany przez sendfile() w Bottom.
+    base_t::asyncWrite();
+    return;
+  }
+  if (base_t::stopped) return;
+  if (base_t::writeWaiting) return;
+  base_t::writeWaiting=true;
+  writeOp.self=Stack::shared_from_this();
+  if (Stack::writeQueueSize){
+    Stack::writeGather(writeBuffers,sendBuffers);
+  } else {
+    writeBuffers.clear();
+    writeBuffers.emplace_back(Stack::writeData,Stack::bufferSize>Stack::writeSize?Stack::writeSize:Stack::bufferSize);
+  }
+  writeTotal=0;
+  writeIov.clear();
+  for (const ::boost::asio::const_buffer & b : writeBuffers){
+    struct iovec v;
+    v.iov_base=(void*)::boost::asio::buffer_cast<const void*>(b);
+    v.iov_len=::boost::asio::buffer_size(b);
+    writeIov.push_back(v);
+    writeTotal+=v.iov_len;
+  }
+  std::memset(&writeMsg,0,sizeof(writeMsg));
+  writeMsg.msg_iov=writeIov.data();
+  writeMsg.msg_iovlen=writeIov.size();
+  r->send(writeOp,base_t::s.native_handle(),writeMsg);
+}
+template<class Socket,class Stack>void BottomUring<Socket,Stack>::writeComplete(int res,unsigned flags){
+  base_t::writeWaiting=false;
+  if (base_t::stopped) return;
+  try {
+    if (res<0) {
+      Stack::writeError(::boost::system::error_code(-res,::boost::system::system_category()));
+      doClose();
+    } else if ((std::size_t)res<writeTotal) {
+      //Niepełny zapis - zapisane dane są usuwane, a zapis reszty jest ponawiany (stos nie jest informowany).
+      if (Stack::writeQueueSize){
+        Stack::writeConsume(res);
+      } else {
+        std::memmove(Stack::writeData,Stack::writeData+res,writeTotal-res);
+        Stack::writeSize=writeTotal-res;
+      }
+      base_t::writeCompleted(res);
+      LOGGER_DEBUG<<__LOGGER__<<"Connection "<<Stack::socketDesc()<<" write count: "<<res<<" of "<<writeTotal<<std::endl;
+      asyncWrite();
+    } else {
+      if (Stack::writeQueueSize){
+        Stack::writeConsume(writeTotal);
+      } else {
+        Stack::writeSize=0;
+      }
+      base_t::writeCompleted(writeTotal);
+      res=writeTotal;
+      Stack::doWrite();
+      LOGGER_DEBUG<<__LOGGER__<<"Connection "<<Stack::socketDesc()<<" write count: "<<res<<std::endl;
+    }
+  } catch (std::exception& e) {
+    LOGGER_ERR<<__LOGGER__<<"Exception: "<<e.what()<<std::endl;
+    doClose();
+  }
+}
+template<class Socket,class Stack>void BottomUring<Socket,Stack>::doClose(){
+  if (r&&(!base_t::stopped)) {
+    if (readArmed) r->cancel(readOp);
+    if (base_t::writeWaiting) r->cancel(writeOp);
+  }
+  base_t::doClose();
+}
+//============================================
+}}}
+//===========================================
+#endif
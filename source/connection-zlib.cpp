@@ -0,0 +1,243 @@
+//! @file
+//! @brief Connection (zlib) module - Source file.
+//! @author Mariusz Ornowski (mariusz.ornowski@ict-project.pl)
+//! @version 1.0
+//! @date 2016-2017
+//! @copyright ICT-Project Mariusz Ornowski (ict-project.pl)
+/* **************************************************************
+Copyright (c) 2016-2017, ICT-Project Mariusz Ornowski (ict-project.pl)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+3. Neither the name of the ICT-Project Mariusz Ornowski nor the names
+of its contributors may be used to endorse or promote products
+derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**************************************************************/
+//============================================
+#include "connection-zlib.hpp"
+#include <vector>
+#include <cstring>
+#include <zlib.h>
+//============================================
+#ifdef ENABLE_TESTING
+#include "test.hpp"
+#endif
+//============================================
+namespace ict { namespace boost { namespace connection { namespace zlib {
+//============================================
+class Stream {
+public:
+  z_stream z;
+  //! Czy to stan kompresji.
+  bool deflating;
+  format_t format;
+  int level;
+  Stream(bool deflatingIn,format_t formatIn,int levelIn):deflating(deflatingIn),format(formatIn),level(levelIn){
+    std::memset(&z,0,sizeof(z));
+  }
+  ~Stream(){
+    if (deflating) deflateEnd(&z); else inflateEnd(&z);
+  }
+};
+//! Pula stanów wątku (stany zlib są duże, więc pula jest ograniczona).
+struct pool_t {
+  enum {max=8};
+  std::vector<Stream*> deflaters[2];
+  std::vector<Stream*> inflaters;
+  ~pool_t(){
+    for (std::vector<Stream*> & v : deflaters) for (Stream * s : v) delete s;
+    for (Stream * s : inflaters) delete s;
+  }
+};
+static pool_t & pool(){
+  thread_local pool_t p;
+  return(p);
+}
+//! Rozmiar bufora wyjściowego jednego wywołania zlib.
+enum {chunk_size=16384};
+//! Maksymalny rozmiar danych wejściowych jednego wywołania zlib.
+enum {input_max=1<<30};
+void release_t::operator()(Stream * stream) const{
+  std::vector<Stream*> & v(stream->deflating?pool().deflaters[stream->format]:pool().inflaters);
+  if (v.size()<pool_t::max){
+    v.push_back(stream);
+  } else {
+    delete stream;
+  }
+}
+//! Pobiera stan kompresji z puli (lub tworzy nowy).
+static stream_t acquire_deflate(format_t format,int level){
+  std::vector<Stream*> & v(pool().deflaters[format]);
+  while (v.size()){
+    stream_t s(v.back());
+    v.pop_back();
+    if (deflateReset(&s->z)!=Z_OK) continue;
+    if (s->level!=level){
+      if (deflateParams(&s->z,level,Z_DEFAULT_STRATEGY)!=Z_OK) continue;
+      s->level=level;
+    }
+    return(s);
+  }
+  std::unique_ptr<Stream> s(new Stream(true,format,level));
+  if (deflateInit2(&s->z,level,Z_DEFLATED,(format==format_gzip)?(16+MAX_WBITS):MAX_WBITS,8,Z_DEFAULT_STRATEGY)!=Z_OK) return(nullptr);
+  return(stream_t(s.release()));
+}
+//! Pobiera stan dekompresji z puli (lub tworzy nowy).
+static stream_t acquire_inflate(){
+  std::vector<Stream*> & v(pool().inflaters);
+  while (v.size()){
+    stream_t s(v.back());
+    v.pop_back();
+    if (inflateReset(&s->z)==Z_OK) return(s);
+  }
+  std::unique_ptr<Stream> s(new Stream(false,format_gzip,0));
+  if (inflateInit2(&s->z,32+MAX_WBITS)!=Z_OK) return(nullptr);//Format rozpoznawany po nagłówku.
+  return(stream_t(s.release()));
+}
+//============================================
+int Encoder::begin(format_t format,int level){
+  if (level<1) level=1;
+  if (level>9) level=9;
+  stream=acquire_deflate(format,level);
+  return(stream?0:-1);
+}
+int Encoder::write(const char * data,std::size_t size,std::string & output,bool flush,bool finish){
+  char buffer[chunk_size];
+  if (!stream) return(-1);
+  z_stream & z(stream->z);
+  do {
+    std::size_t s((size<input_max)?size:input_max);
+    bool last(s==size);
+    int mode(last?(finish?Z_FINISH:(flush?Z_SYNC_FLUSH:Z_NO_FLUSH)):Z_NO_FLUSH);
+    int r;
+    z.next_in=(Bytef*)data;
+    z.avail_in=s;
+    do {
+      z.next_out=(Bytef*)buffer;
+      z.avail_out=sizeof(buffer);
+      r=deflate(&z,mode);
+      if (r==Z_STREAM_ERROR) return(-1);
+      output.append(buffer,sizeof(buffer)-z.avail_out);
+    } while ((z.avail_out==0)||((mode==Z_FINISH)&&(r!=Z_STREAM_END)));
+    data+=s;
+    size-=s;
+  } while (size);
+  return(0);
+}
+//============================================
+int Decoder::begin(std::size_t max){
+  finished=false;
+  limit=max;
+  total=0;
+  stream=acquire_inflate();
+  return(stream?0:-1);
+}
+int Decoder::write(const char * data,std::size_t size,std::string & output){
+  char buffer[chunk_size];
+  if (!stream) return(-1);
+  if (finished) return(size?-1:0);
+  z_stream & z(stream->z);
+  while (size){
+    std::size_t s((size<input_max)?size:input_max);
+    z.next_in=(Bytef*)data;
+    z.avail_in=s;
+    for (;;){
+      int r;
+      z.next_out=(Bytef*)buffer;
+      z.avail_out=sizeof(buffer);
+      r=inflate(&z,Z_NO_FLUSH);
+      total+=sizeof(buffer)-z.avail_out;
+      if (exceeded()) return(-1);//Sprawdzane przy każdym buforze - dane o dużym stopniu kompresji nie zajmą pamięci ponad limit.
+      output.append(buffer,sizeof(buffer)-z.avail_out);
+      if (r==Z_STREAM_END){
+        finished=true;
+        return((z.avail_in||(size>s))?-1:0);//Dane za końcem danych skompresowanych.
+      }
+      if (r==Z_BUF_ERROR) break;//Potrzebne kolejne dane.
+      if (r!=Z_OK) return(-1);
+      if (z.avail_out&&(!z.avail_in)) break;
+    }
+    data+=s;
+    size-=s;
+  }
+  return(0);
+}
+//============================================
+}}}}
+//============================================
+#ifdef ENABLE_TESTING
+REGISTER_TEST(connection_zlib,tc1){
+  using namespace ict::boost::connection::zlib;
+  std::string input;
+  for (std::size_t k=0;k<100000;k++) input+=std::to_string(k%977)+",";
+  for (format_t format : {format_gzip,format_deflate}){
+    Encoder e;
+    Decoder d;
+    std::string compressed,output;
+    if (e.begin(format,6)) return(-1);
+    //Fragmenty z wypchnięciem - odbiorca dostaje dane od razu.
+    if (e.write(input.data(),1000,compressed,true,false)) return(-1);
+    if (d.begin()||d.write(compressed.data(),compressed.size(),output)||(output!=input.substr(0,1000))) return(-1);
+    std::size_t before(compressed.size());
+    if (e.write(input.data()+1000,input.size()-1000,compressed,false,true)) return(-1);
+    e.end();
+    if ((compressed.size()>=(input.size()/4))||e.active()) return(-1);
+    //Dekompresja po jednym bajcie.
+    for (std::size_t k=before;k<compressed.size();k++) if (d.write(compressed.data()+k,1,output)) return(-1);
+    if ((!d.done())||(output!=input)) return(-1);
+    if (d.write("x",1,output)==0) return(-1);//Dane za końcem.
+    d.end();
+    if (format==format_gzip){
+      if ((compressed.size()<2)||((unsigned char)compressed[0]!=0x1f)||((unsigned char)compressed[1]!=0x8b)) return(-1);
+    }
+  }
+  {//Stan z puli (inny poziom kompresji) i niepoprawne dane.
+    Encoder e;
+    Decoder d;
+    std::string compressed,output;
+    if (e.begin(format_gzip,1)||e.write("abc",3,compressed,false,true)) return(-1);
+    if (d.begin()||d.write(compressed.data(),compressed.size(),output)||(output!="abc")||!d.done()) return(-1);
+    d.end();
+    output.clear();
+    if (d.begin()||(d.write("not compressed",14,output)==0)) return(-1);
+    d.end();
+  }
+  {//Limit rozmiaru - dane o dużym stopniu kompresji (16 MB zer).
+    Encoder e;
+    Decoder d;
+    std::string input(1<<20,'\0'),compressed,output;
+    if (e.begin(format_gzip,9)) return(-1);
+    for (std::size_t k=0;k<16;k++) if (e.write(input.data(),input.size(),compressed,false,k==15)) return(-1);
+    e.end();
+    if (compressed.size()>(1<<16)) return(-1);
+    if (d.begin(1<<20)||(d.write(compressed.data(),compressed.size(),output)==0)||!d.exceeded()) return(-1);
+    if (output.size()>(1<<20)) return(-1);
+    d.end();
+    output.clear();
+    if (d.begin(16<<20)||d.write(compressed.data(),compressed.size(),output)||d.exceeded()||!d.done()||(output.size()!=(16<<20))) return(-1);
+    d.end();
+  }
+  return(0);
+}
+#endif
+//===========================================
@@ -0,0 +1,142 @@
+//! @file
+//! @brief Connection (zlib) module - header file.
+//! @author Mariusz Ornowski (mariusz.ornowski@ict-project.pl)
+//! @version 1.0
+//! @date 2016-2017
+//! @copyright ICT-Project Mariusz Ornowski (ict-project.pl)
+/* **************************************************************
+Copyright (c) 2016-2017, ICT-Project Mariusz Ornowski (ict-project.pl)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+3. Neither the name of the ICT-Project Mariusz Ornowski nor the names
+of its contributors may be used to endorse or promote products
+derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**************************************************************/
+#ifndef _CONNECTION_ZLIB_HEADER
+#define _CONNECTION_ZLIB_HEADER
+//============================================
+#include <string>
+#include <memory>
+//============================================
+namespace ict { namespace boost { namespace connection { namespace zlib {
+//===========================================
+//! Format danych skompresowanych.
+enum format_t {
+  //! Nagłówek i suma kontrolna gzip (RFC 1952).
+  format_gzip,
+  //! Nagłówek i suma kontrolna zlib (RFC 1950) - kodowanie deflate w HTTP.
+  format_deflate
+};
+//! Stan kompresji lub dekompresji (z_stream) - pobierany z puli wątku i do niej zwracany.
+class Stream;
+//! Zwraca stan do puli bieżącego wątku.
+struct release_t {
+  void operator()(Stream * stream) const;
+};
+typedef std::unique_ptr<Stream,release_t> stream_t;
+//===========================================
+//!
+//! @brief Kompresja strumieniowa.
+//!  Stan zlib jest pobierany z puli wątku w begin() i zwracany w end() - nieużywany koder nie zajmuje pamięci zlib.
+//!
+class Encoder {
+private:
+  stream_t stream;
+public:
+  //!
+  //! Rozpoczyna kompresję.
+  //!
+  //! @param format Format danych skompresowanych.
+  //! @param level Poziom kompresji (1-9).
+  //! @return Wartości:
+  //!  @li 0 - rozpoczęta;
+  //!  @li -1 - wystąpił błąd.
+  //!
+  int begin(format_t format,int level);
+  //!
+  //! Kompresuje fragment danych.
+  //!
+  //! @param data Dane.
+  //! @param size Rozmiar danych.
+  //! @param output Dane skompresowane (dopisywane na końcu).
+  //! @param flush Czy wypchnąć wszystkie dotychczasowe dane (tak, żeby odbiorca mógł je od razu zdekompresować).
+  //! @param finish Czy to ostatni fragment.
+  //! @return Wartości:
+  //!  @li 0 - fragment skompresowany;
+  //!  @li -1 - wystąpił błąd.
+  //!
+  int write(const char * data,std::size_t size,std::string & output,bool flush,bool finish);
+  //! Kończy kompresję (stan wraca do puli wątku).
+  void end(){stream.reset();}
+  //! Czy kompresja jest w toku.
+  bool active() const {return(stream!=nullptr);}
+};
+//===========================================
+//!
+//! @brief Dekompresja strumieniowa (format gzip lub zlib jest rozpoznawany po nagłówku).
+//!  Stan zlib jest pobierany z puli wątku w begin() i zwracany w end().
+//!
+class Decoder {
+private:
+  stream_t stream;
+  //! Czy odczytano koniec danych skompresowanych.
+  bool finished=false;
+  //! Limit rozmiaru danych po dekompresji (0 - brak ograniczenia).
+  std::size_t limit=0;
+  //! Rozmiar danych po dekompresji.
+  std::size_t total=0;
+public:
+  //!
+  //! Rozpoczyna dekompresję.
+  //!
+  //! @param max Limit rozmiaru danych po dekompresji - jeśli 0, to brak ograniczenia.
+  //! @return Wartości:
+  //!  @li 0 - rozpoczęta;
+  //!  @li -1 - wystąpił błąd.
+  //!
+  int begin(std::size_t max=0);
+  //!
+  //! Dekompresuje fragment danych.
+  //!
+  //! @param data Dane skompresowane.
+  //! @param size Rozmiar danych.
+  //! @param output Dane (dopisywane na końcu).
+  //! @return Wartości:
+  //!  @li 0 - fragment zdekompresowany;
+  //!  @li -1 - wystąpił błąd (niepoprawne dane, dane za końcem danych skompresowanych lub przekroczony limit rozmiaru).
+  //!
+  int write(const char * data,std::size_t size,std::string & output);
+  //! Czy odczytano koniec danych skompresowanych.
+  bool done() const {return(finished);}
+  //! Czy przekroczono limit rozmiaru danych po dekompresji.
+  bool exceeded() const {return(limit&&(total>limit));}
+  //! Kończy dekompresję (stan wraca do puli wątku).
+  void end(){stream.reset();}
+  //! Czy dekompresja jest w toku.
+  bool active() const {return(stream!=nullptr);}
+};
+//============================================
+}}}}
+//===========================================
+#endif
@@ -35,6 +35,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 **************************************************************/
 //============================================
 #include "connection.hpp"
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
 //============================================
 #ifdef ENABLE_TESTING
 #include "test.hpp"
@@ -42,7 +45,20 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //============================================
 namespace ict { namespace boost { namespace connection {
 //============================================
+File::~File(){
+  if (descriptor>=0) ::close(descriptor);
+}
+file_t File::open(const std::string & path){
+  std::shared_ptr<File> file(new File);
+  file->descriptor=::open(path.c_str(),O_RDONLY|O_CLOEXEC);
+  if (file->descriptor<0) return(nullptr);
+  if (::fstat(file->descriptor,&file->information)) return(nullptr);
+  if (!S_ISREG(file->information.st_mode)) return(nullptr);
+  return(file);
+}
+//============================================
 Top::Top(){
+  resizeReadBuffer(readBufferMin);
 }
 Top::~Top(){
 }
@@ -55,26 +71,104 @@ std::string Top::socketLocal() const {
 std::string Top::socketRemote() const {
   return(sRemote);
 }
+void Top::writeEnqueue(const void * data,std::size_t size,std::shared_ptr<const void> owner){
+  if (!size) return;
+  writeQueue.emplace_back();
+  writeQueue.back().buffer=::boost::asio::const_buffer(data,size);
+  writeQueue.back().owner=owner;
+  writeQueueSize+=size;
+}
+void Top::writeEnqueue(const std::shared_ptr<const std::string> & data){
+  if (data) writeEnqueue(data->data(),data->size(),data);
+}
+void Top::writeEnqueue(std::string && data){
+  if (data.size()) writeEnqueue(std::make_shared<const std::string>(std::move(data)));
+}
+void Top::writeEnqueueFile(int fd,off_t offset,std::size_t size,std::shared_ptr<const void> owner){
+  if (!size) return;
+  writeQueue.emplace_back();
+  writeQueue.back().owner=owner;
+  writeQueue.back().fd=fd;
+  writeQueue.back().offset=offset;
+  writeQueue.back().size=size;
+  writeQueueSize+=size;
+}
+std::size_t Top::writeGather(std::vector<::boost::asio::const_buffer> & buffers,std::size_t max) const{
+  std::size_t out=0;
+  if (!max) max=IOV_MAX;
+  buffers.clear();
+  buffers.reserve((writeQueue.size()<max)?writeQueue.size():max);
+  for (const write_buffer_t & b : writeQueue){
+    if (buffers.size()>=max) break;
+    if (b.fd>=0) break;//Fragment pliku jest wysyłany osobno.
+    buffers.push_back(b.buffer);
+    out+=::boost::asio::buffer_size(b.buffer);
+  }
+  return(out);
+}
+void Top::setReadBuffer(std::size_t min,std::size_t max){
+  if (!min) min=readBufferMin;
+  if (max<min) max=min;
+  readMin=min;
+  readMax=max;
+  if ((readCapacity<readMin)||(readMax<readCapacity)) resizeReadBuffer(readMin);
+}
+void Top::resizeReadBuffer(std::size_t size){
+  readCapacity=size;
+}
+void Top::readPrepare(){
+  if (readBuffer.size()!=readCapacity){
+    readBuffer.resize(readCapacity);
+    readBuffer.shrink_to_fit();
+  }
+  readData=readBuffer.data();
+}
+void Top::readAdapt(std::size_t length){
+  if ((readCapacity<=length)&&(readCapacity<readMax)) resizeReadBuffer(((2*readCapacity)<readMax)?(2*readCapacity):readMax);
+}
+void Top::writeConsume(std::size_t size){
+  while (size&&writeQueue.size()){
+    std::size_t s((writeQueue.front().fd>=0)?writeQueue.front().size: ::boost::asio::buffer_size(writeQueue.front().buffer));
+    if (size<s){
+      if (writeQueue.front().fd>=0){
+        writeQueue.front().offset+=size;
+        writeQueue.front().size-=size;
+      } else {
+        writeQueue.front().buffer=writeQueue.front().buffer+size;
+      }
+      writeQueueSize-=size;
+      return;
+    }
+    size-=s;
+    writeQueueSize-=s;
+    writeQueue.pop_front();
+  }
+}
 //============================================
 TopString::~TopString(){
 }
+void TopString::readPrepare(){
+  readData=(unsigned char*)readString.prepare(readCapacity);
+}
 void TopString::doRead(){
   if ((readSize+readString.size())<readString.max_size()){
-    readString.append((char*)readData,readSize);
+    readString.commit(readSize);
     readSize=0;
-    asyncRead();
+    if (!readPaused) asyncRead();
   }
   stringRead();
 }
 void TopString::doWrite(){
   if (0<writeString.size()){
-    writeSize=writeString.copy((char*)writeData,bufferSize);
-    writeString.erase(0,writeSize);
+    writeEnqueue(std::move(writeString));
+    writeString.clear();
     asyncWrite();
-  } else {
+  } else if (!writeQueueSize) {
     stringWrite();
+  } else {
+    asyncWrite();
   }
-  if (!writeString.size()) if (closeStringWrite) doClose();
+  if ((!writeString.size())&&(!writeQueueSize)) if (closeStringWrite) doClose();
 }
 //============================================
 }}}
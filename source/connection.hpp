@@ -39,6 +39,13 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <functional>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <cerrno>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
 #include "../libict/source/logger.hpp"
 #include "../libict/source/register.hpp"
 #include "asio.hpp"
@@ -46,26 +53,111 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //============================================
 namespace ict { namespace boost { namespace connection {
 //===========================================
+//!
+//! @brief Plik otwarty do odczytu (deskryptor jest zamykany w destruktorze).
+//!  Współdzielony przez shared_ptr - kolejka zapisu utrzymuje go do czasu wysłania danych.
+//!
+class File {
+private:
+  //! Deskryptor.
+  int descriptor=-1;
+  //! Informacje o pliku (z chwili otwarcia).
+  struct stat information;
+  File(){}
+public:
+  ~File();
+  //! Otwiera plik zwykły do odczytu (nullptr, jeśli nie można go otworzyć lub nie jest plikiem zwykłym).
+  static std::shared_ptr<const File> open(const std::string & path);
+  //! Zwraca deskryptor.
+  int fd() const {return(descriptor);}
+  //! Zwraca rozmiar pliku (z chwili otwarcia).
+  std::size_t size() const {return(information.st_size);}
+  //! Zwraca informacje o pliku (z chwili otwarcia).
+  const struct stat & info() const {return(information);}
+};
+typedef std::shared_ptr<const File> file_t;
+//===========================================
 //! Stos do obsługi połączenia - góra.
 class Top : public std::enable_shared_from_this<Top>, public ict::reg::Base {
 protected:
   typedef std::enable_shared_from_this<Top> enable_shared_t;
   //! Opis połączenia.
   std::string sDesc,sLocal,sRemote;
-  //! Rozmiar lokalnego bufora (zapisu i odczytu).
+  //! Rozmiar lokalnego bufora zapisu.
   enum {bufferSize=1024};
+  //! Początkowy (i minimalny) rozmiar bufora odczytu - stos może go zmienić, deklarując własny enum readBufferMin.
+  enum {readBufferMin=1024};
+  //! Maksymalny rozmiar bufora odczytu - stos może go zmienić, deklarując własny enum readBufferMax.
+  enum {readBufferMax=65536};
+  //! Pamięć bufora odczytu.
+  std::vector<unsigned char> readBuffer;
   //! Lokalny bufor odczytu.
-  unsigned char readData[bufferSize];
+  unsigned char * readData=nullptr;
+  //! Rozmiar bufora odczytu.
+  std::size_t readCapacity=0;
+  //! Minimalny rozmiar bufora odczytu połączenia (0 - nie ustawiony, Bottom użyje readBufferMin stosu).
+  std::size_t readMin=0;
+  //! Maksymalny rozmiar bufora odczytu połączenia.
+  std::size_t readMax=0;
   //! Rozmiar odczytanych danych.
   std::size_t readSize=0;
   //! Lokalny bufor zapisu.
   unsigned char writeData[bufferSize];
   //! Rozmiar danych do zapisu.
   std::size_t writeSize=0;
+  //! Bufor w kolejce zapisu (dane nie są kopiowane - owner utrzymuje je do czasu zapisu).
+  struct write_buffer_t {
+    ::boost::asio::const_buffer buffer;
+    std::shared_ptr<const void> owner;
+    //! Deskryptor pliku (-1 - dane są w buffer, w przeciwnym razie są wysyłane przez sendfile()).
+    int fd=-1;
+    //! Pozycja w pliku.
+    off_t offset=0;
+    //! Liczba bajtów z pliku.
+    std::size_t size=0;
+  };
+  //! Kolejka zapisu (ma pierwszeństwo przed writeData, gdy nie jest pusta).
+  std::deque<write_buffer_t> writeQueue;
+  //! Liczba bajtów w kolejce zapisu.
+  std::size_t writeQueueSize=0;
+  //! Dodaje dane do kolejki zapisu (bez kopiowania - owner musi utrzymać dane do czasu zapisu).
+  void writeEnqueue(const void * data,std::size_t size,std::shared_ptr<const void> owner);
+  //! Dodaje bufor do kolejki zapisu (bez kopiowania).
+  void writeEnqueue(const std::shared_ptr<const std::string> & data);
+  //! Przenosi tekst do kolejki zapisu (bez kopiowania).
+  void writeEnqueue(std::string && data);
+  //! Dodaje fragment pliku do kolejki zapisu (wysyłany z jądra przez sendfile() - owner musi utrzymać deskryptor do czasu zapisu).
+  void writeEnqueueFile(int fd,off_t offset,std::size_t size,std::shared_ptr<const void> owner);
+  //! Dodaje fragment pliku do kolejki zapisu.
+  void writeEnqueueFile(const file_t & file,off_t offset,std::size_t size){if (file) writeEnqueueFile(file->fd(),offset,size,file);}
+  //! Zwraca pierwszy element kolejki zapisu, jeśli jest fragmentem pliku (w przeciwnym razie nullptr).
+  write_buffer_t * writeFile() {return((writeQueue.size()&&(writeQueue.front().fd>=0))?&writeQueue.front():nullptr);}
+  //!
+  //! Zbiera bufory z kolejki zapisu do jednego zapisu (writev) - do pierwszego fragmentu pliku.
+  //!
+  //! @param buffers Bufory do zapisu.
+  //! @param max Maksymalna liczba buforów (domyślnie IOV_MAX).
+  //! @return Liczba bajtów w buforach.
+  //!
+  std::size_t writeGather(std::vector<::boost::asio::const_buffer> & buffers,std::size_t max=0) const;
+  //! Usuwa z kolejki zapisu podaną liczbę zapisanych bajtów.
+  void writeConsume(std::size_t size);
+  //! Ustawia rozmiar bufora odczytu połączenia (bufor rośnie od min do max, gdy odczyty go wypełniają).
+  void setReadBuffer(std::size_t min,std::size_t max);
+  //! Zmienia rozmiar bufora odczytu (zmiana jest wykonywana przez readPrepare() przed kolejnym odczytem).
+  void resizeReadBuffer(std::size_t size);
+  //! Przygotowuje bufor odczytu (readData o rozmiarze readCapacity) przed odczytem z gniazda.
+  virtual void readPrepare();
+  //! Powiększa bufor odczytu, jeśli odczyt o podanej długości go wypełnił.
+  void readAdapt(std::size_t length);
   //! Minimalna liczba bajtów na minutę przy odczycie (jeśli nie jest zachowana to połączene jest zamykane) - jeśli 0, to brak ograniczenia.
   std::size_t readMinFlow=0;
   //! Minimalna liczba bajtów na minutę przy zapisie (jeśli nie jest zachowana to połączene jest zamykane) - jeśli 0, to brak ograniczenia.
   std::size_t writeMinFlow=0;
+  //! Limit bezczynności w sekundach (jeśli w tym czasie nie ma odczytu ani zapisu, to połączenie jest zamykane) - jeśli 0, to brak ograniczenia.
+  std::size_t idleTimeout=0;
+  //! Zmienia limit bezczynności - odliczanie zaczyna się od nowa (funkcja nadpisania w Bottom).
+  virtual void setIdleTimeout(std::size_t seconds)=0;
   //! Ustawienie asychronicznego odczytu (funkcja nadpisania w Bottom).
   virtual void asyncRead()=0;
   //! Ustawienie asychronicznego zapisu (funkcja nadpisania w Bottom).
@@ -118,6 +210,8 @@ public:
 //! Stos do obsługi połączenia za pomocą bufora std::string  - góra.
 class TopString : public Top,public ict::boost::connection::string::Top {
 protected:
+  //! Odczyt z gniazda trafia bezpośrednio do readString.
+  void readPrepare();
   void doRead();
   void doWrite();
 public:
@@ -127,18 +221,12 @@ public:
 //! Stos do obsługi połączenia - dół.
 template<class Socket,class Stack>class Bottom : public Stack{
 private:
-  //! Informuje, czy połączenie jest zamknięte.
-  bool stopped=false;
-  //! Informuje, czy odczyt został ustawiony i czeka.
-  bool readWaiting=false;
-  //! Informuje, czy zapis został ustawiony i czeka.
-  bool writeWaiting=false;
-  //! Timer do obliczania liczby bajtów na minutę.
-  ::boost::asio::deadline_timer d;
-  //! Rozmiar odczytanych danych.
-  std::size_t readSizeLast=0;
-  //! Rozmiar zapisanych danych.
-  std::size_t writeSizeLast=0;
+  //! Timer do obliczania liczby bajtów na minutę (w kole czasowym io_service).
+  ict::boost::asio::WheelTimer d;
+  //! Timer limitu bezczynności (w kole czasowym io_service).
+  ict::boost::asio::WheelTimer idleTimer;
+  //! Takt koła czasowego, w którym połączenie było ostatnio aktywne.
+  uint64_t idleLast=0;
   //! Okres czasu, w którym jest wykonywany cykl pomiarowy (w sekundach).
   static const uint8_t duration=3;
   //! Krok do oblizcania prędkości odczytu i zapisu.
@@ -147,19 +235,56 @@ private:
   float readFlow=0;
   //! Prędkość odczytu (bajty na minutę).
   float writeFlow=0;
-  //! Funkcja ustawiająca timer do obliczania liczby bajtów na minutę.
+  //! Funkcja ustawiająca timer do obliczania liczby bajtów na minutę (tylko, gdy są określone minima lub bufor odczytu jest powiększony).
   void scheduleMinFlow();
   //! Funkkcja sprawdzająca liczbę bajtów na minutę i zamukająca połączenie, gdy nie są spełnione określone minima.
   void checkMinFlow();
+  //! Funkcja sprawdzająca limit bezczynności i zamykająca połączenie, gdy został przekroczony.
+  void checkIdle();
+  //! Ustawia opis połączenia.
+  void setDesc();
+  //! Informuje, czy połączenie zostało przeniesione do innego io_service (initThis() jest wtedy wykonywane w jego wątku).
+  bool moved=false;
+  //! Rozpoczyna obsługę połączenia (w wątku io_service gniazda).
+  void startThis();
+  //! Rejestracja połączenia w obciążeniu wątku puli.
+  ict::boost::asio::LoadGuard load;
+  //! Pamięć handlerów odczytu i zapisu (każda operacja używa ponownie swojej pamięci).
+  ict::boost::asio::HandlerMemory readMemory,writeMemory;
 protected:
+  //! Informuje, czy połączenie jest zamknięte.
+  bool stopped=false;
+  //! Informuje, czy odczyt został ustawiony i czeka.
+  bool readWaiting=false;
+  //! Informuje, czy zapis został ustawiony i czeka.
+  bool writeWaiting=false;
+  //! Rozmiar odczytanych danych.
+  std::size_t readSizeLast=0;
+  //! Rozmiar zapisanych danych.
+  std::size_t writeSizeLast=0;
+  //! Informuje, czy odczyt został przerwany w celu zmniejszenia bufora.
+  bool readShrink=false;
   //! Socket.
   Socket s;
   //! Ustawienie asychronicznego odczytu.
   void asyncRead();
   //! Ustawienie asychronicznego zapisu.
   void asyncWrite();
+  //! Ustawienie asychronicznego zapisu fragmentu pliku z początku kolejki zapisu (sendfile() po gotowości gniazda).
+  void asyncSendFile();
+  //! Rejestruje odczyt podanej liczby bajtów (kontrola przepływu i bezczynności).
+  void readCompleted(std::size_t length);
+  //! Rejestruje zapis podanej liczby bajtów (kontrola przepływu i bezczynności).
+  void writeCompleted(std::size_t length);
+  //! Ustawia limit bezczynności połączenia w sekundach (0 - brak limitu).
+  void setIdleTimeout(std::size_t seconds);
 public:
+  //! Konstruktor - połączenie działa w io_service gniazda.
   Bottom(Socket & socket);
+  //! Konstruktor - połączenie jest przenoszone do podanego io_service (np. z puli wątków).
+  //!  Może być wywołany w innym wątku niż wątek io - initThis() przekazuje wtedy start połączenia
+  //!  (timery w kole czasowym io) do wątku io, a do tego czasu połączenie nie może być używane.
+  Bottom(Socket & socket,::boost::asio::io_service & io);
   virtual ~Bottom();
   //! Zamyka połącznie.
   void doClose();
@@ -167,57 +292,115 @@ public:
   void destroyThis();
 };
 template<class Socket,class Stack>void Bottom<Socket,Stack>::scheduleMinFlow() {
-  auto self(Stack::shared_from_this());
   if (stopped) return;
-  d.expires_from_now(::boost::posix_time::seconds(duration));
-  d.async_wait(
-    [this,self](const ::boost::system::error_code & ec){
-      LOGGER_LAYER;
-      if(!ec){
-        if (stopped) return;
-        {
-          float tmpFlow;
-          tmpFlow=readSizeLast*60;
-          tmpFlow/=duration;
-          readFlow=(readFlow*step)+tmpFlow;
-          readFlow/=(step+1);
-          readSizeLast=0;
-          tmpFlow=writeSizeLast*60;
-          tmpFlow/=duration;
-          writeFlow=(writeFlow*step)+tmpFlow;
-          writeFlow/=(step+1);
-          writeSizeLast=0;
-          if (step<(60/duration)) step++;
-        }
-        if ((Stack::readMinFlow&&(readFlow<Stack::readMinFlow))||(Stack::writeMinFlow&&(writeFlow<Stack::writeMinFlow))){
-          doClose();
-          if (readFlow<Stack::readMinFlow) LOGGER_WARN<<__LOGGER__<<"Read flow to low ("<<readFlow<<"<"<<Stack::readMinFlow<<") on connection "<<Stack::socketDesc()<<std::endl;
-          if (writeFlow<Stack::writeMinFlow) LOGGER_WARN<<__LOGGER__<<"Write flow to low ("<<writeFlow<<"<"<<Stack::writeMinFlow<<") on connection "<<Stack::socketDesc()<<std::endl;
-        }
-        scheduleMinFlow();
-      }
+  if (d.active()) return;
+  if (Stack::readMinFlow||Stack::writeMinFlow||(Stack::readMin<Stack::readCapacity)){
+    readSizeLast=0;
+    writeSizeLast=0;
+    d.start(duration,Stack::shared_from_this());
+  }
+}
+template<class Socket,class Stack>void Bottom<Socket,Stack>::checkMinFlow() {
+  LOGGER_LAYER;
+  if (stopped) return;
+  bool idle(readSizeLast==0);
+  {
+    float tmpFlow;
+    tmpFlow=readSizeLast*60;
+    tmpFlow/=duration;
+    readFlow=(readFlow*step)+tmpFlow;
+    readFlow/=(step+1);
+    readSizeLast=0;
+    tmpFlow=writeSizeLast*60;
+    tmpFlow/=duration;
+    writeFlow=(writeFlow*step)+tmpFlow;
+    writeFlow/=(step+1);
+    writeSizeLast=0;
+    if (step<(60/duration)) step++;
+  }
+  //Połączenie bezczynne - bufor odczytu wraca do rozmiaru minimalnego.
+  if (idle&&(Stack::readMin<Stack::readCapacity)&&(!readShrink)){
+    if (!readWaiting) {
+      Stack::resizeReadBuffer(Stack::readMin);
+    } else if (!writeWaiting) {
+      ::boost::system::error_code ec;
+      readShrink=true;
+      s.cancel(ec);
     }
-  );
-  LOGGER_DEBUG<<__LOGGER__<<"Connection "<<Stack::socketDesc()<<": use_count()="<<self.use_count()<<", readFlow="<<readFlow<<", writeFlow="<<writeFlow<<std::endl;
+  }
+  if ((Stack::readMinFlow&&(readFlow<Stack::readMinFlow))||(Stack::writeMinFlow&&(writeFlow<Stack::writeMinFlow))){
+    doClose();
+    if (readFlow<Stack::readMinFlow) LOGGER_WARN<<__LOGGER__<<"Read flow to low ("<<readFlow<<"<"<<Stack::readMinFlow<<") on connection "<<Stack::socketDesc()<<std::endl;
+    if (writeFlow<Stack::writeMinFlow) LOGGER_WARN<<__LOGGER__<<"Write flow to low ("<<writeFlow<<"<"<<Stack::writeMinFlow<<") on connection "<<Stack::socketDesc()<<std::endl;
+    return;
+  }
+  //Timer działa dalej tylko, gdy jest potrzebny (bufor odczytu czekający na zmniejszenie też go wymaga).
+  if (Stack::readMinFlow||Stack::writeMinFlow||(Stack::readMin<Stack::readCapacity)){
+    d.start(duration,Stack::shared_from_this());
+  } else {
+    step=0;
+    readFlow=0;
+    writeFlow=0;
+  }
+  LOGGER_DEBUG<<__LOGGER__<<"Connection "<<Stack::socketDesc()<<": readFlow="<<readFlow<<", writeFlow="<<writeFlow<<std::endl;
+}
+template<class Socket,class Stack>void Bottom<Socket,Stack>::checkIdle() {
+  LOGGER_LAYER;
+  uint64_t elapsed(idleTimer.getWheel().now()-idleLast);
+  if (stopped) return;
+  if (!Stack::idleTimeout) return;
+  if (elapsed<Stack::idleTimeout){
+    idleTimer.start(Stack::idleTimeout-elapsed,Stack::shared_from_this());
+    return;
+  }
+  LOGGER_INFO<<__LOGGER__<<"Idle timeout ("<<Stack::idleTimeout<<" s) on connection "<<Stack::socketDesc()<<std::endl;
+  doClose();
+}
+template<class Socket,class Stack>void Bottom<Socket,Stack>::readCompleted(std::size_t length){
+  scheduleMinFlow();
+  readSizeLast+=length;
+  idleLast=idleTimer.getWheel().now();
+}
+template<class Socket,class Stack>void Bottom<Socket,Stack>::writeCompleted(std::size_t length){
+  scheduleMinFlow();
+  writeSizeLast+=length;
+  idleLast=idleTimer.getWheel().now();
+}
+template<class Socket,class Stack>void Bottom<Socket,Stack>::setIdleTimeout(std::size_t seconds){
+  Stack::idleTimeout=seconds;
+  idleLast=idleTimer.getWheel().now();
+  if (stopped) return;
+  if (seconds) {
+    idleTimer.start(seconds,Stack::shared_from_this());
+  } else {
+    idleTimer.cancel();
+  }
 }
 template<class Socket,class Stack>void Bottom<Socket,Stack>::asyncRead(){
   auto self(Stack::shared_from_this());
   if (stopped) return;
   if (readWaiting) return;
+  Stack::readPrepare();
   //::boost::asio::async_read(
     //s,
   s.async_read_some(
-    ::boost::asio::buffer(Stack::readData,Stack::bufferSize),
-    [this,self](const ::boost::system::error_code & ec, std::size_t length){
+    ::boost::asio::buffer(Stack::readData,Stack::readCapacity),
+    ict::boost::asio::makeHandler(readMemory,[this,self](const ::boost::system::error_code & ec, std::size_t length){
       LOGGER_LAYER;
       readWaiting=false;
       try {
-        if (ec) {
+        if (readShrink&&(ec==::boost::asio::error::operation_aborted)&&(!stopped)) {
+          readShrink=false;
+          Stack::resizeReadBuffer(Stack::readMin);
+          asyncRead();
+        } else if (ec) {
           Stack::readError(ec);
           doClose();
         } else {
+          readShrink=false;
+          Stack::readAdapt(length);
           Stack::readSize=length;
-          readSizeLast+=length;
+          readCompleted(length);
             //LOGGER_DEBUG<<__LOGGER__;
             //smpp::main::memoryDump(LOGGER_DEBUG,Stack::readData,length);
             //LOGGER_DEBUG<<std::endl;
@@ -229,18 +412,97 @@ template<class Socket,class Stack>void Bottom<Socket,Stack>::asyncRead(){
         doClose();
       }
     }
-  );
+  ));
   readWaiting=true;
   LOGGER_DEBUG<<__LOGGER__<<"Connection "<<Stack::socketDesc()<<" use count: "<<self.use_count()<<std::endl;
 }
+template<class Socket,class Stack>void Bottom<Socket,Stack>::asyncSendFile(){
+  auto self(Stack::shared_from_this());
+  //Gotowość gniazda do zapisu (null_buffers - bez zapisu danych, działa też w Boost sprzed async_wait()).
+  s.async_write_some(
+    ::boost::asio::null_buffers(),
+    ict::boost::asio::makeHandler(writeMemory,[this,self](const ::boost::system::error_code & ec,std::size_t){
+      LOGGER_LAYER;
+      writeWaiting=false;
+      if (stopped) return;
+      try {
+        ::boost::system::error_code error(ec);
+        std::size_t length(0);
+        typename Stack::write_buffer_t * file(Stack::writeFile());
+        if ((!error)&&file){
+          //Jedno wywołanie sendfile() wysyła najwyżej tyle, ile zmieści gniazdo - reszta po kolejnej gotowości.
+          off_t offset(file->offset);
+          ssize_t n;
+          if (!s.native_non_blocking()) s.native_non_blocking(true,error);
+          if (!error){
+            n=::sendfile(s.native_handle(),file->fd,&offset,file->size);
+            if (0<n){
+              length=n;
+            } else if (n==0){//Plik jest krótszy niż zakres.
+              error=::boost::asio::error::eof;
+            } else if ((errno!=EAGAIN)&&(errno!=EWOULDBLOCK)&&(errno!=EINTR)){
+              error=::boost::system::error_code(errno,::boost::system::system_category());
+            }
+          }
+        }
+        if (error){
+          Stack::writeError(error);
+          doClose();
+        } else {
+          Stack::writeConsume(length);
+          writeCompleted(length);
+          Stack::doWrite();
+          LOGGER_DEBUG<<__LOGGER__<<"Connection "<<Stack::socketDesc()<<" sendfile count: "<<length<<std::endl;
+        }
+      } catch (std::exception& e) {
+        LOGGER_ERR<<__LOGGER__<<"Exception: "<<e.what()<<std::endl;
+        doClose();
+      }
+    }
+  ));
+  writeWaiting=true;
+}
 template<class Socket,class Stack>void Bottom<Socket,Stack>::asyncWrite(){
   auto self(Stack::shared_from_this());
   if (stopped) return;
   if (writeWaiting) return;
+  if (Stack::writeFile()){
+    asyncSendFile();
+    return;
+  }
+  if (Stack::writeQueueSize){
+    std::vector<::boost::asio::const_buffer> buffers;
+    Stack::writeGather(buffers);
+    ::boost::asio::async_write(
+      s,
+      buffers,
+      ict::boost::asio::makeHandler(writeMemory,[this,self](const ::boost::system::error_code & ec, std::size_t length){
+        LOGGER_LAYER;
+        writeWaiting=false;
+        try {
+          if (ec){
+            Stack::writeError(ec);
+            doClose();
+          } else {
+            Stack::writeConsume(length);
+            writeCompleted(length);
+            Stack::doWrite();
+            LOGGER_DEBUG<<__LOGGER__<<"Connection "<<Stack::socketDesc()<<" write("<<ec<<") count: "<<length<<std::endl;
+          }
+        } catch (std::exception& e) {
+          LOGGER_ERR<<__LOGGER__<<"Exception: "<<e.what()<<std::endl;
+          doClose();
+        }
+      }
+    ));
+    writeWaiting=true;
+    LOGGER_DEBUG<<__LOGGER__<<"Connection "<<Stack::socketDesc()<<" use count: "<<self.use_count()<<std::endl;
+    return;
+  }
   ::boost::asio::async_write(
     s,
     ::boost::asio::buffer(Stack::writeData,Stack::bufferSize>Stack::writeSize?Stack::writeSize:Stack::bufferSize),
-    [this,self](const ::boost::system::error_code & ec, std::size_t length){
+    ict::boost::asio::makeHandler(writeMemory,[this,self](const ::boost::system::error_code & ec, std::size_t length){
       LOGGER_LAYER;
       writeWaiting=false;
       try {
@@ -252,7 +514,7 @@ template<class Socket,class Stack>void Bottom<Socket,Stack>::asyncWrite(){
             //smpp::main::memoryDump(LOGGER_DEBUG,Stack::writeData,length);
             //LOGGER_DEBUG<<std::endl;
           Stack::writeSize=0;
-          writeSizeLast+=length;
+          writeCompleted(length);
           Stack::doWrite();
           LOGGER_DEBUG<<__LOGGER__<<"Connection "<<Stack::socketDesc()<<" write("<<ec<<") count: "<<length<<std::endl;
         }
@@ -261,13 +523,12 @@ template<class Socket,class Stack>void Bottom<Socket,Stack>::asyncWrite(){
         doClose();
       }
     }
-  );
+  ));
   writeWaiting=true;
   LOGGER_DEBUG<<__LOGGER__<<"Connection "<<Stack::socketDesc()<<" use count: "<<self.use_count()<<std::endl;
 }
-template<class Socket,class Stack>Bottom<Socket,Stack>::Bottom(Socket & socket):d(ict::boost::asio::ioService()),s(std::move(socket)){
+template<class Socket,class Stack>void Bottom<Socket,Stack>::setDesc(){
   std::ostringstream out;
-  LOGGER_INFO<<__LOGGER__<<"smpp::connection::Connection has been created ..."<<std::endl;
   out<<"{local:"<<s.local_endpoint()<<", remote:"<<s.remote_endpoint()<<", ptr:"<<this<<"}";
   Stack::sDesc=out.str();
   out.str("");out<<s.local_endpoint();
@@ -275,9 +536,41 @@ template<class Socket,class Stack>Bottom<Socket,Stack>::Bottom(Socket & socket):
   out.str("");out<<s.remote_endpoint();
   Stack::sRemote=out.str();
 }
+template<class Socket,class Stack>Bottom<Socket,Stack>::Bottom(Socket & socket):
+  d(ict::boost::asio::ioServiceOf(socket),[this](){checkMinFlow();}),
+  idleTimer(ict::boost::asio::ioServiceOf(socket),[this](){checkIdle();}),
+  s(std::move(socket)){
+  if (!Stack::readMin) Stack::setReadBuffer(Stack::readBufferMin,Stack::readBufferMax);
+  LOGGER_INFO<<__LOGGER__<<"smpp::connection::Connection has been created ..."<<std::endl;
+  setDesc();
+}
+template<class Socket,class Stack>Bottom<Socket,Stack>::Bottom(Socket & socket,::boost::asio::io_service & io):
+  d(io,[this](){checkMinFlow();}),
+  idleTimer(io,[this](){checkIdle();}),
+  s(io){
+  moved=true;
+  ict::boost::asio::moveSocket(socket,s);
+  if (!Stack::readMin) Stack::setReadBuffer(Stack::readBufferMin,Stack::readBufferMax);
+  LOGGER_INFO<<__LOGGER__<<"smpp::connection::Connection has been created ..."<<std::endl;
+  setDesc();
+}
 template<class Socket,class Stack> void Bottom<Socket,Stack>::initThis() {
-  scheduleMinFlow();
+  if (moved){//Koło czasowe io jest jednowątkowe - start w wątku io (od razu, jeśli to bieżący wątek).
+    auto self(Stack::shared_from_this());
+    moved=false;
+    ict::boost::asio::ioServiceOf(s).dispatch([this,self](){
+      LOGGER_LAYER;
+      startThis();
+    });
+    return;
+  }
+  startThis();
+}
+template<class Socket,class Stack> void Bottom<Socket,Stack>::startThis() {
+  if (stopped) return;
   Stack::doStart();
+  scheduleMinFlow();
+  if (Stack::idleTimeout) setIdleTimeout(Stack::idleTimeout);
 }
 template<class Socket,class Stack>Bottom<Socket,Stack>::~Bottom() {
   LOGGER_INFO<<__LOGGER__<<"smpp::connection::Connection has been destroyed ..."<<std::endl;
@@ -290,6 +583,7 @@ template<class Socket,class Stack>void Bottom<Socket,Stack>::doClose(){
   Stack::doStop();
   s.close();
   d.cancel();
+  idleTimer.cancel();
   LOGGER_DEBUG<<__LOGGER__<<"Connection "<<Stack::socketDesc()<<" use count: "<<self.use_count()<<std::endl;
 }
 template<class Socket,class Stack>void Bottom<Socket,Stack>::destroyThis(){
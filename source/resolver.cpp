@@ -44,12 +44,165 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //============================================
 namespace ict { namespace boost { namespace resolver {
 //============================================
+Cache::~Cache(){
+  work.reset();
+  service.stop();
+  if (thread.joinable()) thread.join();
+}
+Cache & Cache::get(){
+  static Cache cache;
+  return(cache);
+}
+void Cache::query(const key_t & key){
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!work){
+      work.reset(new ::boost::asio::io_service::work(service));
+      thread=std::thread([this](){service.run();});
+    }
+  }
+  service.post([this,key](){query_start(key);});
+}
+void Cache::query_start(const key_t & key){
+  std::shared_ptr<::boost::asio::ip::tcp::resolver> r(std::make_shared<::boost::asio::ip::tcp::resolver>(service));
+  std::shared_ptr<::boost::asio::deadline_timer> d(std::make_shared<::boost::asio::deadline_timer>(service));
+  std::shared_ptr<bool> expired(std::make_shared<bool>(false));
+  LOGGER_DEBUG<<__LOGGER__<<"Trying to resolve "<<key.first<<":"<<key.second<<" ..."<<std::endl;
+  d->expires_from_now(::boost::posix_time::seconds(static_cast<long>(timeout)));
+  d->async_wait(
+    [r,expired](const ::boost::system::error_code& ec){
+      if (ec) return;
+      *expired=true;
+      r->cancel();
+    }
+  );
+  r->async_resolve(
+    ::boost::asio::ip::tcp::resolver::query(key.first,key.second),
+    [this,key,r,d,expired](const ::boost::system::error_code& ec,::boost::asio::ip::tcp::resolver::iterator results){
+      LOGGER_LAYER;
+      d->cancel();
+      if (*expired){
+        LOGGER_INFO<<__LOGGER__<<"Resolving timer "<<key.first<<":"<<key.second<<" has expired ..."<<std::endl;
+        complete(key,::boost::asio::error::timed_out,results);
+      } else {
+        complete(key,ec,results);
+      }
+    }
+  );
+}
+void Cache::complete(const key_t & key,const ::boost::system::error_code & ec,::boost::asio::ip::tcp::resolver::iterator results){
+  std::vector<waiter_t> waiting;
+  ::boost::system::error_code error(ec);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    clock_t::time_point now(clock_t::now());
+    entry_t & e(entries[key]);
+    e.pending=false;
+    if (!ec){
+      e.valid=true;
+      e.results=results;
+      e.error=ec;
+      e.expires=now+std::chrono::seconds(ttl);
+    } else if ((!e.valid)||e.error||(e.expires<=now)){
+      e.valid=true;
+      e.results=::boost::asio::ip::tcp::resolver::iterator();
+      e.error=ec;
+      e.expires=now+std::chrono::seconds(negative_ttl);
+    } else {//Błąd odświeżania w tle nie zastępuje ważnego wyniku.
+      error=e.error;
+      results=e.results;
+    }
+    waiting.swap(e.waiting);
+  }
+  for (waiter_t & w : waiting){
+    cache_handler_t handler(w.handler);
+    w.io->post([handler,error,results](){handler(error,results);});
+    w.work.reset();
+  }
+}
+std::size_t Cache::resolve(const std::string & host,const std::string & port,::boost::asio::io_service & io,cache_handler_t handler){
+  key_t key(host,port);
+  std::size_t id(0);
+  bool send(false);
+  ::boost::system::error_code ec;
+  ::boost::asio::ip::tcp::resolver::iterator results;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    clock_t::time_point now(clock_t::now());
+    if (entries.size()>max_entries) for (auto it=entries.begin();it!=entries.end();){
+      if ((!it->second.pending)&&(it->second.expires<=now)) it=entries.erase(it); else ++it;
+    }
+    entry_t & e(entries[key]);
+    if (e.valid&&(now<e.expires)){
+      ec=e.error;
+      results=e.results;
+      //Wpis używany tuż przed końcem ważności jest odświeżany w tle.
+      if ((!ec)&&(!e.pending)&&((e.expires-now)<std::chrono::seconds(prefetch))) send=e.pending=true;
+    } else {
+      id=++last_id;
+      e.waiting.push_back(waiter_t{id,&io,handler,std::make_shared<::boost::asio::io_service::work>(io)});
+      handler=nullptr;
+      if (!e.pending) send=e.pending=true;
+    }
+    if (send) sent++;
+  }
+  if (send) query(key);
+  if (handler) io.post([handler,ec,results](){handler(ec,results);});
+  return(id);
+}
+bool Cache::cancel(const std::string & host,const std::string & port,std::size_t id){
+  waiter_t waiter;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it(entries.find(key_t(host,port)));
+    if (it==entries.end()) return(false);
+    std::vector<waiter_t> & waiting(it->second.waiting);
+    std::size_t k(0);
+    while ((k<waiting.size())&&(waiting[k].id!=id)) k++;
+    if (k==waiting.size()) return(false);
+    waiter=waiting[k];
+    waiting.erase(waiting.begin()+k);
+  }
+  cache_handler_t handler(waiter.handler);
+  waiter.io->post([handler](){handler(::boost::asio::error::operation_aborted,::boost::asio::ip::tcp::resolver::iterator());});
+  waiter.work.reset();
+  return(true);
+}
+void Cache::setTtl(std::size_t ttlIn,std::size_t negativeTtl,std::size_t prefetchIn){
+  std::lock_guard<std::mutex> lock(mutex);
+  ttl=ttlIn;
+  negative_ttl=negativeTtl;
+  prefetch=prefetchIn;
+}
+void Cache::clear(){
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto it=entries.begin();it!=entries.end();){
+    if (!it->second.pending) it=entries.erase(it); else ++it;
+  }
+}
+std::size_t Cache::size(){
+  std::lock_guard<std::mutex> lock(mutex);
+  return(entries.size());
+}
+std::size_t Cache::queries(){
+  std::lock_guard<std::mutex> lock(mutex);
+  return(sent);
+}
+//============================================
 Tcp::Tcp(const std::string & host,const std::string & port)
-  :r(ict::boost::asio::ioService()),q(host,port),d(ict::boost::asio::ioService()){
+  :io(ict::boost::asio::ioService()),host(host),port(port){
   LOGGER_INFO<<__LOGGER__<<"ict::boost::resolver::Tcp has been created ..."<<std::endl;
 }
 Tcp::Tcp(const std::string & host,const std::string & port,error_handler_t onError)
-  :r(ict::boost::asio::ioService()),q(host,port),d(ict::boost::asio::ioService()),Base(onError){
+  :Base(onError),io(ict::boost::asio::ioService()),host(host),port(port){
+  LOGGER_INFO<<__LOGGER__<<"ict::boost::resolver::Tcp has been created ..."<<std::endl;
+}
+Tcp::Tcp(const std::string & host,const std::string & port,::boost::asio::io_service & io)
+  :io(io),host(host),port(port){
+  LOGGER_INFO<<__LOGGER__<<"ict::boost::resolver::Tcp has been created ..."<<std::endl;
+}
+Tcp::Tcp(const std::string & host,const std::string & port,error_handler_t onError,::boost::asio::io_service & io)
+  :Base(onError),io(io),host(host),port(port){
   LOGGER_INFO<<__LOGGER__<<"ict::boost::resolver::Tcp has been created ..."<<std::endl;
 }
 Tcp::~Tcp(){
@@ -57,51 +210,44 @@ Tcp::~Tcp(){
 }
 void Tcp::doResolve(){
   auto self(enable_shared_t::shared_from_this());
-  LOGGER_DEBUG<<__LOGGER__<<"Trying to resolve "<<q.host_name()<<":"<<q.service_name()<<" ..."<<std::endl;
-  if ((q.host_name()=="")||(q.host_name()=="0.0.0.0")||(q.host_name()=="[::]")){
+  LOGGER_DEBUG<<__LOGGER__<<"Trying to resolve "<<host<<":"<<port<<" ..."<<std::endl;
+  if ((host=="")||(host=="0.0.0.0")||(host=="[::]")){
     any=true;
     try{
-      ::boost::asio::ip::tcp::endpoint endpoint(::boost::asio::ip::tcp::v6(),std::stol(q.service_name()));
+      ::boost::asio::ip::tcp::endpoint endpoint(::boost::asio::ip::tcp::v6(),std::stol(port));
       ep=endpoint;
-      LOGGER_DEBUG<<__LOGGER__<<"Resolving "<<"<any>"<<":"<<q.service_name()<<" has succeeded ..."<<std::endl;
+      LOGGER_DEBUG<<__LOGGER__<<"Resolving "<<"<any>"<<":"<<port<<" has succeeded ..."<<std::endl;
       afterResolve();
     }catch(...){
-      LOGGER_INFO<<__LOGGER__<<"Resolving "<<"<any>"<<":"<<q.service_name()<<" has failed ..."<<std::endl;
+      LOGGER_INFO<<__LOGGER__<<"Resolving "<<"<any>"<<":"<<port<<" has failed ..."<<std::endl;
     }
     return;
   }
-  d.expires_from_now(::boost::posix_time::seconds(60));
-  d.async_wait(
-    [this,self](const ::boost::system::error_code& ec){
+  cancelled=false;
+  ticket=Cache::get().resolve(
+    host,port,io,
+    [this,self](const ::boost::system::error_code& ec,::boost::asio::ip::tcp::resolver::iterator results){
       LOGGER_LAYER;
-      if (ec){
-        if (e) e(ec);
+      ticket=0;
+      if (cancelled){
+        if (e) e(::boost::asio::error::operation_aborted);
         onError();
-      } else {
-        LOGGER_INFO<<__LOGGER__<<"Resolving timer "<<q.host_name()<<":"<<q.service_name()<<" has expired ..."<<std::endl;
-        r.cancel();
-        if (e) e(ec);
-      }
-    }
-  );
-  r.async_resolve(
-    q,
-    [this,self](const ::boost::system::error_code& ec,::boost::asio::ip::tcp::resolver::iterator endpoint_iterator){
-      LOGGER_LAYER;
-      if (ec){
+      } else if (ec){
+        LOGGER_INFO<<__LOGGER__<<"Resolving "<<host<<":"<<port<<" has failed ..."<<std::endl;
         if (e) e(ec);
         onError();
       } else {
-        d.cancel();
-        ei=endpoint_iterator;
-        LOGGER_DEBUG<<__LOGGER__<<"Resolving "<<q.host_name()<<":"<<q.service_name()<<" has succeeded ..."<<std::endl;
+        ei=results;
+        LOGGER_DEBUG<<__LOGGER__<<"Resolving "<<host<<":"<<port<<" has succeeded ..."<<std::endl;
         afterResolve();
       }
     }
   );
 }
 void Tcp::cancelResolve(){
-  r.cancel();
+  cancelled=true;
+  if (ticket) Cache::get().cancel(host,port,ticket);//Handler jest od razu wywoływany z operation_aborted.
+  ticket=0;
 }
 //============================================
 Stream::Stream(const std::string & path):ep(path){
@@ -176,5 +322,94 @@ REGISTER_TEST(resolver,tc2){
   if (err) return(-1);
   return(0);
 }
+REGISTER_TEST(resolver,tc3){
+  ::boost::asio::io_service io;
+  ict::boost::resolver::Cache cache;
+  std::size_t ok(0),failed(0);
+  std::vector<std::string> found;
+  ict::boost::resolver::cache_handler_t handler([&](const ::boost::system::error_code & ec,::boost::asio::ip::tcp::resolver::iterator results){
+    if (ec){
+      failed++;
+      return;
+    }
+    ok++;
+    std::ostringstream out;
+    if (results!=::boost::asio::ip::tcp::resolver::iterator()) out<<results->endpoint();
+    found.push_back(out.str());
+  });
+  //Wyniki przychodzą z wątku zapytań - io jest obsługiwany, aż handler zostanie wywołany count razy.
+  auto run=[&](std::size_t count){
+    for (std::size_t k=0;(k<5000)&&((ok+failed)<count);k++){
+      io.reset();
+      io.poll();
+      if ((ok+failed)<count) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  };
+  //Czeka na zakończenie zapytań w toku (clear() nie usuwa wpisów, na które trwa zapytanie).
+  auto settle=[&](){
+    cache.clear();
+    for (std::size_t k=0;(k<5000)&&cache.size();k++){
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      cache.clear();
+    }
+  };
+  cache.setTtl(60,60,0);
+  //Równoczesne zapytania o tę samą nazwę - jedno zapytanie.
+  cache.resolve("localhost","80",io,handler);
+  cache.resolve("localhost","80",io,handler);
+  run(2);
+  if ((ok!=2)||(cache.queries()!=1)||(found.at(0)!=found.at(1))||found.at(0).empty()) return(-1);
+  //Wynik z pamięci podręcznej.
+  cache.resolve("localhost","80",io,handler);
+  run(3);
+  if ((ok!=3)||(cache.queries()!=1)||(found.at(2)!=found.at(0))) return(-1);
+  //Błąd jest pamiętany (negative_ttl).
+  cache.resolve("localhost","no-such-service-ict",io,handler);
+  run(4);
+  cache.resolve("localhost","no-such-service-ict",io,handler);
+  run(5);
+  if ((failed!=2)||(cache.queries()!=2)||(cache.size()!=2)) return(-1);
+  //Odświeżanie w tle - wynik jest zwracany od razu, a zapytanie idzie w tle.
+  cache.setTtl(60,60,60);
+  if (cache.resolve("localhost","80",io,handler)) return(-1);
+  run(6);
+  if ((ok!=4)||(cache.queries()!=3)) return(-1);
+  //Wynik nieważny (ttl=0) - każde użycie wysyła zapytanie.
+  cache.setTtl(0,0,0);
+  settle();
+  cache.resolve("localhost","80",io,handler);
+  run(7);
+  cache.resolve("localhost","80",io,handler);
+  run(8);
+  if ((ok!=6)||(cache.queries()!=5)) return(-1);
+  //Zapytanie nie zależy od io_service pierwszego oczekującego (tu zatrzymanego).
+  cache.setTtl(60,60,0);
+  {
+    ::boost::asio::io_service stopped;
+    std::size_t before(ok);
+    stopped.stop();
+    cache.resolve("localhost","81",stopped,handler);
+    cache.resolve("localhost","81",io,handler);//Czeka na to samo zapytanie albo dostaje jego wynik z pamięci podręcznej.
+    run(ok+failed+1);
+    if ((ok!=(before+1))||(cache.queries()!=6)) return(-1);
+    settle();
+  }
+  //Anulowane oczekiwanie - handler jest od razu wywoływany z operation_aborted.
+  {
+    ::boost::system::error_code result;
+    std::size_t id(cache.resolve("localhost","82",io,[&](const ::boost::system::error_code & ec,::boost::asio::ip::tcp::resolver::iterator){result=ec;}));
+    bool cancelled(cache.cancel("localhost","82",id));
+    for (std::size_t k=0;(k<5000)&&cancelled&&(!result);k++){
+      io.reset();
+      io.poll();
+      if (!result) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (cancelled&&(result!=::boost::asio::error::operation_aborted)) return(-1);
+    if (cache.cancel("localhost","82",id)) return(-1);
+  }
+  settle();
+  if (cache.size()) return(-1);
+  return(0);
+}
 #endif
 //===========================================
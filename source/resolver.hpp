@@ -39,11 +39,113 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <functional>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <thread>
 #include "../libict/source/register.hpp"
 //============================================
 namespace ict { namespace boost { namespace resolver {
 //===========================================
 typedef std::function<void(const ::boost::system::error_code&)> error_handler_t;
+//! Obsługa wyniku zapytania z pamięci podręcznej (wynik jak z async_resolve()).
+typedef std::function<void(const ::boost::system::error_code & ec,::boost::asio::ip::tcp::resolver::iterator results)> cache_handler_t;
+//===========================================
+//!
+//! @brief Pamięć podręczna zapytań DNS wspólna dla procesu (kluczem jest para host i port).
+//!  Równoczesne zapytania o tę samą nazwę czekają na jedno zapytanie, błędy są pamiętane krótko (negative_ttl),
+//!  a wpis używany w ostatnich prefetch sekundach ważności jest odświeżany w tle (do tego czasu jest zwracany stary wynik).
+//!  Zapytania są wykonywane we własnym wątku pamięci podręcznej (nie zależą od io_service wywołującego),
+//!  a wynik jest zawsze przekazywany przez io_service podany w resolve().
+//!
+class Cache {
+private:
+  typedef std::pair<std::string,std::string> key_t;
+  typedef std::chrono::steady_clock clock_t;
+  //! Oczekujący na wynik zapytania.
+  struct waiter_t {
+    //! Identyfikator (do cancel()).
+    std::size_t id;
+    //! io_service, w którym jest wywoływany handler.
+    ::boost::asio::io_service * io;
+    cache_handler_t handler;
+    //! Podtrzymuje działanie io (jak oczekująca operacja asynchroniczna), dopóki handler nie zostanie przekazany.
+    std::shared_ptr<::boost::asio::io_service::work> work;
+  };
+  //! Wpis pamięci podręcznej.
+  struct entry_t {
+    //! Czy wpis ma wynik (results lub error).
+    bool valid=false;
+    //! Wynik zapytania (kopie iteratora współdzielą listę adresów).
+    ::boost::asio::ip::tcp::resolver::iterator results;
+    //! Błąd zapytania.
+    ::boost::system::error_code error;
+    //! Koniec ważności wyniku.
+    clock_t::time_point expires;
+    //! Czy zapytanie jest w toku.
+    bool pending=false;
+    //! Oczekujący na wynik zapytania.
+    std::vector<waiter_t> waiting;
+  };
+  //! Blokada dla wpisów.
+  std::mutex mutex;
+  //! Wpisy.
+  std::map<key_t,entry_t> entries;
+  //! Czas ważności wyniku (w sekundach) - getaddrinfo() nie zwraca TTL rekordów DNS.
+  std::size_t ttl=60;
+  //! Czas ważności błędu (w sekundach).
+  std::size_t negative_ttl=5;
+  //! Okres przed końcem ważności (w sekundach), w którym użycie wpisu powoduje jego odświeżenie w tle.
+  std::size_t prefetch=10;
+  //! Liczba wysłanych zapytań.
+  std::size_t sent=0;
+  //! Ostatni identyfikator oczekującego.
+  std::size_t last_id=0;
+  //! io_service zapytań.
+  ::boost::asio::io_service service;
+  //! Podtrzymuje działanie io_service zapytań.
+  std::unique_ptr<::boost::asio::io_service::work> work;
+  //! Wątek zapytań (uruchamiany przy pierwszym zapytaniu).
+  std::thread thread;
+  //! Liczba wpisów, powyżej której przy kolejnym zapytaniu są usuwane wpisy nieważne.
+  enum {max_entries=4096};
+  //! Limit czasu zapytania (w sekundach).
+  enum {timeout=60};
+  //! Wysyła zapytanie (w wątku zapytań).
+  void query(const key_t & key);
+  //! Rozpoczyna zapytanie (w wątku zapytań).
+  void query_start(const key_t & key);
+  //! Zapisuje wynik zapytania i przekazuje go oczekującym.
+  void complete(const key_t & key,const ::boost::system::error_code & ec,::boost::asio::ip::tcp::resolver::iterator results);
+public:
+  Cache(){}
+  //! Destruktor (zatrzymuje wątek zapytań).
+  ~Cache();
+  //! Zwraca pamięć podręczną procesu.
+  static Cache & get();
+  //!
+  //! Rozwiązuje nazwę (z pamięci podręcznej lub przez zapytanie).
+  //!
+  //! @param host Host.
+  //! @param port Port (lub nazwa usługi).
+  //! @param io io_service, w którym jest wywoływany handler (musi istnieć do wywołania handlera albo do cancel()).
+  //! @param handler Obsługa wyniku.
+  //! @return Identyfikator oczekującego na zapytanie (do cancel()) - 0, jeśli wynik jest z pamięci podręcznej.
+  //!
+  std::size_t resolve(const std::string & host,const std::string & port,::boost::asio::io_service & io,cache_handler_t handler);
+  //! Anuluje oczekiwanie na zapytanie - handler jest od razu wywoływany z błędem operation_aborted (false, jeśli już nie czeka).
+  bool cancel(const std::string & host,const std::string & port,std::size_t id);
+  //! Ustawia czasy ważności wyników (w sekundach).
+  void setTtl(std::size_t ttlIn,std::size_t negativeTtl,std::size_t prefetchIn);
+  //! Usuwa wpisy (poza tymi, na które trwa zapytanie).
+  void clear();
+  //! Zwraca liczbę wpisów.
+  std::size_t size();
+  //! Zwraca liczbę wysłanych zapytań.
+  std::size_t queries();
+};
 //===========================================
 //! Klasa podstawowa.
 class Base : public ict::reg::Base {
@@ -76,17 +178,25 @@ protected:
 //! Klasa do obsługi TCP.
 class Tcp : public std::enable_shared_from_this<Tcp>, public Base {
 private:
-  //! Asynchroniczne rozwiązywanie nazw DNS.
-  ::boost::asio::ip::tcp::resolver r;
-  //! Zapytanie  DNS.
-  ::boost::asio::ip::tcp::resolver::query q;
-  //! Timer dla zapytania DNS.
-  ::boost::asio::deadline_timer d;
+  //! io_service, w którym jest obsługiwany wynik zapytania DNS.
+  ::boost::asio::io_service & io;
+  //! Host.
+  std::string host;
+  //! Port.
+  std::string port;
+  //! Czy rozwiązywanie nazw zostało anulowane.
+  bool cancelled=false;
+  //! Identyfikator oczekiwania na zapytanie w pamięci podręcznej (0 - nie czeka).
+  std::size_t ticket=0;
 public:
   //! Konstruktor.
   Tcp(const std::string & host,const std::string & port);
   //! Konstruktor z dodatkową (zewnętrzną) obsługą błędów.
   Tcp(const std::string & host,const std::string & port,error_handler_t onError);
+  //! Konstruktor (rozwiązywanie nazw w podanym io_service).
+  Tcp(const std::string & host,const std::string & port,::boost::asio::io_service & io);
+  //! Konstruktor z dodatkową (zewnętrzną) obsługą błędów (rozwiązywanie nazw w podanym io_service).
+  Tcp(const std::string & host,const std::string & port,error_handler_t onError,::boost::asio::io_service & io);
   //! Destruktor.
   virtual ~Tcp();
 private:
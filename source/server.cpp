@@ -39,9 +39,15 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "../libict/source/logger.hpp"
 #include "../libict/source/options.hpp"
 #include "../libict/source/register.hpp"
+#ifdef __linux__
+#include <linux/filter.h>
+#endif
 //============================================
 #ifdef ENABLE_TESTING
 #include "test.hpp"
+#include <thread>
+#include <chrono>
+#include <mutex>
 #endif
 //============================================
 #define REGISTER_SERVER_TCP ict::reg::get<Tcp>()
@@ -59,27 +65,53 @@ Tcp::Tcp(const std::string & host,const std::string & port,ict::boost::connectio
   LOGGER_INFO<<__LOGGER__<<"smpp::server::Tcp has been created ..."<<std::endl;
   REGISTER_SERVER_TCP.add(this,"smpp::server::Tcp "+host+":"+port);
 }
+Tcp::Tcp(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,resolver::error_handler_t onError,::boost::asio::io_service & io,ict::boost::asio::Pool * pool,accept_mode_t mode)
+  :resolver::Tcp(host,port,onError,io),s(io),a(io),f(factory),p(pool),m(mode){
+  LOGGER_INFO<<__LOGGER__<<"smpp::server::Tcp has been created ..."<<std::endl;
+  REGISTER_SERVER_TCP.add(this,"smpp::server::Tcp "+host+":"+port);
+}
+Tcp::Tcp(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,ict::boost::asio::Pool & pool,accept_mode_t mode)
+  :Tcp(host,port,factory,resolver::error_handler_t(),(mode==accept_least_loaded)?pool.get(0):pool.next(),&pool,mode){
+}
+Tcp::Tcp(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,resolver::error_handler_t onError,ict::boost::asio::Pool & pool,accept_mode_t mode)
+  :Tcp(host,port,factory,onError,(mode==accept_least_loaded)?pool.get(0):pool.next(),&pool,mode){
+}
 Tcp::~Tcp(){
+  ::boost::asio::ip::tcp::socket * socket;
+  for (std::unique_ptr<worker_t> & worker : workers) while (worker->queue.pop(socket)) delete socket;
   LOGGER_INFO<<__LOGGER__<<"smpp::server::Tcp has been destroyed ..."<<std::endl;
   REGISTER_SERVER_TCP.del(this);
 }
 void Tcp::doStop(){
   auto self(enable_shared_t::shared_from_this());
-  if (stopped) return;
-  stopped=true;
+  if (stopped.exchange(true)) return;
   s.close();
   a.close();
+  for (std::size_t k=0;k<shards.size();k++){
+    ict::boost::asio::ioServiceOf(*shards.at(k).a).post([this,self,k](){
+      LOGGER_LAYER;
+      shards.at(k).a->close();
+      shards.at(k).s->close();
+    });
+  }
 }
 void Tcp::afterResolve(){
   auto self(enable_shared_t::shared_from_this());
   if (any){
-    doBind(ep);
+    if (!doBind(ep)) doBind();
   } else {
     doBind();
   }
 }
 bool Tcp::doBind(const ::boost::asio::ip::tcp::endpoint & ep){
   if (stopped) return(false);
+  if (p) switch(m){
+    case accept_sharded:
+    case accept_sharded_cpu:
+    case accept_sharded_bpf:
+      return(doBindSharded(ep));
+    default:break;
+  }
   {
     a.close();
     LOGGER_DEBUG<<__LOGGER__<<"Trying to bind "<<ep<<" ..."<<std::endl;
@@ -88,19 +120,16 @@ bool Tcp::doBind(const ::boost::asio::ip::tcp::endpoint & ep){
       a.open(ep.protocol(),ec);
       if (ec) {
         LOGGER_INFO<<__LOGGER__<<"Bind to "<<ep<<" has failed ..."<<std::endl;
-        doBind();
         return(false);
       } else {
         a.bind(ep,ec);
         if (ec) {
           LOGGER_INFO<<__LOGGER__<<"Bind to "<<ep<<" has failed ..."<<std::endl;
-          doBind();
           return(false);
         } else {
           a.listen(::boost::asio::socket_base::max_connections,ec);
           if (ec) {
             LOGGER_INFO<<__LOGGER__<<"Bind to "<<ep<<" has failed ..."<<std::endl;
-            doBind();
             return(false);
           } else {
             LOGGER_DEBUG<<__LOGGER__<<"Bind to "<<ep<<" has succeeded ..."<<std::endl;
@@ -115,13 +144,10 @@ bool Tcp::doBind(const ::boost::asio::ip::tcp::endpoint & ep){
 bool Tcp::doBind(){
   auto self(enable_shared_t::shared_from_this());
   if (stopped) return(false);
-  if (ei!=::boost::asio::ip::tcp::resolver::iterator()){
-    if (doBind(ei->endpoint())){
-      return(true);
-    } else {
-      ++ei;
-    }
-  } else {
+  for (;ei!=::boost::asio::ip::tcp::resolver::iterator();++ei){
+    if (doBind(ei->endpoint())) return(true);
+  }
+  {
     ::boost::system::error_code ec;
     LOGGER_NOTICE<<__LOGGER__<<"Bind has finally failed ..."<<std::endl;
     doStop();
@@ -129,9 +155,70 @@ bool Tcp::doBind(){
   }
   return(false);
 }
+bool Tcp::doBindSharded(const ::boost::asio::ip::tcp::endpoint & ep){
+  typedef ::boost::asio::detail::socket_option::boolean<SOL_SOCKET,SO_REUSEPORT> reuse_port_t;
+  shards.clear();
+  LOGGER_DEBUG<<__LOGGER__<<"Trying to bind "<<ep<<" (shards: "<<p->size()<<") ..."<<std::endl;
+  for (std::size_t k=0;k<p->size();k++){
+    ::boost::system::error_code ec;
+    shard_t shard;
+    shard.a.reset(new ::boost::asio::ip::tcp::acceptor(p->get(k)));
+    shard.s.reset(new ::boost::asio::ip::tcp::socket(p->get(k)));
+    shard.a->open(ep.protocol(),ec);
+    if (!ec) shard.a->set_option(::boost::asio::ip::tcp::acceptor::reuse_address(true),ec);
+    if (!ec) shard.a->set_option(reuse_port_t(true),ec);
+#ifdef SO_INCOMING_CPU
+    if ((!ec)&&(m==accept_sharded_cpu)){
+      typedef ::boost::asio::detail::socket_option::integer<SOL_SOCKET,SO_INCOMING_CPU> incoming_cpu_t;
+      shard.a->set_option(incoming_cpu_t(p->cpu(k)),ec);
+    }
+#endif
+    if (!ec) shard.a->bind(ep,ec);
+    if (!ec) shard.a->listen(::boost::asio::socket_base::max_connections,ec);
+    if (ec) {
+      LOGGER_INFO<<__LOGGER__<<"Bind to "<<ep<<" (shard "<<k<<") has failed: "<<ec<<" ..."<<std::endl;
+      shards.clear();
+      return(false);
+    }
+    shards.push_back(std::move(shard));
+  }
+  if ((m==accept_sharded_bpf)&&(!attachCpuFilter(shards.front().a->native_handle(),shards.size()))){
+    LOGGER_WARN<<__LOGGER__<<"Reuseport BPF program is not attached to "<<ep<<" - connections are distributed by the kernel hash ..."<<std::endl;
+  }
+  LOGGER_DEBUG<<__LOGGER__<<"Bind to "<<ep<<" has succeeded ..."<<std::endl;
+  for (std::size_t k=0;k<shards.size();k++) doAcceptShard(k);
+  return(true);
+}
+bool Tcp::attachCpuFilter(int fd,std::size_t count){
+#if defined(__linux__)&&defined(SO_ATTACH_REUSEPORT_CBPF)
+  //Numer akceptora w grupie SO_REUSEPORT = numer CPU modulo liczba akceptorów.
+  struct sock_filter code[]={
+    {BPF_LD|BPF_W|BPF_ABS,0,0,(__u32)(SKF_AD_OFF+SKF_AD_CPU)},
+    {BPF_ALU|BPF_MOD|BPF_K,0,0,(__u32)count},
+    {BPF_RET|BPF_A,0,0,0}
+  };
+  struct sock_fprog prog={(unsigned short)(sizeof(code)/sizeof(code[0])),code};
+  if (::setsockopt(fd,SOL_SOCKET,SO_ATTACH_REUSEPORT_CBPF,&prog,sizeof(prog))){
+    LOGGER_WARN<<__LOGGER__<<"Unable to attach reuseport BPF program (errno="<<errno<<") ..."<<std::endl;
+    return(false);
+  }
+  return(true);
+#else
+  LOGGER_WARN<<__LOGGER__<<"Reuseport BPF program is not supported ..."<<std::endl;
+  return(false);
+#endif
+}
 void Tcp::doAccept(){
   auto self(enable_shared_t::shared_from_this());
   if (stopped) return;
+  if (p) {
+    if (m==accept_least_loaded){
+      doAcceptLeastLoaded();
+    } else {
+      doAcceptPool();
+    }
+    return;
+  }
   a.async_accept(
     s,
     [this,self](::boost::system::error_code ec){
@@ -154,6 +241,128 @@ void Tcp::doAccept(){
     }
   );
 }
+void Tcp::doAcceptPool(){
+  auto self(enable_shared_t::shared_from_this());
+  auto socket(std::make_shared<::boost::asio::ip::tcp::socket>(p->next()));
+  a.async_accept(
+    *socket,
+    [this,self,socket](::boost::system::error_code ec){
+      LOGGER_LAYER;
+      if (ec){
+        LOGGER_INFO<<__LOGGER__<<"Unable to accept a new connection ("<<ec<<") ..."<<std::endl;
+        errors++;
+      } else {
+        LOGGER_INFO<<__LOGGER__<<"A new connection has been accepted ..."<<std::endl;
+        if (f) {
+          ict::boost::connection::factory_tcp_t factory(f);
+          ict::boost::asio::ioServiceOf(*socket).post([factory,socket](){
+            LOGGER_LAYER;
+            factory(*socket);
+          });
+          errors=0;
+        } else {
+          socket->close();
+          LOGGER_ERR<<__LOGGER__<<"Factory is empty ..."<<std::endl;
+          errors++;
+        }
+      }
+      if (errors<10) {doAccept();} else {doStop();}
+    }
+  );
+}
+void Tcp::doAcceptLeastLoaded(){
+  auto self(enable_shared_t::shared_from_this());
+  if (workers.size()!=p->size()){
+    workers.clear();
+    for (std::size_t k=0;k<p->size();k++) workers.emplace_back(new worker_t(queue_size));
+  }
+  //Gniazdo jest akceptowane w wątku akceptora, a wątek jest wybierany dopiero po akceptacji (według bieżącego obciążenia).
+  a.async_accept(
+    s,
+    [this,self](::boost::system::error_code ec){
+      LOGGER_LAYER;
+      if (ec){
+        LOGGER_INFO<<__LOGGER__<<"Unable to accept a new connection ("<<ec<<") ..."<<std::endl;
+        errors++;
+      } else if (f) {
+        //Wątek 0 jest wątkiem akceptora - połączenia trafiają do niego tylko, gdy pula ma jeden wątek.
+        std::size_t index(p->leastLoaded((p->size()>1)?1:0));
+        std::unique_ptr<::boost::asio::ip::tcp::socket> socket(new ::boost::asio::ip::tcp::socket(p->get(index)));
+        LOGGER_INFO<<__LOGGER__<<"A new connection has been accepted (thread "<<index<<") ..."<<std::endl;
+        ict::boost::asio::moveSocket(s,*socket);
+        p->pending(index)++;
+        doDispatch(index,socket);
+        errors=0;
+      } else {
+        s.close();
+        LOGGER_ERR<<__LOGGER__<<"Factory is empty ..."<<std::endl;
+        errors++;
+      }
+      if (errors<10) {doAccept();} else {doStop();}
+    }
+  );
+}
+void Tcp::doDispatch(std::size_t index,std::unique_ptr<::boost::asio::ip::tcp::socket> & socket){
+  auto self(enable_shared_t::shared_from_this());
+  worker_t & worker(*workers.at(index));
+  if (!worker.queue.push(socket.get())){
+    //Kolejka pełna - przekazanie przez io_service.
+    std::shared_ptr<::boost::asio::ip::tcp::socket> ptr(socket.release());
+    ict::boost::connection::factory_tcp_t factory(f);
+    ict::boost::asio::Pool * pool(p);
+    p->get(index).post([factory,ptr,pool,index](){
+      LOGGER_LAYER;
+      pool->pending(index)--;
+      factory(*ptr);
+    });
+    return;
+  }
+  socket.release();
+  if (worker.scheduled.exchange(true)) return;
+  p->get(index).post([this,self,index](){
+    LOGGER_LAYER;
+    worker_t & worker(*workers.at(index));
+    ::boost::asio::ip::tcp::socket * ptr;
+    worker.scheduled=false;
+    while (worker.queue.pop(ptr)){
+      std::unique_ptr<::boost::asio::ip::tcp::socket> socket(ptr);
+      p->pending(index)--;
+      if (stopped) continue;
+      try {
+        f(*socket);
+      } catch (std::exception & e) {
+        LOGGER_ERR<<__LOGGER__<<"Exception: "<<e.what()<<std::endl;
+      }
+    }
+  });
+}
+void Tcp::doAcceptShard(std::size_t index){
+  auto self(enable_shared_t::shared_from_this());
+  if (stopped) return;
+  shard_t & shard(shards.at(index));
+  shard.a->async_accept(
+    *shard.s,
+    [this,self,index](::boost::system::error_code ec){
+      LOGGER_LAYER;
+      shard_t & shard(shards.at(index));
+      if (ec){
+        LOGGER_INFO<<__LOGGER__<<"Unable to accept a new connection ("<<ec<<", shard "<<index<<") ..."<<std::endl;
+        shard.errors++;
+      } else {
+        LOGGER_INFO<<__LOGGER__<<"A new connection has been accepted (shard "<<index<<") ..."<<std::endl;
+        if (f) {
+          f(*shard.s);
+          shard.errors=0;
+        } else {
+          shard.s->close();
+          LOGGER_ERR<<__LOGGER__<<"Factory is empty ..."<<std::endl;
+          shard.errors++;
+        }
+      }
+      if (shard.errors<10) {doAcceptShard(index);} else {doStop();}
+    }
+  );
+}
 void factory(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory){
   auto ptr=std::make_shared<Tcp>(host,port,factory);
   if (ptr) ptr->init();
@@ -162,6 +371,14 @@ void factory(const std::string & host,const std::string & port,ict::boost::conne
   auto ptr=std::make_shared<Tcp>(host,port,factory,onError);
   if (ptr) ptr->init();
 }
+void factory(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,ict::boost::asio::Pool & pool,accept_mode_t mode){
+  auto ptr=std::make_shared<Tcp>(host,port,factory,pool,mode);
+  if (ptr) ptr->init();
+}
+void factory(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,resolver::error_handler_t onError,ict::boost::asio::Pool & pool,accept_mode_t mode){
+  auto ptr=std::make_shared<Tcp>(host,port,factory,onError,pool,mode);
+  if (ptr) ptr->init();
+}
 //============================================
 Stream::Stream(const std::string & path,ict::boost::connection::factory_stream_t factory)
   :resolver::Stream(path),s(ict::boost::asio::ioService()),a(ict::boost::asio::ioService()),f(factory){
@@ -263,8 +480,129 @@ void factory(const std::string & path,ict::boost::connection::factory_stream_t f
 }}}
 //============================================
 #ifdef ENABLE_TESTING
-//REGISTER_TEST(server,tc1){
-//  return(0);
-//}
+//! Nawiązuje podaną liczbę połączeń z serwerem testowym (ponawia, dopóki serwer nie nasłuchuje).
+static bool test_connect(const std::string & port,std::size_t count,::boost::asio::io_service & io,std::vector<std::unique_ptr<::boost::asio::ip::tcp::socket>> & sockets){
+  ::boost::asio::ip::tcp::endpoint ep(::boost::asio::ip::address::from_string("127.0.0.1"),(unsigned short)std::stoul(port));
+  for (std::size_t k=0;k<count;k++){
+    std::unique_ptr<::boost::asio::ip::tcp::socket> socket(new ::boost::asio::ip::tcp::socket(io));
+    ::boost::system::error_code ec;
+    for (std::size_t t=0;t<5000;t++){
+      socket->close(ec);
+      socket->connect(ep,ec);
+      if (!ec) break;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (ec) return(false);
+    sockets.push_back(std::move(socket));
+  }
+  return(true);
+}
+//! Czeka (do 5 sekund), aż warunek zostanie spełniony.
+static bool test_wait(std::function<bool()> condition){
+  for (std::size_t k=0;k<5000;k++){
+    if (condition()) return(true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return(condition());
+}
+//! Zatrzymuje serwer testowy w wątku akceptora i czeka, aż nie będzie używany.
+static bool test_stop(std::shared_ptr<ict::boost::server::Tcp> & server,::boost::asio::io_service & io){
+  std::shared_ptr<ict::boost::server::Tcp> ptr(server);
+  io.post([ptr](){ptr->doStop();});
+  ptr.reset();
+  return(test_wait([&](){return(server.use_count()==1);}));
+}
+REGISTER_TEST(server,tc1){//accept_least_loaded
+  typedef ict::boost::server::Tcp tcp_t;
+  ict::boost::asio::Pool pool(3);
+  ::boost::asio::io_service io;
+  std::mutex m;
+  std::vector<std::size_t> threads(pool.size(),0);
+  std::vector<std::unique_ptr<::boost::asio::ip::tcp::socket>> accepted;
+  std::vector<std::unique_ptr<::boost::asio::ip::tcp::socket>> sockets;
+  std::atomic<bool> blocked(true);
+  std::shared_ptr<tcp_t> server;
+  int out=0;
+  pool.start();
+  //Wątki 1 i 2 są zajęte - połączenia czekają w kolejkach (pojemność 2), a nadmiar jest przekazywany przez io_service.
+  for (std::size_t k=1;k<pool.size();k++) pool.get(k).post([&](){
+    while (blocked) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  });
+  server=std::make_shared<tcp_t>("127.0.0.1","4581",[&](::boost::asio::ip::tcp::socket & socket){
+    std::lock_guard<std::mutex> lock(m);
+    if (ict::boost::asio::Pool::current()==&pool) threads.at(ict::boost::asio::Pool::currentIndex())++;
+    accepted.emplace_back(new ::boost::asio::ip::tcp::socket(std::move(socket)));
+  },pool,ict::boost::server::accept_least_loaded);
+  server->setQueueSize(2);
+  server->init();
+  if (!test_connect("4581",6,io,sockets)) out=-1;
+  //Wątek jest wybierany po akceptacji (według połączeń przekazanych, ale jeszcze nie utworzonych) - rozkład po równo.
+  if (!test_wait([&](){return((pool.pending(1)+pool.pending(2))==6);})) out=-1;
+  if ((pool.pending(1)!=3)||(pool.pending(2)!=3)) out=-1;
+  blocked=false;
+  //Wszystkie połączenia docierają do fabryki - z kolejek i (po ich wypełnieniu) przez io_service.
+  if (!test_wait([&](){std::lock_guard<std::mutex> lock(m);return(accepted.size()==6);})) out=-1;
+  if ((threads.at(0)!=0)||(threads.at(1)!=3)||(threads.at(2)!=3)||pool.pending(1)||pool.pending(2)) out=-1;
+  if (!test_stop(server,pool.get(0))) out=-1;
+  sockets.clear();
+  {
+    std::lock_guard<std::mutex> lock(m);
+    accepted.clear();
+  }
+  return(out);
+}
+//! Serwer testowy, w którym dołączenie programu BPF zawsze się nie udaje.
+class TestBpfFailTcp : public ict::boost::server::Tcp {
+private:
+  bool attachCpuFilter(int,std::size_t){
+    attached=true;
+    return(false);
+  }
+public:
+  bool attached=false;
+  using Tcp::Tcp;
+};
+REGISTER_TEST(server,tc2){//accept_sharded*
+  static const std::size_t count=6;
+  ict::boost::asio::Pool pool(3);
+  ::boost::asio::io_service io;
+  int out=0;
+  pool.start();
+  for (std::size_t k=0;k<4;k++){
+    std::string port(std::to_string(4582+k));
+    std::mutex m;
+    std::size_t calls(0),ok(0);
+    std::vector<std::unique_ptr<::boost::asio::ip::tcp::socket>> accepted;
+    std::vector<std::unique_ptr<::boost::asio::ip::tcp::socket>> sockets;
+    std::shared_ptr<TestBpfFailTcp> failing;
+    std::shared_ptr<ict::boost::server::Tcp> server;
+    //Fabryka jest wykonywana w wątku puli, a gniazdo działa w io_service tego wątku.
+    ict::boost::connection::factory_tcp_t factory([&](::boost::asio::ip::tcp::socket & socket){
+      std::lock_guard<std::mutex> lock(m);
+      calls++;
+      if ((ict::boost::asio::Pool::current()==&pool)&&(&ict::boost::asio::ioServiceOf(socket)==&pool.get(ict::boost::asio::Pool::currentIndex()))) ok++;
+      accepted.emplace_back(new ::boost::asio::ip::tcp::socket(std::move(socket)));
+    });
+    switch (k){
+      case 0:server=std::make_shared<ict::boost::server::Tcp>("127.0.0.1",port,factory,pool,ict::boost::server::accept_sharded);break;
+      case 1:server=std::make_shared<ict::boost::server::Tcp>("127.0.0.1",port,factory,pool,ict::boost::server::accept_sharded_cpu);break;
+      case 2:server=std::make_shared<ict::boost::server::Tcp>("127.0.0.1",port,factory,pool,ict::boost::server::accept_sharded_bpf);break;
+      default://Nieudane dołączenie programu BPF - połączenia rozdziela jądro.
+        failing=std::make_shared<TestBpfFailTcp>("127.0.0.1",port,factory,pool,ict::boost::server::accept_sharded_bpf);
+        server=failing;
+        break;
+    }
+    server->init();
+    if (!test_connect(port,count,io,sockets)) out=-1;
+    if (!test_wait([&](){std::lock_guard<std::mutex> lock(m);return(calls==count);})) out=-1;
+    if ((ok!=count)||(failing&&(!failing->attached))) out=-1;
+    failing.reset();
+    if (!test_stop(server,pool.get(0))) out=-1;
+    sockets.clear();
+    std::lock_guard<std::mutex> lock(m);
+    accepted.clear();
+  }
+  return(out);
+}
 #endif
 //===========================================
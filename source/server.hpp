@@ -38,16 +38,48 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //============================================
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+#include "asio.hpp"
 #include "resolver.hpp"
 #include "connection.hpp"
 //============================================
 namespace ict { namespace boost { namespace server {
 //===========================================
+//! Sposób akceptacji połączeń przez serwer działający w puli wątków.
+enum accept_mode_t {
+  //! Jeden akceptor, połączenia są rozdzielane kolejno (round robin) pomiędzy wątki puli.
+  accept_round_robin,
+  //! Akceptor SO_REUSEPORT w każdym wątku puli, połączenia rozdziela jądro (hash).
+  accept_sharded,
+  //! Jak accept_sharded, ale akceptor wątku k ma ustawione SO_INCOMING_CPU=k (wymaga puli z przypisanymi CPU).
+  accept_sharded_cpu,
+  //! Jak accept_sharded, ale połączenia są kierowane do akceptora wątku działającego na CPU, który odebrał pakiet (program BPF, wymaga puli z przypisanymi CPU).
+  accept_sharded_bpf,
+  //! Akceptor w wątku 0 puli, połączenia są przekazywane (kolejką bez blokad) do najmniej obciążonego z pozostałych wątków.
+  accept_least_loaded
+};
 //! Klasa tworząca serwer do obsługi połączeń TCP.
 class Tcp : public resolver::Tcp {
 private:
+  //! Akceptor wątku puli (tryby accept_sharded*).
+  struct shard_t {
+    //! Akceptor do obsługi połączeń przychodzących.
+    std::unique_ptr<::boost::asio::ip::tcp::acceptor> a;
+    //! Gniazdo do obsługi połączenia.
+    std::unique_ptr<::boost::asio::ip::tcp::socket> s;
+    //! Liczba błędnych połązeń przychodzących.
+    uint8_t errors=0;
+  };
+  //! Kolejka połączeń przekazywanych do wątku puli (tryb accept_least_loaded).
+  struct worker_t {
+    //! Kolejka zaakceptowanych gniazd (jeden producent - akceptor, jeden konsument - wątek puli).
+    ::boost::lockfree::spsc_queue<::boost::asio::ip::tcp::socket*> queue;
+    //! Czy obsługa kolejki została już zlecona wątkowi puli.
+    std::atomic<bool> scheduled{false};
+    explicit worker_t(std::size_t capacity):queue(capacity){}
+  };
   //! Czy serwer jest zatrzymany.
-  bool stopped=false;
+  std::atomic<bool> stopped{false};
   //! Liczba błędnych połązeń przychodzących.
   uint8_t errors=0;
   //! Gniazdo do obsługi połączenia.
@@ -56,10 +88,27 @@ private:
   ::boost::asio::ip::tcp::acceptor a;
   //! Fabryka połączeń.
   ict::boost::connection::factory_tcp_t f;
+  //! Pula wątków, w której działają połączenia (jeśli nullptr, to połączenia działają w wątku akceptora).
+  ict::boost::asio::Pool * p=nullptr;
+  //! Sposób akceptacji połączeń (gdy jest pula wątków).
+  accept_mode_t m=accept_round_robin;
+  //! Akceptory wątków puli (tryby accept_sharded*).
+  std::vector<shard_t> shards;
+  //! Kolejki połączeń wątków puli (tryb accept_least_loaded).
+  std::vector<std::unique_ptr<worker_t>> workers;
+  //! Pojemność kolejki połączeń wątku puli - po jej wypełnieniu połączenia są przekazywane przez io_service (tryb accept_least_loaded).
+  std::size_t queue_size=1024;
+  Tcp(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,resolver::error_handler_t onError,::boost::asio::io_service & io,ict::boost::asio::Pool * pool,accept_mode_t mode);
 public:
   Tcp(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory);
   Tcp(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,resolver::error_handler_t onError);
+  //! Konstruktor - połączenia są rozdzielane pomiędzy wątki puli (fabryka jest wykonywana w wątku połączenia).
+  Tcp(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,ict::boost::asio::Pool & pool,accept_mode_t mode=accept_round_robin);
+  //! Konstruktor - połączenia są rozdzielane pomiędzy wątki puli (fabryka jest wykonywana w wątku połączenia).
+  Tcp(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,resolver::error_handler_t onError,ict::boost::asio::Pool & pool,accept_mode_t mode=accept_round_robin);
   virtual ~Tcp();
+  //! Ustawia pojemność kolejki połączeń wątku puli (tryb accept_least_loaded, wywoływać przed init()).
+  void setQueueSize(std::size_t size){queue_size=size?size:1;}
   void doStop();
   void destroyThis(){doStop();}
 private:
@@ -68,13 +117,35 @@ private:
   //! Przypisuje gniazdo.
   bool doBind(const ::boost::asio::ip::tcp::endpoint & ep);
   bool doBind();
+  //! Przypisuje gniazdo SO_REUSEPORT w każdym wątku puli (tryby accept_sharded*).
+  bool doBindSharded(const ::boost::asio::ip::tcp::endpoint & ep);
+  //!
+  //! Dołącza do grupy SO_REUSEPORT program BPF kierujący połączenie do akceptora CPU, który odebrał pakiet (tryb accept_sharded_bpf).
+  //!
+  //! @param fd Gniazdo akceptora z grupy.
+  //! @param count Liczba akceptorów w grupie.
+  //! @return Informacja, czy program został dołączony (jeśli nie, połączenia rozdziela jądro jak w accept_sharded).
+  //!
+  virtual bool attachCpuFilter(int fd,std::size_t count);
   //! Rozpoczyna akceptację połączeń.
   void doAccept();
+  //! Rozpoczyna akceptację połączeń do wątków puli.
+  void doAcceptPool();
+  //! Rozpoczyna akceptację połączeń w wątku puli o podanym indeksie (tryby accept_sharded*).
+  void doAcceptShard(std::size_t index);
+  //! Rozpoczyna akceptację połączeń przekazywanych do najmniej obciążonego wątku puli (tryb accept_least_loaded).
+  void doAcceptLeastLoaded();
+  //! Przekazuje zaakceptowane gniazdo do wątku puli o podanym indeksie.
+  void doDispatch(std::size_t index,std::unique_ptr<::boost::asio::ip::tcp::socket> & socket);
 };
 //! Fabryka tworząca serwery do obsługi połączeń TCP.
 void factory(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory);
 //! Fabryka tworząca serwery do obsługi połączeń TCP.
 void factory(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,resolver::error_handler_t onError);
+//! Fabryka tworząca serwery do obsługi połączeń TCP (połączenia działają w wątkach puli).
+void factory(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,ict::boost::asio::Pool & pool,accept_mode_t mode=accept_round_robin);
+//! Fabryka tworząca serwery do obsługi połączeń TCP (połączenia działają w wątkach puli).
+void factory(const std::string & host,const std::string & port,ict::boost::connection::factory_tcp_t factory,resolver::error_handler_t onError,ict::boost::asio::Pool & pool,accept_mode_t mode=accept_round_robin);
 //============================================
 //! Klasa tworząca serwer do obsługi połączeń lokalnych gniazd systemowych (Unix).
 class Stream : public resolver::Stream {
@@ -0,0 +1,658 @@
+//! @file
+//! @brief io_uring module - Source file.
+//! @author Mariusz Ornowski (mariusz.ornowski@ict-project.pl)
+//! @version 1.0
+//! @date 2017
+//! @copyright ICT-Project Mariusz Ornowski (ict-project.pl)
+/* **************************************************************
+Copyright (c) 2017, ICT-Project Mariusz Ornowski (ict-project.pl)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+3. Neither the name of the ICT-Project Mariusz Ornowski nor the names
+of its contributors may be used to endorse or promote products
+derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**************************************************************/
+//============================================
+#include "uring.hpp"
+#include "asio.hpp"
+#include "../libict/source/logger.hpp"
+#ifdef ICT_BOOST_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+//============================================
+#ifdef ENABLE_TESTING
+#include "test.hpp"
+#include "connection-uring.hpp"
+#include <thread>
+#include <fstream>
+#include <functional>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+//============================================
+namespace ict { namespace boost { namespace uring {
+//============================================
+//! Liczba wpisów kolejki zgłoszeń.
+static const unsigned ringEntries=256;
+//! Liczba buforów w pierścieniu buforów.
+static const unsigned bufferCount=256;
+//! Rozmiar bufora w pierścieniu buforów.
+static const unsigned bufferLength=4096;
+//! Identyfikator grupy buforów.
+static const unsigned bufferGroup=0;
+#ifdef ICT_BOOST_URING
+struct Ring::ring_t {
+  int fd=-1;
+  int efd=-1;
+  unsigned features=0;
+  void * sqPtr=MAP_FAILED;
+  std::size_t sqSize=0;
+  void * cqPtr=MAP_FAILED;
+  std::size_t cqSize=0;
+  io_uring_sqe * sqes=(io_uring_sqe*)MAP_FAILED;
+  std::size_t sqesSize=0;
+  unsigned * sqHead=nullptr;
+  unsigned * sqTail=nullptr;
+  unsigned * sqMask=nullptr;
+  unsigned * sqArray=nullptr;
+  unsigned * sqFlags=nullptr;
+  unsigned sqEntries=0;
+  unsigned * cqHead=nullptr;
+  unsigned * cqTail=nullptr;
+  unsigned * cqMask=nullptr;
+  io_uring_cqe * cqes=nullptr;
+  //! Liczba wpisów przygotowanych, ale nie wysłanych do jądra.
+  unsigned pending=0;
+  //! Pierścień buforów.
+  io_uring_buf_ring * br=(io_uring_buf_ring*)MAP_FAILED;
+  //! Wpisy pierścienia buforów (w C++ pole bufs[] z nagłówka jądra ma inne przesunięcie niż w C).
+  io_uring_buf * bufs=nullptr;
+  std::size_t brSize=0;
+  //! Pamięć buforów.
+  std::unique_ptr<unsigned char[]> buffers;
+  ~ring_t(){
+    if (br!=MAP_FAILED) ::munmap(br,brSize);
+    if (sqes!=MAP_FAILED) ::munmap(sqes,sqesSize);
+    if ((cqPtr!=MAP_FAILED)&&(cqPtr!=sqPtr)) ::munmap(cqPtr,cqSize);
+    if (sqPtr!=MAP_FAILED) ::munmap(sqPtr,sqSize);
+    if (fd>=0) ::close(fd);
+  }
+};
+#else
+struct Ring::ring_t {
+};
+#endif
+//============================================
+//! Pierścień bieżącego wątku.
+static thread_local Ring * current_ring=nullptr;
+//! Czy utworzenie pierścienia w bieżącym wątku się nie powiodło.
+static thread_local bool current_failed=false;
+//! Właściciel pierścienia bieżącego wątku (usuwa go przy zakończeniu wątku).
+static thread_local std::unique_ptr<Ring> current_owner;
+//============================================
+Ring::Ring(::boost::asio::io_service & ioIn):r(new ring_t()),io(ioIn),e(ioIn){
+  LOGGER_INFO<<__LOGGER__<<"ict::boost::uring::Ring has been created ..."<<std::endl;
+}
+Ring::~Ring(){
+  ::boost::system::error_code ec;
+  e.close(ec);
+  LOGGER_INFO<<__LOGGER__<<"ict::boost::uring::Ring has been destroyed ..."<<std::endl;
+}
+Ring * Ring::get(::boost::asio::io_service & io){
+  if (current_ring) return((&current_ring->io==&io)?current_ring:nullptr);
+  if (current_failed) return(nullptr);
+  if (&ict::boost::asio::ioService()!=&io) return(nullptr);
+  std::unique_ptr<Ring> ring(new Ring(io));
+  if (!ring->init()) {
+    current_failed=true;
+    LOGGER_INFO<<__LOGGER__<<"io_uring is not available - the reactor will be used ..."<<std::endl;
+    return(nullptr);
+  }
+  current_owner.swap(ring);
+  current_ring=current_owner.get();
+  return(current_ring);
+}
+#ifdef ICT_BOOST_URING
+bool Ring::init(){
+  io_uring_params p;
+  std::memset(&p,0,sizeof(p));
+  #ifdef IORING_SETUP_SINGLE_ISSUER
+  p.flags=IORING_SETUP_SINGLE_ISSUER;
+  #endif
+  r->fd=::syscall(__NR_io_uring_setup,ringEntries,&p);
+  if ((r->fd<0)&&(errno==EINVAL)){
+    std::memset(&p,0,sizeof(p));
+    r->fd=::syscall(__NR_io_uring_setup,ringEntries,&p);
+  }
+  if (r->fd<0) return(false);
+  if (!(p.features&IORING_FEAT_NODROP)) return(false);
+  r->features=p.features;
+  r->sqSize=p.sq_off.array+p.sq_entries*sizeof(unsigned);
+  r->cqSize=p.cq_off.cqes+p.cq_entries*sizeof(io_uring_cqe);
+  if (p.features&IORING_FEAT_SINGLE_MMAP) {
+    if (r->cqSize>r->sqSize) r->sqSize=r->cqSize;
+    r->cqSize=r->sqSize;
+  }
+  r->sqPtr=::mmap(0,r->sqSize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,r->fd,IORING_OFF_SQ_RING);
+  if (r->sqPtr==MAP_FAILED) return(false);
+  if (p.features&IORING_FEAT_SINGLE_MMAP) {
+    r->cqPtr=r->sqPtr;
+  } else {
+    r->cqPtr=::mmap(0,r->cqSize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,r->fd,IORING_OFF_CQ_RING);
+    if (r->cqPtr==MAP_FAILED) return(false);
+  }
+  r->sqesSize=p.sq_entries*sizeof(io_uring_sqe);
+  r->sqes=(io_uring_sqe*)::mmap(0,r->sqesSize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,r->fd,IORING_OFF_SQES);
+  if (r->sqes==MAP_FAILED) return(false);
+  {
+    unsigned char * sq((unsigned char*)r->sqPtr);
+    unsigned char * cq((unsigned char*)r->cqPtr);
+    r->sqHead=(unsigned*)(sq+p.sq_off.head);
+    r->sqTail=(unsigned*)(sq+p.sq_off.tail);
+    r->sqMask=(unsigned*)(sq+p.sq_off.ring_mask);
+    r->sqArray=(unsigned*)(sq+p.sq_off.array);
+    r->sqFlags=(unsigned*)(sq+p.sq_off.flags);
+    r->sqEntries=p.sq_entries;
+    r->cqHead=(unsigned*)(cq+p.cq_off.head);
+    r->cqTail=(unsigned*)(cq+p.cq_off.tail);
+    r->cqMask=(unsigned*)(cq+p.cq_off.ring_mask);
+    r->cqes=(io_uring_cqe*)(cq+p.cq_off.cqes);
+  }
+  r->efd=::eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC);
+  if (r->efd<0) return(false);
+  e.assign(r->efd);
+  if (::syscall(__NR_io_uring_register,r->fd,IORING_REGISTER_EVENTFD,&r->efd,1)<0) return(false);
+  //Pierścień buforów (jądro >= 5.19) - bez niego odczyt jest jednorazowy.
+  r->brSize=bufferCount*sizeof(io_uring_buf);
+  r->br=(io_uring_buf_ring*)::mmap(0,r->brSize,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+  if (r->br!=MAP_FAILED){
+    io_uring_buf_reg reg;
+    std::memset(&reg,0,sizeof(reg));
+    reg.ring_addr=(std::uint64_t)(std::uintptr_t)r->br;
+    reg.ring_entries=bufferCount;
+    reg.bgid=bufferGroup;
+    if (::syscall(__NR_io_uring_register,r->fd,IORING_REGISTER_PBUF_RING,&reg,1)==0){
+      r->buffers.reset(new unsigned char[bufferCount*bufferLength]);
+      r->bufs=(io_uring_buf*)r->br;
+      for (unsigned k=0;k<bufferCount;k++){
+        io_uring_buf & b(r->bufs[k]);
+        b.addr=(std::uint64_t)(std::uintptr_t)(r->buffers.get()+k*bufferLength);
+        b.len=bufferLength;
+        b.bid=k;
+      }
+      __atomic_store_n(&r->br->tail,(std::uint16_t)bufferCount,__ATOMIC_RELEASE);
+      ms=true;
+    } else {
+      ::munmap(r->br,r->brSize);
+      r->br=(io_uring_buf_ring*)MAP_FAILED;
+    }
+  }
+  asyncWait();
+  LOGGER_INFO<<__LOGGER__<<"io_uring has been initialized (multishot="<<ms<<") ..."<<std::endl;
+  return(true);
+}
+void * Ring::sqe(){
+  unsigned tail(*r->sqTail);
+  if ((tail-__atomic_load_n(r->sqHead,__ATOMIC_ACQUIRE))>=r->sqEntries) {
+    flush();
+    if ((tail-__atomic_load_n(r->sqHead,__ATOMIC_ACQUIRE))>=r->sqEntries) return(nullptr);
+  }
+  unsigned index(tail&*r->sqMask);
+  io_uring_sqe * out(&r->sqes[index]);
+  std::memset(out,0,sizeof(io_uring_sqe));
+  r->sqArray[index]=index;
+  __atomic_store_n(r->sqTail,tail+1,__ATOMIC_RELEASE);
+  r->pending++;
+  if (!flushScheduled){
+    //Wszystkie operacje zgłoszone w bieżącym przebiegu io_service są wysyłane razem.
+    flushScheduled=true;
+    io.post([this](){
+      flush();
+    });
+  }
+  return(out);
+}
+void Ring::flush(){
+  flushScheduled=false;
+  unsigned flags(0);
+  if (__atomic_load_n(r->sqFlags,__ATOMIC_RELAXED)&IORING_SQ_CQ_OVERFLOW) flags|=IORING_ENTER_GETEVENTS;
+  while (r->pending||flags){
+    int n(::syscall(__NR_io_uring_enter,r->fd,r->pending,0,flags,nullptr,0));
+    if (n<0) {
+      if (errno==EINTR) continue;
+      if ((errno==EAGAIN)||(errno==EBUSY)) {
+        //Kolejka zakończeń jest pełna - najpierw trzeba je odebrać.
+        reap();
+        continue;
+      }
+      LOGGER_ERR<<__LOGGER__<<"io_uring_enter error: "<<std::strerror(errno)<<std::endl;
+      break;
+    }
+    r->pending-=((unsigned)n>r->pending)?r->pending:n;
+    flags=0;
+  }
+}
+void Ring::asyncWait(){
+  e.async_read_some(
+    ::boost::asio::null_buffers(),
+    [this](const ::boost::system::error_code & ec,std::size_t length){
+      LOGGER_LAYER;
+      if (ec) return;
+      std::uint64_t v;
+      while (::read(r->efd,&v,sizeof(v))>0);
+      reap();
+      asyncWait();
+    }
+  );
+}
+void Ring::reap(){
+  unsigned head(*r->cqHead);
+  for (;;) {
+    unsigned tail(__atomic_load_n(r->cqTail,__ATOMIC_ACQUIRE));
+    if (head==tail) break;
+    io_uring_cqe cqe(r->cqes[head&*r->cqMask]);
+    head++;
+    __atomic_store_n(r->cqHead,head,__ATOMIC_RELEASE);
+    if (cqe.user_data) {
+      try {
+        ((Operation*)(std::uintptr_t)cqe.user_data)->complete(cqe.res,cqe.flags);
+      } catch (std::exception & e) {
+        LOGGER_ERR<<__LOGGER__<<"Exception: "<<e.what()<<std::endl;
+      }
+    }
+  }
+}
+bool Ring::more(unsigned flags){
+  return(flags&IORING_CQE_F_MORE);
+}
+bool Ring::hasBuffer(unsigned flags){
+  return(flags&IORING_CQE_F_BUFFER);
+}
+void Ring::recv(Operation & op,int fd){
+  io_uring_sqe * s((io_uring_sqe*)sqe());
+  if (!s) {
+    op.complete(-EBUSY,0);
+    return;
+  }
+  s->opcode=IORING_OP_RECV;
+  s->fd=fd;
+  s->ioprio=IORING_RECV_MULTISHOT;
+  s->flags=IOSQE_BUFFER_SELECT;
+  s->buf_group=bufferGroup;
+  s->user_data=(std::uint64_t)(std::uintptr_t)&op;
+}
+void Ring::recv(Operation & op,int fd,void * data,std::size_t size){
+  io_uring_sqe * s((io_uring_sqe*)sqe());
+  if (!s) {
+    op.complete(-EBUSY,0);
+    return;
+  }
+  s->opcode=IORING_OP_RECV;
+  s->fd=fd;
+  s->addr=(std::uint64_t)(std::uintptr_t)data;
+  s->len=size;
+  s->user_data=(std::uint64_t)(std::uintptr_t)&op;
+}
+void Ring::send(Operation & op,int fd,const struct msghdr & msg){
+  io_uring_sqe * s((io_uring_sqe*)sqe());
+  if (!s) {
+    op.complete(-EBUSY,0);
+    return;
+  }
+  //Bez MSG_WAITALL - niepełny zapis jest zgłaszany tak samo przez wszystkie jądra, a reszta jest zapisywana ponownie.
+  s->opcode=IORING_OP_SENDMSG;
+  s->fd=fd;
+  s->addr=(std::uint64_t)(std::uintptr_t)&msg;
+  s->len=1;
+  s->msg_flags=MSG_NOSIGNAL;
+  s->user_data=(std::uint64_t)(std::uintptr_t)&op;
+}
+void Ring::cancel(Operation & op){
+  io_uring_sqe * s((io_uring_sqe*)sqe());
+  if (!s) return;
+  s->opcode=IORING_OP_ASYNC_CANCEL;
+  s->fd=-1;
+  s->addr=(std::uint64_t)(std::uintptr_t)&op;
+}
+const unsigned char * Ring::buffer(unsigned flags) const{
+  return(r->buffers.get()+(flags>>IORING_CQE_BUFFER_SHIFT)*bufferLength);
+}
+void Ring::release(unsigned flags){
+  unsigned bid(flags>>IORING_CQE_BUFFER_SHIFT);
+  std::uint16_t tail(r->br->tail);
+  io_uring_buf & b(r->bufs[tail&(bufferCount-1)]);
+  b.addr=(std::uint64_t)(std::uintptr_t)(r->buffers.get()+bid*bufferLength);
+  b.len=bufferLength;
+  b.bid=bid;
+  __atomic_store_n(&r->br->tail,(std::uint16_t)(tail+1),__ATOMIC_RELEASE);
+}
+#else
+bool Ring::init(){
+  return(false);
+}
+void * Ring::sqe(){
+  return(nullptr);
+}
+void Ring::flush(){
+}
+void Ring::asyncWait(){
+}
+void Ring::reap(){
+}
+bool Ring::more(unsigned flags){
+  return(false);
+}
+bool Ring::hasBuffer(unsigned flags){
+  return(false);
+}
+void Ring::recv(Operation & op,int fd){
+}
+void Ring::recv(Operation & op,int fd,void * data,std::size_t size){
+}
+void Ring::send(Operation & op,int fd,const struct msghdr & msg){
+}
+void Ring::cancel(Operation & op){
+}
+const unsigned char * Ring::buffer(unsigned flags) const{
+  return(nullptr);
+}
+void Ring::release(unsigned flags){
+}
+#endif
+bool Ring::multishot() const{
+  return(ms);
+}
+void Ring::disableMultishot(){
+  ms=false;
+}
+//============================================
+}}}
+//============================================
+#ifdef ENABLE_TESTING
+class TestOperation : public ict::boost::uring::Operation {
+public:
+  ict::boost::uring::Ring * ring=nullptr;
+  std::string data;
+  int result=0;
+  bool done=false;
+  void complete(int res,unsigned flags){
+    if (res>0) {
+      if (ict::boost::uring::Ring::hasBuffer(flags)){
+        data.append((const char*)ring->buffer(flags),res);
+        ring->release(flags);
+      }
+    } else {
+      result=res;
+    }
+    if (!ict::boost::uring::Ring::more(flags)) done=true;
+  }
+};
+REGISTER_TEST(uring,tc1){
+  int out=0;
+  //Pierścień należy do wątku - test działa w osobnym wątku, aby nie zostawiać pierścienia w io_service wątku głównego.
+  std::thread thread([&out](){
+    int fds[2];
+    TestOperation r,w;
+    std::string a("Hello "),b("io_uring!");
+    struct iovec buffers[2]={{(void*)a.data(),a.size()},{(void*)b.data(),b.size()}};
+    struct msghdr msg;
+    ::boost::asio::io_service & io(ict::boost::asio::ioService());
+    ict::boost::uring::Ring * ring(ict::boost::uring::Ring::get(io));
+    if (!ring) {
+      std::cout<<"io_uring is not available - skipped"<<std::endl;
+      return;
+    }
+    if (::socketpair(AF_UNIX,SOCK_STREAM,0,fds)) {
+      out=-1;
+      return;
+    }
+    r.ring=ring;
+    w.ring=ring;
+    std::memset(&msg,0,sizeof(msg));
+    msg.msg_iov=buffers;
+    msg.msg_iovlen=2;
+    ring->send(w,fds[0],msg);
+    for (int k=0;(k<1000)&&(!w.done);k++) io.run_one();
+    if (ring->multishot()) {
+      ring->recv(r,fds[1]);
+      for (int k=0;(k<1000)&&(r.data.size()<(a.size()+b.size()));k++) io.run_one();
+      ring->cancel(r);
+      for (int k=0;(k<1000)&&(!r.done);k++) io.run_one();
+    }
+    ::close(fds[0]);
+    ::close(fds[1]);
+    std::cout<<"write="<<w.result<<" read=\""<<r.data<<"\""<<std::endl;
+    if (w.result<0) out=-1;
+    if (ring->multishot()&&(r.data!=(a+b))) out=-1;
+  });
+  thread.join();
+  return(out);
+}
+//! Operacja zajmująca bufory pierścienia - zwraca je dopiero na żądanie (po wyczerpaniu buforów odczyt kończy się ENOBUFS).
+class TestHoldOperation : public ict::boost::uring::Operation {
+public:
+  std::vector<unsigned> held;
+  int result=0;
+  bool done=false;
+  void complete(int res,unsigned flags){
+    if ((res>0)&&ict::boost::uring::Ring::hasBuffer(flags)) {
+      held.push_back(flags);
+    } else if (res<=0) {
+      result=res;
+    }
+    if (!ict::boost::uring::Ring::more(flags)) done=true;
+  }
+};
+//! Stos testowy połączenia io_uring.
+class TestUringStack : public ict::boost::connection::TopString {
+public:
+  //! Liczba opróżnień kolejki zapisu.
+  std::size_t written=0;
+  //! Błąd odczytu.
+  ::boost::system::error_code error;
+  //! Czy połączenie zostało zamknięte.
+  bool closed=false;
+  void start(){asyncRead();}
+  void pause(){readPaused=true;}
+  void resume(){
+    readPaused=false;
+    asyncRead();
+  }
+  std::size_t received() const {return(readString.size());}
+  std::string data() const {return(readString.str());}
+  void send(const std::string & data){
+    writeEnqueue(std::string(data));
+    asyncWrite();
+  }
+  void send(const std::vector<std::string> & parts){
+    for (const std::string & part : parts) writeEnqueue(std::string(part));
+    asyncWrite();
+  }
+  void send(const ict::boost::connection::file_t & file,const std::string & before,const std::string & after){
+    writeEnqueue(std::string(before));
+    writeEnqueueFile(file,0,file->size());
+    writeEnqueue(std::string(after));
+    asyncWrite();
+  }
+protected:
+  void stringRead(){}
+  void stringWrite(){written++;}
+  void readError(::boost::system::error_code ec){error=ec;}
+  void doStop(){closed=true;}
+};
+typedef ict::boost::connection::BottomUring<::boost::asio::local::stream_protocol::socket,TestUringStack> test_uring_t;
+REGISTER_TEST(uring,tc2){
+  int out=0;
+  //Pierścień należy do wątku - test działa w osobnym wątku, aby nie zostawiać pierścienia w io_service wątku głównego.
+  std::thread thread([&out](){
+    int fds[2],hold[2];
+    std::string path("/tmp/uring-tc2.txt");
+    std::string pattern;
+    std::weak_ptr<test_uring_t> weak;
+    ::boost::asio::io_service & io(ict::boost::asio::ioService());
+    ict::boost::uring::Ring * ring(ict::boost::uring::Ring::get(io));
+    //Obsługuje io_service, dopóki warunek nie jest spełniony (false po przekroczeniu czasu).
+    std::function<bool(std::function<bool()>)> run([&io](std::function<bool()> done)->bool{
+      for (int k=0;k<5000;k++){
+        if (done()) return(true);
+        if (!io.poll()) ::usleep(1000);
+      }
+      return(done());
+    });
+    if (!ring) {
+      std::cout<<"io_uring is not available - skipped"<<std::endl;
+      return;
+    }
+    if (::socketpair(AF_UNIX,SOCK_STREAM,0,fds)||::socketpair(AF_UNIX,SOCK_STREAM,0,hold)) {
+      out=-1;
+      return;
+    }
+    ::fcntl(fds[1],F_SETFL,O_NONBLOCK);
+    ::fcntl(hold[0],F_SETFL,O_NONBLOCK);
+    for (std::size_t k=0;k<(512*1024);k++) pattern+=(char)('a'+k%26);
+    {
+      std::ofstream f(path,std::ios::binary|std::ios::trunc);
+      f<<pattern.substr(0,10000);
+    }
+    [&](){
+      ::boost::asio::local::stream_protocol::socket socket(io);
+      socket.assign(::boost::asio::local::stream_protocol(),fds[0]);
+      std::shared_ptr<test_uring_t> ptr(std::make_shared<test_uring_t>(socket));
+      weak=ptr;
+      ptr->initThis();
+      if (!ptr->uring()) {out=-1;return;}
+      ptr->start();
+      {//Zapis - bufory przez io_uring, fragment pliku przez sendfile() w Bottom.
+        std::string expected("begin"+pattern.substr(0,10000)+"end"),output;
+        char buffer[4096];
+        ptr->send(std::string("Hello "));
+        if (!run([&](){return(ptr->written==1);})) {out=-1;return;}
+        ptr->send(ict::boost::connection::File::open(path),"begin","end");
+        expected="Hello "+expected;
+        run([&](){
+          ssize_t n;
+          while ((n=::read(fds[1],buffer,sizeof(buffer)))>0) output.append(buffer,n);
+          return((ptr->written==2)&&(output.size()>=expected.size()));
+        });
+        if ((output!=expected)||ptr->closed) {
+          std::cout<<"write: "<<output.size()<<"/"<<expected.size()<<std::endl;
+          out=-1;
+          return;
+        }
+        //Zapis większy niż bufor gniazda - niepełne zapisy są ponawiane bez luk w danych.
+        std::vector<std::string> parts;
+        for (std::size_t k=0;k<pattern.size();k+=65536) parts.push_back(pattern.substr(k,65536));
+        output.clear();
+        ptr->send(parts);
+        for (int k=0;k<100;k++) if (!io.poll()) ::usleep(1000);
+        if (ptr->written!=2) {out=-1;return;}//Druga strona nie odbiera - zapis nie może się zakończyć.
+        run([&](){
+          ssize_t n;
+          while ((n=::read(fds[1],buffer,sizeof(buffer)))>0) output.append(buffer,n);
+          return((ptr->written==3)&&(output.size()>=pattern.size()));
+        });
+        if ((output!=pattern)||ptr->closed) {
+          std::cout<<"write: "<<output.size()<<"/"<<pattern.size()<<std::endl;
+          out=-1;
+          return;
+        }
+      }
+      if (!ring->multishot()) {
+        std::cout<<"multishot recv is not available - read tests skipped"<<std::endl;
+      } else {
+        std::size_t sent(0),idle(0);
+        int queued(0);
+        //Odczyt wstrzymany przez stos - dane czekają w readPending, a po przekroczeniu limitu odczyt jest przerywany.
+        ptr->pause();
+        while (idle<100){
+          ssize_t n(::write(fds[1],pattern.data()+sent,pattern.size()-sent));
+          if (n>0) {
+            sent+=n;
+            idle=0;
+          } else {
+            idle++;
+          }
+          if (!io.poll()) ::usleep(1000);
+        }
+        if (::ioctl(fds[0],FIONREAD,&queued)) queued=0;
+        std::cout<<"sent="<<sent<<" received="<<ptr->received()<<" pending="<<ptr->pending()<<" queued="<<queued<<std::endl;
+        if ((ptr->pending()<65536)||(queued<=0)||(sent==pattern.size())) {out=-1;return;}
+        //Wznowienie - zaległe dane są przekazywane do stosu, a potem odczyt jest zgłaszany ponownie.
+        ptr->resume();
+        run([&](){
+          ssize_t n(::write(fds[1],pattern.data()+sent,pattern.size()-sent));
+          if (n>0) sent+=n;
+          return(ptr->received()==pattern.size());
+        });
+        if ((ptr->data()!=pattern)||ptr->pending()||ptr->closed) {out=-1;return;}
+        //Wyczerpanie buforów pierścienia - odczyt połączenia kończy się ENOBUFS i jest ponawiany.
+        TestHoldOperation h;
+        std::size_t filled(0);
+        std::string ping("ping");
+        ring->recv(h,hold[1]);
+        run([&](){
+          ssize_t n(::write(hold[0],pattern.data(),pattern.size()));
+          if (n>0) filled+=n;
+          return(h.done);
+        });
+        if ((h.result!=-ENOBUFS)||h.held.empty()) {
+          std::cout<<"hold: result="<<h.result<<" buffers="<<h.held.size()<<" sent="<<filled<<std::endl;
+          out=-1;
+          return;
+        }
+        if (::write(fds[1],ping.data(),ping.size())!=(ssize_t)ping.size()) {out=-1;return;}
+        //Odczyt jest ponawiany bez przerwy (do zwolnienia buforów) - poll() by się nie zakończył.
+        for (int k=0;k<100;k++) io.poll_one();
+        if ((ptr->received()!=pattern.size())||ptr->closed) {out=-1;return;}
+        for (unsigned flags : h.held) ring->release(flags);
+        h.held.clear();
+        run([&](){return(ptr->received()==(pattern.size()+ping.size()));});
+        if ((ptr->data()!=(pattern+ping))||ptr->closed) {out=-1;return;}
+      }
+      //Zamknięcie przez drugą stronę - eof i zamknięcie połączenia.
+      ::close(fds[1]);
+      fds[1]=-1;
+      if (!run([&](){return(ptr->closed);})||(ptr->error!=::boost::asio::error::eof)) {out=-1;return;}
+    }();
+    //Po zakończeniu operacji io_uring połączenie jest zwalniane.
+    if (!run([&](){return(weak.expired());})) out=-1;
+    if (fds[1]>=0) ::close(fds[1]);
+    ::close(hold[0]);
+    ::close(hold[1]);
+    ::unlink(path.c_str());
+  });
+  thread.join();
+  return(out);
+}
+#endif
+//===========================================
@@ -0,0 +1,125 @@
+//! @file
+//! @brief io_uring module - header file.
+//! @author Mariusz Ornowski (mariusz.ornowski@ict-project.pl)
+//! @version 1.0
+//! @date 2017
+//! @copyright ICT-Project Mariusz Ornowski (ict-project.pl)
+/* **************************************************************
+Copyright (c) 2017, ICT-Project Mariusz Ornowski (ict-project.pl)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+1. Redistributions of source code must retain the above copyright
+notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+notice, this list of conditions and the following disclaimer in the
+documentation and/or other materials provided with the distribution.
+3. Neither the name of the ICT-Project Mariusz Ornowski nor the names
+of its contributors may be used to endorse or promote products
+derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+**************************************************************/
+#ifndef _URING_HEADER
+#define _URING_HEADER
+//============================================
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <boost/asio.hpp>
+#include <sys/socket.h>
+//============================================
+namespace ict { namespace boost { namespace uring {
+//===========================================
+//! Operacja wykonywana przez io_uring (obiekt musi istnieć do czasu ostatniego wywołania complete()).
+class Operation {
+public:
+  virtual ~Operation(){}
+  //!
+  //! Obsługuje zakończenie operacji (wywoływana w wątku io_service pierścienia).
+  //!
+  //! @param res Wynik operacji (liczba bajtów lub -errno).
+  //! @param flags Flagi zakończenia (patrz Ring::more(), Ring::hasBuffer()).
+  //!
+  virtual void complete(int res,unsigned flags)=0;
+};
+//===========================================
+//! Pierścień io_uring obsługujący wszystkie połączenia jednego io_service (jednego wątku).
+class Ring {
+private:
+  struct ring_t;
+  //! Stan pierścienia (zależny od jądra).
+  std::unique_ptr<ring_t> r;
+  //! io_service pierścienia.
+  ::boost::asio::io_service & io;
+  //! Deskryptor eventfd sygnalizujący zakończenia operacji.
+  ::boost::asio::posix::stream_descriptor e;
+  //! Czy zlecono już wysłanie oczekujących operacji.
+  bool flushScheduled=false;
+  //! Czy jądro obsługuje wielokrotny odczyt (multishot recv) z buforami pierścienia.
+  bool ms=false;
+  Ring(::boost::asio::io_service & ioIn);
+  //! Inicjuje pierścień (zwraca false, jeśli io_uring jest niedostępny).
+  bool init();
+  //! Zwraca wolny wpis kolejki zgłoszeń (nullptr, jeśli brak).
+  void * sqe();
+  //! Oczekuje na zakończenia operacji.
+  void asyncWait();
+  //! Obsługuje zakończone operacje.
+  void reap();
+public:
+  ~Ring();
+  //!
+  //! Zwraca pierścień dla podanego io_service.
+  //! Pierścień jest tworzony w wątku, który obsługuje io_service (io_service bieżącego wątku).
+  //!
+  //! @param io io_service połączenia.
+  //! @return Wskaźnik do pierścienia lub nullptr (io_uring niedostępny lub io_service innego wątku).
+  //!
+  static Ring * get(::boost::asio::io_service & io);
+  //! Czy zakończenie nie jest ostatnim dla operacji (multishot).
+  static bool more(unsigned flags);
+  //! Czy zakończenie wskazuje bufor z pierścienia buforów.
+  static bool hasBuffer(unsigned flags);
+  //! Czy jądro obsługuje wielokrotny odczyt (multishot recv) z buforami pierścienia.
+  bool multishot() const;
+  //! Wyłącza wielokrotny odczyt (np. gdy jądro go odrzuciło).
+  void disableMultishot();
+  //! Ustawia wielokrotny odczyt z gniazda do buforów pierścienia.
+  void recv(Operation & op,int fd);
+  //! Ustawia jednorazowy odczyt z gniazda do podanego bufora.
+  void recv(Operation & op,int fd,void * data,std::size_t size);
+  //!
+  //! Ustawia zapis buforów jedną operacją sendmsg - wynik to liczba zapisanych bajtów (zapis może być niepełny).
+  //!
+  //! @param op Operacja.
+  //! @param fd Gniazdo.
+  //! @param msg Opis buforów (msg i bufory muszą istnieć do zakończenia operacji).
+  //!
+  void send(Operation & op,int fd,const struct msghdr & msg);
+  //! Anuluje operację.
+  void cancel(Operation & op);
+  //! Zwraca dane bufora pierścienia wskazanego w flagach zakończenia.
+  const unsigned char * buffer(unsigned flags) const;
+  //! Zwraca bufor wskazany w flagach zakończenia do pierścienia buforów.
+  void release(unsigned flags);
+  //! Wysyła do jądra wszystkie oczekujące operacje (jednym wywołaniem systemowym).
+  void flush();
+};
+//===========================================
+}}}
+//===========================================
+#endif